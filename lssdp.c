@@ -1,25 +1,60 @@
 #include <stdio.h>      // snprintf, vsnprintf
 #include <stdlib.h>     // malloc, free
 #include <stdarg.h>     // va_start, va_end, va_list
-#include <string.h>     // memset, memcpy, strlen, strcpy, strcmp, strncasecmp, strerror
-#include <ctype.h>      // isprint, isspace
+#include <string.h>     // memset, memcpy, strlen, strcpy, strcmp, strcasecmp, strncasecmp, strerror
+#include <ctype.h>      // isprint, isspace, isdigit
 #include <errno.h>      // errno
+#include <limits.h>     // INT_MAX
 #include <unistd.h>     // close
-#include <sys/time.h>   // gettimeofday
+#include <sys/time.h>   // gettimeofday, struct timeval
+#include <time.h>       // struct timespec
 #include <sys/ioctl.h>  // ioctl, FIONBIO
 #include <net/if.h>     // struct ifconf, struct ifreq
-#include <fcntl.h>      // fcntl, F_GETFD, F_SETFD, FD_CLOEXEC
-#include <sys/socket.h> // struct sockaddr, AF_INET, SOL_SOCKET, socklen_t, setsockopt, socket, bind, sendto, recvfrom
+#include <fcntl.h>      // fcntl, open, F_GETFD, F_SETFD, FD_CLOEXEC
+#include <sys/stat.h>   // fstat, struct stat
+#include <sys/socket.h> // struct sockaddr, struct msghdr, struct cmsghdr, AF_INET, SOL_SOCKET, socklen_t, setsockopt, socket, bind, sendmsg, recvmsg
+#include <sys/uio.h>    // struct iovec
 #include <netinet/in.h> // struct sockaddr_in, struct ip_mreq, INADDR_ANY, IPPROTO_IP, also include <sys/socket.h>
 #include <arpa/inet.h>  // inet_aton, inet_ntop, inet_addr, also include <netinet/in.h>
+#ifdef __linux__
+#include <linux/filter.h>   // struct sock_filter, struct sock_fprog, SKF_NET_OFF, BPF_STMT, BPF_JUMP
+#include <sys/sendfile.h>   // sendfile
+#endif
 #include "lssdp.h"
 
 #ifndef _SIZEOF_ADDR_IFREQ
 #define _SIZEOF_ADDR_IFREQ sizeof
 #endif
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // SO_NOSIGPIPE is set instead
+#endif
+
 /** Definition **/
 #define LSSDP_BUFFER_LEN    2048
+#define LSSDP_MSEARCH_INTERVAL_MIN  1000    // milliseconds
+#define LSSDP_MSEARCH_INTERVAL_MAX  60000   // milliseconds
+#define LSSDP_NEIGHBOR_PROBE_RATIO  80      // percentage of neighbor_timeout
+#define LSSDP_NEIGHBOR_BUCKET_NUM   64      // initial hash bucket number, power of 2
+#define LSSDP_IOV_NUM               5       // max iovec number of a packet
+#define LSSDP_SEARCH_RESULT_NUM     8       // initial result size of search session
+#define LSSDP_FILTER_LEN            4096    // max instruction number of socket filter (BPF_MAXINSNS)
+#define LSSDP_DROP_WARN_INTERVAL    10000   // milliseconds between kernel drop warnings
+#define LSSDP_FETCH_CONNECTION_MAX  8       // default concurrent description fetch
+#define LSSDP_FETCH_HOST_MAX        2       // default concurrent description fetch per host
+#define LSSDP_FETCH_TIMEOUT         5000    // default milliseconds of description fetch
+#define LSSDP_FETCH_BODY_MAX        65536   // default max description bytes
+#define LSSDP_FETCH_CACHE_NUM       32      // default cached description number
+#define LSSDP_FETCH_HEADER_LEN      4096    // max HTTP request and response header length
+#define LSSDP_HTTP_CONNECTION_MAX   64      // default concurrent connections of description responder
+#define LSSDP_HTTP_IDLE_TIMEOUT     5000    // default milliseconds of idle keep-alive connection
+#define LSSDP_HTTP_REQUEST_LEN      2048    // max request header length, pipelined requests included
+#define LSSDP_HTTP_HEADER_LEN       512     // max response header length
+#define PCAPNG_BLOCK_SHB            0x0A0D0D0A  // Section Header Block
+#define PCAPNG_BLOCK_IDB            0x00000001  // Interface Description Block
+#define PCAPNG_BLOCK_EPB            0x00000006  // Enhanced Packet Block
+#define PCAPNG_BYTE_ORDER_MAGIC     0x1A2B3C4D
+#define PCAPNG_LINKTYPE_RAW         101         // raw IPv4/IPv6
 #define lssdp_debug(fmt, agrs...) lssdp_log(LSSDP_LOG_DEBUG, __LINE__, __func__, fmt, ##agrs)
 #define lssdp_info(fmt, agrs...)  lssdp_log(LSSDP_LOG_INFO,  __LINE__, __func__, fmt, ##agrs)
 #define lssdp_warn(fmt, agrs...)  lssdp_log(LSSDP_LOG_WARN,  __LINE__, __func__, fmt, ##agrs)
@@ -36,23 +71,209 @@ typedef struct lssdp_packet {
     /* Additional SSDP Header Fields */
     char            sm_id       [LSSDP_FIELD_LEN];
     char            device_type [LSSDP_FIELD_LEN];
+    long            boot_id;                                // BOOTID.UPNP.ORG, -1 if absent
+    long            config_id;                              // CONFIGID.UPNP.ORG, -1 if absent
+    long            next_boot_id;                           // NEXTBOOTID.UPNP.ORG of ssdp:update, -1 if absent
     long long       update_time;
+    uint32_t        addr;                                   // source address in network byte order
+    bool            is_byebye;                              // NTS: ssdp:byebye
+
+    /* Extra Header Fields: value offset in data, not copied until stored in neighbor */
+    const char *    data;                                   // received packet, valid in socket read only
+    lssdp_extra_header extra    [LSSDP_HEADER_INTEREST_NUM];
 } lssdp_packet;
 
+/* key of neighbor index, lssdp.neighbor_index.key */
+enum NEIGHBOR_KEY {
+    NEIGHBOR_KEY_LOCATION,                                  // default
+    NEIGHBOR_KEY_ST_USN,                                    // monitor
+    NEIGHBOR_KEY_USN                                        // neighbor_merge
+};
+
+
+/** Struct: lssdp_fetch **/
+enum FETCH_STATE {
+    FETCH_CONNECTING,                                       // wait writable, then check SO_ERROR
+    FETCH_SENDING,                                          // send request
+    FETCH_RECEIVING,                                        // receive response until Content-Length or connection close
+    FETCH_DONE                                              // status is decided, socket is closed
+};
+
+typedef struct lssdp_fetch {
+    char            usn         [LSSDP_FIELD_LEN];
+    char            location    [LSSDP_LOCATION_LEN];
+    long            config_id;
+    char            host        [LSSDP_FIELD_LEN];          // Host header: "IP[:port]" of location
+    size_t          path_offset;                            // path in location, empty is "/"
+    uint32_t        addr;                                   // host address in network byte order
+    unsigned short  port;
+    int             sock;
+    int             state;
+    int             status;                                 // HTTP status, < 0 is failed
+    long long       deadline;
+
+    /* request, then response */
+    char *          buffer;
+    size_t          buffer_len;
+    size_t          buffer_size;
+    size_t          sent;
+    size_t          header_len;                             // response header length with the empty line, 0 is incomplete
+    long long       content_length;                         // -1 is absent
+    bool            is_chunked;
+    size_t          body_len;
+    char            etag        [LSSDP_FIELD_LEN];
+    char            last_modified [LSSDP_FIELD_LEN];
+    struct lssdp_fetch * next;
+} lssdp_fetch;
+
+typedef struct lssdp_fetch_cache {
+    char            location    [LSSDP_LOCATION_LEN];
+    long            config_id;
+    char            etag        [LSSDP_FIELD_LEN];
+    char            last_modified [LSSDP_FIELD_LEN];
+    char *          body;
+    size_t          body_len;
+    struct lssdp_fetch_cache * next;
+} lssdp_fetch_cache;
+
+
+/** Struct: lssdp_http_resource, lssdp_http_connection **/
+typedef struct lssdp_http_resource {
+    char            path        [LSSDP_FIELD_LEN];
+    char            content_type[LSSDP_FIELD_LEN];
+    char            etag        [LSSDP_FIELD_LEN];      // hash of data, or size and mtime of file
+    const char *    data;                                   // in-memory document, NULL if file
+    int             fd;                                     // file document, -1 if in-memory
+    size_t          len;
+    struct lssdp_http_resource * next;
+} lssdp_http_resource;
+
+enum HTTP_STATE {
+    HTTP_READING,                                           // wait a complete request
+    HTTP_WRITING                                            // send response header and body
+};
+
+typedef struct lssdp_http_connection {
+    int             sock;
+    int             state;
+    bool            keep_alive;
+    long long       deadline;                               // idle timeout
+    char            request     [LSSDP_HTTP_REQUEST_LEN];
+    size_t          request_len;
+    char            header      [LSSDP_HTTP_HEADER_LEN];    // response header
+    size_t          header_len;
+    size_t          header_sent;
+    const lssdp_http_resource * resource;                   // response body, NULL if no body
+    size_t          body_sent;
+    struct lssdp_http_connection * next;
+} lssdp_http_connection;
+
+
+/** Struct: lssdp_event_readiness **/
+typedef struct lssdp_event_readiness {
+    const fd_set *  read_fds;                               // select, NULL is none
+    const fd_set *  write_fds;                              // select, NULL is none
+    int             fd;                                     // the ready fd of poll, < 0 is none
+    short           revents;
+} lssdp_event_readiness;
+
 
 /** Internal Function **/
-static int send_multicast_data(const char * data, const struct lssdp_interface interface, unsigned short ssdp_port);
-static int lssdp_send_response(lssdp_ctx * lssdp, struct sockaddr_in address);
-static int lssdp_packet_parser(const char * data, size_t data_len, lssdp_packet * packet);
-static int parse_field_line(const char * data, size_t start, size_t end, lssdp_packet * packet);
-static int get_colon_index(const char * string, size_t start, size_t end);
+static int udp_socket_open(lssdp_ctx * lssdp);
+static int udp_socket_close(lssdp_ctx * lssdp, int sock);
+static int udp_socket_filter(lssdp_ctx * lssdp, int sock);
+static int udp_socket_rcvbuf(lssdp_ctx * lssdp, int sock);
+static int udp_rcvbuf_size(lssdp_ctx * lssdp);
+static ssize_t udp_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info);
+static ssize_t udp_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port);
+static ssize_t udp_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num);
+static int udp_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size);
+static long long udp_now(lssdp_ctx * lssdp);
+static int send_multicast_data(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, const struct lssdp_interface * interface);
+static int send_msearch_multicast(lssdp_ctx * lssdp, const char * st);
+static int send_msearch_unicast(lssdp_ctx * lssdp, uint32_t address, const char * st);
+static ssize_t lssdp_socket_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, struct sockaddr_in * address, long long * timestamp);
+static void rcvbuf_drop_update(lssdp_ctx * lssdp, uint32_t drop_counter);
+static int self_address_key(int family, const void * address, uint8_t key[16]);
+static lssdp_self_address_slot * self_address_find(const lssdp_ctx * lssdp, const uint8_t key[16]);
+static int self_address_insert(lssdp_ctx * lssdp, const uint8_t key[16], bool is_user);
+static int self_address_resize(lssdp_ctx * lssdp, size_t slot_num, bool is_user_only);
+static void self_address_rebuild(lssdp_ctx * lssdp);
+static int lssdp_send_response(lssdp_ctx * lssdp, struct sockaddr_in address, const char * st);
+static size_t msearch_packet_iov(lssdp_ctx * lssdp, struct iovec * iov, const char * host, const char * st);
+static int packet_template_update(lssdp_ctx * lssdp);
+static struct iovec packet_template_segment(lssdp_ctx * lssdp, int segment);
+static struct iovec iov_string(const char * string);
+static int lssdp_packet_process(lssdp_ctx * lssdp, const lssdp_packet * packet, struct sockaddr_in address);
+static int lssdp_packet_parser(lssdp_ctx * lssdp, const char * data, size_t data_len, lssdp_packet * packet);
+static void st_pattern_compile(const char * st, lssdp_st_pattern * pattern);
+static bool st_pattern_match_msearch(const lssdp_st_pattern * pattern, const char * st);
+static bool st_pattern_match_neighbor(const lssdp_st_pattern * pattern, int mode, const char * st);
+static long st_version(const char * st, size_t st_len, size_t * type_len);
+static int parse_field_line(lssdp_ctx * lssdp, const char * data, size_t start, size_t end, lssdp_packet * packet);
+static long parse_upnp_id(const char * value, size_t value_len);
+static int get_colon_index(const char * string, size_t start, size_t end, size_t * colon);
 static int trim_spaces(const char * string, size_t * start, size_t * end);
-static long long get_current_time();
+static long long get_current_time(lssdp_ctx * lssdp);
+static long long get_current_time_us(lssdp_ctx * lssdp);
+static long long packet_arrival_time(lssdp_ctx * lssdp, long long timestamp);
+static const lssdp_transport * get_transport(lssdp_ctx * lssdp);
+static int capture_write_block(FILE * file, uint32_t type, const struct iovec * iov, size_t iov_num);
+static int capture_write_packet(lssdp_ctx * lssdp, const char * data, size_t data_len, const lssdp_recv_info * info);
 static int lssdp_log(int level, int line, const char * func, const char * format, ...);
-static int neighbor_list_add(lssdp_ctx * lssdp, const lssdp_packet packet);
+static int neighbor_list_add(lssdp_ctx * lssdp, const lssdp_packet * packet);
+static void neighbor_event(lssdp_ctx * lssdp, int event, const lssdp_nbr * nbr);
+static void neighbor_list_changed(lssdp_ctx * lssdp);
+static void network_interface_changed(lssdp_ctx * lssdp);
+static void packet_received(lssdp_ctx * lssdp, const char * packet, size_t packet_len, uint32_t address);
+static bool extra_header_update(lssdp_extra_header * extra, char ** extra_arena, bool * extra_is_notify, const lssdp_packet * packet);
+static bool neighbor_path_update(lssdp_ctx * lssdp, lssdp_nbr * nbr, const lssdp_packet * packet);
+static int neighbor_list_remove(lssdp_ctx * lssdp, const lssdp_packet * packet);
+static void neighbor_byebye(lssdp_ctx * lssdp, lssdp_nbr * nbr);
+static void neighbor_free(lssdp_nbr * nbr);
+static void neighbor_list_unlink(lssdp_ctx * lssdp, lssdp_nbr * nbr);
+static void neighbor_list_append(lssdp_ctx * lssdp, lssdp_nbr * nbr);
+static lssdp_nbr * neighbor_index_find(lssdp_ctx * lssdp, const lssdp_packet * packet, uint32_t hash);
+static int neighbor_index_resize(lssdp_ctx * lssdp, size_t bucket_num);
+static uint32_t neighbor_key_hash(lssdp_ctx * lssdp, const char * usn, const char * st, const char * location);
+static void neighbor_index_rekey(lssdp_ctx * lssdp);
+static uint32_t fnv1a_hash(uint32_t hash, const char * data, size_t data_len);
 static int lssdp_neighbor_remove_all(lssdp_ctx * lssdp);
-static void neighbor_list_free(lssdp_nbr * list);
+static void neighbor_list_free(lssdp_ctx * lssdp, lssdp_nbr * list);
 static struct lssdp_interface * find_interface_in_LAN(lssdp_ctx * lssdp, uint32_t address);
+static void hub_sync(lssdp_hub * hub, lssdp_ctx * lssdp);
+static int hub_index_rebuild(lssdp_hub * hub);
+static uint32_t hub_st_hash(const char * st);
+static void search_packet_process(lssdp_ctx * lssdp, const lssdp_packet * packet);
+static int search_result_add(lssdp_search * search, const lssdp_packet * packet);
+static int search_result_grow(lssdp_search * search);
+static void search_unlink(lssdp_ctx * lssdp, lssdp_search * search);
+static void search_free(lssdp_search * search);
+static void fetch_enqueue(lssdp_ctx * lssdp, const lssdp_nbr * nbr);
+static int fetch_location_parse(lssdp_fetch * fetch, const char * location);
+static size_t fetch_host_count(lssdp_ctx * lssdp, uint32_t addr);
+static bool fetch_startable(lssdp_ctx * lssdp);
+static void fetch_start(lssdp_ctx * lssdp);
+static int fetch_connect(lssdp_ctx * lssdp, lssdp_fetch * fetch, const lssdp_fetch_cache * cache);
+static void fetch_transfer(lssdp_ctx * lssdp, lssdp_fetch * fetch, bool is_readable, bool is_writable);
+static bool fetch_response_end(lssdp_ctx * lssdp, lssdp_fetch * fetch, bool is_eof);
+static int fetch_response_header(lssdp_fetch * fetch);
+static int chunked_decode(char * data, size_t data_len, size_t * decoded_len);
+static void fetch_done(lssdp_fetch * fetch, int status);
+static void fetch_complete(lssdp_ctx * lssdp, lssdp_fetch * fetch);
+static lssdp_fetch_cache * fetch_cache_find(lssdp_ctx * lssdp, const char * location);
+static void fetch_cache_store(lssdp_ctx * lssdp, const lssdp_fetch * fetch, const char * body, size_t body_len);
+static void fetch_free(lssdp_fetch * fetch);
+static int http_header_next(const char * data, size_t header_end, size_t * start, const char ** field, size_t * field_len, const char ** value, size_t * value_len);
+static lssdp_http_resource * http_resource_add(lssdp_ctx * lssdp, const char * path, const char * content_type);
+static void http_accept(lssdp_ctx * lssdp);
+static int http_connection_process(lssdp_ctx * lssdp, lssdp_http_connection * conn);
+static int http_response(lssdp_ctx * lssdp, lssdp_http_connection * conn, size_t request_len);
+static int http_write(lssdp_http_connection * conn);
+static void http_connection_free(lssdp_http_connection * conn);
+static int event_process(lssdp_ctx * lssdp, const lssdp_event_readiness * ready);
+static short event_revents(const lssdp_event_readiness * ready, int fd);
+static void event_pollfd_add(struct pollfd * fds, size_t fds_size, size_t * n, int fd, short events);
 
 
 /** Global Variable **/
@@ -68,7 +289,12 @@ static struct {
     const char * ADDR_LOCALHOST;
     const char * ADDR_MULTICAST;
 
+    const char * ST_ALL;
+    const char * NTS_BYEBYE;
+
     void (* log_callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message);
+    void (* log_callback_data)(const char * file, const char * tag, int level, int line, const char * func, const char * message, void * user_data);
+    void * log_user_data;
 
 } Global = {
     // SSDP Method
@@ -85,8 +311,25 @@ static struct {
     .ADDR_LOCALHOST = "127.0.0.1",
     .ADDR_MULTICAST = "239.255.255.250",
 
+    // Search Target
+    .ST_ALL = "ssdp:all",
+    .NTS_BYEBYE = "ssdp:byebye",
+
     // Log Callback
-    .log_callback = NULL
+    .log_callback      = NULL,
+    .log_callback_data = NULL,
+    .log_user_data     = NULL
+};
+
+/** UDP Transport **/
+const lssdp_transport lssdp_transport_udp = {
+    .socket_open    = udp_socket_open,
+    .socket_close   = udp_socket_close,
+    .recv           = udp_recv,
+    .send           = udp_send,
+    .send_multicast = udp_send_multicast,
+    .interface_list = udp_interface_list,
+    .now            = udp_now
 };
 
 
@@ -103,87 +346,16 @@ int lssdp_network_interface_update(lssdp_ctx * lssdp) {
     struct lssdp_interface original_interface[LSSDP_INTERFACE_LIST_SIZE] = {};
     memcpy(original_interface, lssdp->interface, SIZE_OF_INTERFACE_LIST);
 
-    // 2. reset lssdp->interface
-    lssdp->interface_num = 0;
-    memset(lssdp->interface, 0, SIZE_OF_INTERFACE_LIST);
-
-    int result = -1;
-
-    /* Reference to this article:
-     * http://stackoverflow.com/a/8007079
-     */
-
-    // 3. create UDP socket
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) {
-        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
-    // 4. get ifconfig
-    char buffer[LSSDP_BUFFER_LEN] = {};
-    struct ifconf ifc = {
-        .ifc_len = sizeof(buffer),
-        .ifc_buf = (caddr_t) buffer
-    };
-
-    if (ioctl(fd, SIOCGIFCONF, &ifc) < 0) {
-        lssdp_error("ioctl SIOCGIFCONF failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
-    // 5. setup lssdp->interface
-    size_t i;
-    struct ifreq * ifr;
-    for (i = 0; i < ifc.ifc_len; i += _SIZEOF_ADDR_IFREQ(*ifr)) {
-        ifr = (struct ifreq *)(buffer + i);
-        if (ifr->ifr_addr.sa_family != AF_INET) {
-            // only support IPv4
-            continue;
-        }
-
-        // 5-1. get interface ip string
-        char ip[LSSDP_IP_LEN] = {};
-        struct sockaddr_in * addr = (struct sockaddr_in *) &ifr->ifr_addr;
-        if (inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip)) == NULL) {
-            lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
-            continue;
-        }
-
-        // 5-2. get network mask
-        struct ifreq netmask = {};
-        strcpy(netmask.ifr_name, ifr->ifr_name);
-        if (ioctl(fd, SIOCGIFNETMASK, &netmask) != 0) {
-            lssdp_error("ioctl SIOCGIFNETMASK failed, errno = %s (%d)\n", strerror(errno), errno);
-            continue;
-        }
-
-        // 5-3. check network interface number
-        if (lssdp->interface_num >= LSSDP_INTERFACE_LIST_SIZE) {
-            lssdp_warn("interface number is over than MAX SIZE (%d)     %s %s\n", LSSDP_INTERFACE_LIST_SIZE, ifr->ifr_name, ip);
-            continue;
-        }
-
-        // 5-4. set interface
-        size_t n = lssdp->interface_num;
-        snprintf(lssdp->interface[n].name, LSSDP_INTERFACE_NAME_LEN, "%s", ifr->ifr_name); // name
-        snprintf(lssdp->interface[n].ip,   LSSDP_IP_LEN,             "%s", ip);            // ip string
-        lssdp->interface[n].addr = addr->sin_addr.s_addr;                                  // address in network byte order
-
-        // set network mask
-        addr = (struct sockaddr_in *) &netmask.ifr_addr;
-        lssdp->interface[n].netmask = addr->sin_addr.s_addr;                               // mask in network byte order
-
-        // increase interface number
-        lssdp->interface_num++;
-    }
-
-    result = 0;
-end:
-    // close socket
-    if (fd >= 0 && close(fd) != 0) {
-        lssdp_error("close fd %d failed, errno = %s (%d)\n", strerror(errno), errno);
+    // 2. get network interface list from transport
+    const lssdp_transport * transport = get_transport(lssdp);
+    int interface_num = transport->interface_list(lssdp, lssdp->interface, LSSDP_INTERFACE_LIST_SIZE);
+    int result = 0;
+    if (interface_num < 0) {
+        memset(lssdp->interface, 0, SIZE_OF_INTERFACE_LIST);
+        interface_num = 0;
+        result = -1;
     }
+    lssdp->interface_num = interface_num;
 
     // compare with original interface
     if (memcmp(original_interface, lssdp->interface, SIZE_OF_INTERFACE_LIST) == 0) {
@@ -196,11 +368,21 @@ end:
     // 1. force clean up neighbor_list
     lssdp_neighbor_remove_all(lssdp);
 
-    // 2. invoke network interface changed callback
-    if (lssdp->network_interface_changed_callback != NULL) {
-        lssdp->network_interface_changed_callback(lssdp);
+    // 2. restart M-SEARCH scheduler: due now, with interval_min
+    lssdp->msearch.next_time  = 0;
+    lssdp->msearch.is_changed = true;
+
+    // 3. rebuild self address set
+    self_address_rebuild(lssdp);
+
+    // 4. regenerate socket filter with new self addresses
+    if (lssdp->sock > 0 && get_transport(lssdp) == &lssdp_transport_udp) {
+        udp_socket_filter(lssdp, lssdp->sock);
     }
 
+    // 5. invoke network interface changed callback
+    network_interface_changed(lssdp);
+
     return result;
 }
 
@@ -219,67 +401,17 @@ int lssdp_socket_create(lssdp_ctx * lssdp) {
     // close original SSDP socket
     lssdp_socket_close(lssdp);
 
-    // create UDP socket
-    lssdp->sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (lssdp->sock < 0) {
-        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+    // create SSDP socket by transport
+    const lssdp_transport * transport = get_transport(lssdp);
+    lssdp->stats.drop_counter = 0;
+    lssdp->sock = transport->socket_open(lssdp);
+    if (lssdp->sock <= 0) {
+        lssdp->sock = -1;
         return -1;
     }
 
-    int result = -1;
-
-    // set non-blocking
-    int opt = 1;
-    if (ioctl(lssdp->sock, FIONBIO, &opt) != 0) {
-        lssdp_error("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
-    // set reuse address
-    if (setsockopt(lssdp->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0) {
-        lssdp_error("setsockopt SO_REUSEADDR failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
-    // set FD_CLOEXEC (http://kaivy2001.pixnet.net/blog/post/32726732)
-    int sock_opt = fcntl(lssdp->sock, F_GETFD);
-    if (sock_opt == -1) {
-        lssdp_error("fcntl F_GETFD failed, errno = %s (%d)\n", strerror(errno), errno);
-    } else {
-        // F_SETFD
-        if (fcntl(lssdp->sock, F_SETFD, sock_opt | FD_CLOEXEC) == -1) {
-            lssdp_error("fcntl F_SETFD FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
-        }
-    }
-
-    // bind socket
-    struct sockaddr_in addr = {
-        .sin_family      = AF_INET,
-        .sin_port        = htons(lssdp->port),
-        .sin_addr.s_addr = htonl(INADDR_ANY)
-    };
-    if (bind(lssdp->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
-        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
-    // set IP_ADD_MEMBERSHIP
-    struct ip_mreq imr = {
-        .imr_multiaddr.s_addr = inet_addr(Global.ADDR_MULTICAST),
-        .imr_interface.s_addr = htonl(INADDR_ANY)
-    };
-    if (setsockopt(lssdp->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imr, sizeof(struct ip_mreq)) != 0) {
-        lssdp_error("setsockopt IP_ADD_MEMBERSHIP failed: %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
-
     lssdp_info("create SSDP socket %d\n", lssdp->sock);
-    result = 0;
-end:
-    if (result == -1) {
-        lssdp_socket_close(lssdp);
-    }
-    return result;
+    return 0;
 }
 
 // 03. lssdp_socket_close
@@ -289,17 +421,22 @@ int lssdp_socket_close(lssdp_ctx * lssdp) {
         return -1;
     }
 
+    // the socket is owned by SSDP hub
+    if (lssdp->hub != NULL) {
+        goto end;
+    }
+
     // check lssdp->sock
     if (lssdp->sock <= 0) {
         lssdp_warn("SSDP socket is %d, ignore socket_close request.\n", lssdp->sock);
         goto end;
     }
 
-    // close socket
-    if (close(lssdp->sock) != 0) {
-        lssdp_error("close socket %d failed, errno = %s (%d)\n", lssdp->sock, strerror(errno), errno);
+    // close socket by transport
+    const lssdp_transport * transport = get_transport(lssdp);
+    if (transport->socket_close(lssdp, lssdp->sock) != 0) {
         return -1;
-    };
+    }
 
     // close socket success
     lssdp_info("close SSDP socket %d\n", lssdp->sock);
@@ -316,68 +453,46 @@ int lssdp_socket_read(lssdp_ctx * lssdp) {
         return -1;
     }
 
-    // check socket and port
-    if (lssdp->sock <= 0) {
-        lssdp_error("SSDP socket (%d) has not been setup.\n", lssdp->sock);
-        return -1;
-    }
-
-    if (lssdp->port == 0) {
-        lssdp_error("SSDP port (%d) has not been setup.\n", lssdp->port);
-        return -1;
-    }
-
     char buffer[LSSDP_BUFFER_LEN] = {};
     struct sockaddr_in address = {};
-    socklen_t address_len = sizeof(struct sockaddr_in);
-
-    ssize_t recv_len = recvfrom(lssdp->sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&address, &address_len);
-    if (recv_len == -1) {
-        lssdp_error("recvfrom fd %d failed, errno = %s (%d)\n", lssdp->sock, strerror(errno), errno);
+    long long timestamp = 0;
+    ssize_t recv_len = lssdp_socket_recv(lssdp, buffer, sizeof(buffer), &address, &timestamp);
+    if (recv_len < 0) {
         return -1;
     }
 
     // ignore the SSDP packet received from self
-    size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        if (lssdp->interface[i].addr == address.sin_addr.s_addr) {
-            goto end;
-        }
+    if (lssdp_is_self_address(lssdp, AF_INET, &address.sin_addr)) {
+        lssdp->stats.packet_self++;
+        goto end;
     }
 
     // parse SSDP packet to struct
     lssdp_packet packet = {};
-    if (lssdp_packet_parser(buffer, recv_len, &packet) != 0) {
+    if (lssdp_packet_parser(lssdp, buffer, recv_len, &packet) != 0) {
+        lssdp->stats.packet_invalid++;
         goto end;
     }
 
-    // check search target
-    if (strcmp(packet.st, lssdp->header.search_target) != 0) {
-        // search target is not match
-        if (lssdp->debug) {
-            lssdp_info("RECV <- %-8s   not match with %-14s %s\n", packet.method, lssdp->header.search_target, packet.location);
-        }
+    // set update_time: arrival time of packet
+    packet.update_time = packet_arrival_time(lssdp, timestamp);
+    if (packet.update_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", packet.update_time);
         goto end;
     }
 
-    // M-SEARCH: send RESPONSE back
-    if (strcmp(packet.method, Global.MSEARCH) == 0) {
-        lssdp_send_response(lssdp, address);
-        goto end;
+    // collect RESPONSE by search session
+    packet.addr = address.sin_addr.s_addr;
+    if (lssdp->search.num > 0) {
+        search_packet_process(lssdp, &packet);
     }
 
-    // RESPONSE, NOTIFY: add to neighbor_list
-    neighbor_list_add(lssdp, packet);
-
-    if (lssdp->debug) {
-        lssdp_info("RECV <- %-8s   %-28s  %s\n", packet.method, packet.location, packet.sm_id);
-    }
+    // process SSDP packet
+    lssdp_packet_process(lssdp, &packet, address);
 
 end:
     // invoke packet received callback
-    if (lssdp->packet_received_callback != NULL) {
-        lssdp->packet_received_callback(lssdp, buffer, recv_len);
-    }
+    packet_received(lssdp, buffer, recv_len, address.sin_addr.s_addr);
 
     return 0;
 }
@@ -394,45 +509,7 @@ int lssdp_send_msearch(lssdp_ctx * lssdp) {
         return -1;
     }
 
-    // check network inerface number
-    if (lssdp->interface_num == 0) {
-        lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.MSEARCH);
-        return -1;
-    }
-
-    // 1. set M-SEARCH packet
-    char msearch[LSSDP_BUFFER_LEN] = {};
-    snprintf(msearch, sizeof(msearch),
-        "%s"
-        "HOST:%s:%d\r\n"
-        "MAN:\"ssdp:discover\"\r\n"
-        "MX:1\r\n"
-        "ST:%s\r\n"
-        "USER-AGENT:OS/version product/version\r\n"
-        "\r\n",
-        Global.HEADER_MSEARCH,              // HEADER
-        Global.ADDR_MULTICAST, lssdp->port, // HOST
-        lssdp->header.search_target         // ST (Search Target)
-    );
-
-    // 2. send M-SEARCH to each interface
-    size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        struct lssdp_interface * interface = &lssdp->interface[i];
-
-        // avoid sending multicast to localhost
-        if (interface->addr == inet_addr(Global.ADDR_LOCALHOST)) {
-            continue;
-        }
-
-        // send M-SEARCH
-        int ret = send_multicast_data(msearch, *interface, lssdp->port);
-        if (ret == 0 && lssdp->debug) {
-            lssdp_info("SEND => %-8s   %s => MULTICAST\n", Global.MSEARCH, interface->ip);
-        }
-    }
-
-    return 0;
+    return send_msearch_multicast(lssdp, lssdp->header.search_target);
 }
 
 // 06. lssdp_send_notify
@@ -453,6 +530,18 @@ int lssdp_send_notify(lssdp_ctx * lssdp) {
         return -1;
     }
 
+    // rebuild packet template if header is changed
+    if (packet_template_update(lssdp) != 0) {
+        return -1;
+    }
+
+    char * domain = lssdp->header.location.domain;
+    struct iovec iov[3] = {
+        packet_template_segment(lssdp, LSSDP_TEMPLATE_NOTIFY_HEAD),
+        iov_string(domain),                                 // LOCATION host: domain or interface IP
+        packet_template_segment(lssdp, LSSDP_TEMPLATE_NOTIFY_TAIL)
+    };
+
     size_t i;
     for (i = 0; i < lssdp->interface_num; i++) {
         struct lssdp_interface * interface = &lssdp->interface[i];
@@ -462,34 +551,13 @@ int lssdp_send_notify(lssdp_ctx * lssdp) {
             continue;
         }
 
-        // set notify packet
-        char notify[LSSDP_BUFFER_LEN] = {};
-        char * domain = lssdp->header.location.domain;
-        snprintf(notify, sizeof(notify),
-            "%s"
-            "HOST:%s:%d\r\n"
-            "CACHE-CONTROL:max-age=120\r\n"
-            "LOCATION:%s%s%s\r\n"
-            "SERVER:OS/version product/version\r\n"
-            "NT:%s\r\n"
-            "NTS:ssdp:alive\r\n"
-            "USN:%s\r\n"
-            "SM_ID:%s\r\n"
-            "DEV_TYPE:%s\r\n"
-            "\r\n",
-            Global.HEADER_NOTIFY,                       // HEADER
-            Global.ADDR_MULTICAST, lssdp->port,         // HOST
-            lssdp->header.location.prefix,              // LOCATION
-            strlen(domain) > 0 ? domain : interface->ip,
-            lssdp->header.location.suffix,
-            lssdp->header.search_target,                // NT (Notify Type)
-            lssdp->header.unique_service_name,          // USN
-            lssdp->header.sm_id,                        // SM_ID    (addtional field)
-            lssdp->header.device_type                   // DEV_TYPE (addtional field)
-        );
+        // set LOCATION host to interface IP if domain is empty
+        if (strlen(domain) == 0) {
+            iov[1] = iov_string(interface->ip);
+        }
 
         // send NOTIFY
-        int ret = send_multicast_data(notify, *interface, lssdp->port);
+        int ret = send_multicast_data(lssdp, iov, 3, interface);
         if (ret == 0 && lssdp->debug) {
             lssdp_info("SEND => %-8s   %s => MULTICAST\n", Global.NOTIFY, interface->ip);
         }
@@ -514,474 +582,4357 @@ int lssdp_neighbor_check_timeout(lssdp_ctx * lssdp) {
         return 0;
     }
 
-    long long current_time = get_current_time();
+    long long current_time = get_current_time(lssdp);
     if (current_time < 0) {
         lssdp_error("got invalid timestamp %lld\n", current_time);
         return -1;
     }
 
+    long probe_timeout = lssdp->neighbor_timeout / 100 * LSSDP_NEIGHBOR_PROBE_RATIO;
+
     bool is_changed = false;
-    lssdp_nbr * prev = NULL;
-    lssdp_nbr * nbr  = lssdp->neighbor_list;
+    lssdp_nbr * nbr = lssdp->neighbor_list;
     while (nbr != NULL) {
         long pass_time = current_time - nbr->update_time;
         if (pass_time < lssdp->neighbor_timeout) {
-            prev = nbr;
-            nbr  = nbr->next;
+            // neighbor list is ordered by update_time, the rest neighbors are neither timeout nor need probe
+            if (lssdp->neighbor_probe == false || pass_time < probe_timeout) {
+                break;
+            }
+
+            /* probe neighbor once before timeout, the RESPONSE will refresh update_time.
+             * ST of the neighbor is searched, the neighbor may not answer search_target (st_match prefix, monitor)
+             */
+            if (nbr->probe_time < nbr->update_time) {
+                nbr->probe_time = current_time;
+                send_msearch_unicast(lssdp, nbr->addr, nbr->st);
+            }
+
+            nbr = nbr->next;
             continue;
         }
 
         is_changed = true;
+        lssdp->msearch.is_changed = true;
         lssdp_warn("remove timeout SSDP neighbor: %s (%s) (%ldms)\n", nbr->sm_id, nbr->location, pass_time);
 
-        if (prev == NULL) {
-            // it's first neighbor in list
-            lssdp->neighbor_list = nbr->next;
-            free(nbr);
-            nbr = lssdp->neighbor_list;
-        } else {
-            prev->next = nbr->next;
-            free(nbr);
-            nbr = prev->next;
-        }
+        lssdp_nbr * next = nbr->next;
+        neighbor_list_unlink(lssdp, nbr);
+        neighbor_event(lssdp, LSSDP_NEIGHBOR_REMOVED, nbr);
+        neighbor_free(nbr);
+        nbr = next;
     }
 
     // invoke neighbor list changed callback
-    if (is_changed == true && lssdp->neighbor_list_changed_callback != NULL) {
-        lssdp->neighbor_list_changed_callback(lssdp);
+    if (is_changed == true) {
+        neighbor_list_changed(lssdp);
     }
     return 0;
 }
 
 // 08. lssdp_set_log_callback
 void lssdp_set_log_callback(void (* callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message)) {
-    Global.log_callback = callback;
+    Global.log_callback      = callback;
+    Global.log_callback_data = NULL;
+    Global.log_user_data     = NULL;
 }
 
-
-/** Internal Function **/
-
-static int send_multicast_data(const char * data, const struct lssdp_interface interface, unsigned short ssdp_port) {
-    if (data == NULL) {
-        lssdp_error("data should not be NULL\n");
+// 09. lssdp_msearch_schedule
+int lssdp_msearch_schedule(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
         return -1;
     }
 
-    size_t data_len = strlen(data);
-    if (data_len == 0) {
-        lssdp_error("data length should not be empty\n");
+    long long current_time = get_current_time(lssdp);
+    if (current_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", current_time);
         return -1;
     }
 
-    if (strlen(interface.name) == 0) {
-        lssdp_error("interface.name should not be empty\n");
-        return -1;
+    // check M-SEARCH is due or not
+    if (lssdp->msearch.interval > 0 && current_time < lssdp->msearch.next_time) {
+        return 0;
     }
 
-    int result = -1;
-
-    // 1. create UDP socket
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) {
-        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+    long interval_min = lssdp->msearch.interval_min > 0 ? lssdp->msearch.interval_min : LSSDP_MSEARCH_INTERVAL_MIN;
+    long interval_max = lssdp->msearch.interval_max > 0 ? lssdp->msearch.interval_max : LSSDP_MSEARCH_INTERVAL_MAX;
+    if (interval_max < interval_min) {
+        interval_max = interval_min;
     }
 
-    // 2. bind socket
-    struct sockaddr_in addr = {
-        .sin_family      = AF_INET,
-        .sin_addr.s_addr = interface.addr
-    };
-    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+    // 1. update interval: search aggressively while neighbor set is changing, otherwise back off
+    long interval = lssdp->msearch.interval;
+    if (interval <= 0 || lssdp->msearch.is_changed) {
+        interval = interval_min;
+    } else {
+        interval = interval < interval_max / 2 ? interval * 2 : interval_max;
     }
 
-    // 3. disable IP_MULTICAST_LOOP
-    char opt = 0;
-    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &opt, sizeof(opt)) < 0) {
-        lssdp_error("setsockopt IP_MULTICAST_LOOP failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
+    lssdp->msearch.interval   = interval;
+    lssdp->msearch.next_time  = current_time + interval;
+    lssdp->msearch.is_changed = false;
 
-    // 4. set destination address
-    struct sockaddr_in dest_addr = {
-        .sin_family = AF_INET,
-        .sin_port = htons(ssdp_port)
-    };
-    if (inet_aton(Global.ADDR_MULTICAST, &dest_addr.sin_addr) == 0) {
-        lssdp_error("inet_aton failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+    if (lssdp->debug) {
+        lssdp_info("next %s after %ld ms\n", Global.MSEARCH, interval);
     }
 
-    // 5. send data
-    if (sendto(fd, data, data_len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) == -1) {
-        lssdp_error("sendto %s (%s) failed, errno = %s (%d)\n", interface.name, interface.ip, strerror(errno), errno);
-        goto end;
-    }
+    // 2. send M-SEARCH
+    return lssdp_send_msearch(lssdp);
+}
 
-    result = 0;
-end:
-    if (fd >= 0 && close(fd) != 0) {
-        lssdp_error("close fd %d failed, errno = %s (%d)\n", strerror(errno), errno);
+// 10. lssdp_send_msearch_unicast
+int lssdp_send_msearch_unicast(lssdp_ctx * lssdp, uint32_t address) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
     }
-    return result;
+
+    return send_msearch_unicast(lssdp, address, lssdp->header.search_target);
 }
 
-static int lssdp_send_response(lssdp_ctx * lssdp, struct sockaddr_in address) {
-    // get M-SEARCH IP
-    char msearch_ip[LSSDP_IP_LEN] = {};
-    if (inet_ntop(AF_INET, &address.sin_addr, msearch_ip, sizeof(msearch_ip)) == NULL) {
-        lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
+// 11. lssdp_hub_add
+int lssdp_hub_add(lssdp_hub * hub, lssdp_ctx * lssdp) {
+    if (hub == NULL || lssdp == NULL) {
+        lssdp_error("hub and lssdp should not be NULL\n");
         return -1;
     }
 
-    // 1. find the interface which is in LAN
-    struct lssdp_interface * interface = find_interface_in_LAN(lssdp, address.sin_addr.s_addr);
-    if (interface == NULL) {
-        if (lssdp->debug) {
-            lssdp_info("RECV <- %-8s   Interface is not found        %s\n", Global.MSEARCH, msearch_ip);
+    if (lssdp == &hub->ctx) {
+        lssdp_error("hub.ctx should not be registered to hub\n");
+        return -1;
+    }
+
+    if (lssdp->hub != NULL && lssdp->hub != hub) {
+        lssdp_error("lssdp has been registered to another hub\n");
+        return -1;
+    }
+
+    // 1. add to context list, if it has not been registered
+    if (lssdp->hub == NULL) {
+        if (hub->ctx_num >= hub->ctx_list_size) {
+            size_t size = hub->ctx_list_size > 0 ? hub->ctx_list_size * 2 : 8;
+            lssdp_ctx ** list = (lssdp_ctx **) realloc(hub->ctx_list, size * sizeof(lssdp_ctx *));
+            if (list == NULL) {
+                lssdp_error("realloc failed, errno = %s (%d)\n", strerror(errno), errno);
+                return -1;
+            }
+            hub->ctx_list      = list;
+            hub->ctx_list_size = size;
         }
 
-        if (lssdp->interface_num == 0) {
-            lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.RESPONSE);
+        // close original socket, then share hub socket
+        if (lssdp->sock > 0) {
+            lssdp_socket_close(lssdp);
         }
+        lssdp->hub = hub;
+        hub->ctx_list[hub->ctx_num++] = lssdp;
+        hub_sync(hub, lssdp);
+    }
+
+    // 2. re-index search target
+    st_pattern_compile(lssdp->header.search_target, &lssdp->st_pattern);
+    return hub_index_rebuild(hub);
+}
+
+// 12. lssdp_hub_remove
+int lssdp_hub_remove(lssdp_hub * hub, lssdp_ctx * lssdp) {
+    if (hub == NULL || lssdp == NULL) {
+        lssdp_error("hub and lssdp should not be NULL\n");
         return -1;
     }
 
-    // 2. set response packet
-    char response[LSSDP_BUFFER_LEN] = {};
-    char * domain = lssdp->header.location.domain;
-    int response_len = snprintf(response, sizeof(response),
-        "%s"
-        "CACHE-CONTROL:max-age=120\r\n"
-        "DATE:\r\n"
-        "EXT:\r\n"
-        "LOCATION:%s%s%s\r\n"
-        "SERVER:OS/version product/version\r\n"
-        "ST:%s\r\n"
-        "USN:%s\r\n"
-        "SM_ID:%s\r\n"
-        "DEV_TYPE:%s\r\n"
-        "\r\n",
-        Global.HEADER_RESPONSE,                     // HEADER
-        lssdp->header.location.prefix,              // LOCATION
-        strlen(domain) > 0 ? domain : interface->ip,
-        lssdp->header.location.suffix,
-        lssdp->header.search_target,                // ST (Search Target)
-        lssdp->header.unique_service_name,          // USN
-        lssdp->header.sm_id,                        // SM_ID    (addtional field)
-        lssdp->header.device_type                   // DEV_TYPE (addtional field)
-    );
+    size_t i;
+    for (i = 0; i < hub->ctx_num; i++) {
+        if (hub->ctx_list[i] != lssdp) {
+            continue;
+        }
 
-    // 3. set port to address
-    address.sin_port = htons(lssdp->port);
+        // keep registration order
+        memmove(&hub->ctx_list[i], &hub->ctx_list[i + 1], (hub->ctx_num - i - 1) * sizeof(lssdp_ctx *));
+        hub->ctx_num--;
 
-    if (lssdp->debug) {
-        lssdp_info("RECV <- %-8s   %s <- %s\n", Global.MSEARCH, interface->ip, msearch_ip);
+        lssdp->hub  = NULL;
+        lssdp->sock = -1;
+        lssdp_neighbor_remove_all(lssdp);
+        return hub_index_rebuild(hub);
     }
 
-    // 4. send data
-    if (sendto(lssdp->sock, response, response_len, 0, (struct sockaddr *)&address, sizeof(struct sockaddr_in)) == -1) {
-        lssdp_error("send RESPONSE to %s failed, errno = %s (%d)\n", msearch_ip, strerror(errno), errno);
+    lssdp_warn("lssdp is not registered to hub\n");
+    return -1;
+}
+
+// 13. lssdp_hub_network_interface_update
+int lssdp_hub_network_interface_update(lssdp_hub * hub) {
+    if (hub == NULL) {
+        lssdp_error("hub should not be NULL\n");
         return -1;
     }
 
-    if (lssdp->debug) {
-        lssdp_info("SEND => %-8s   %s => %s\n", Global.RESPONSE, interface->ip, msearch_ip);
-    }
+    int result = lssdp_network_interface_update(&hub->ctx);
 
-    return 0;
+    // share socket and network interface, socket may be re-created by network_interface_changed_callback
+    size_t i;
+    for (i = 0; i < hub->ctx_num; i++) {
+        hub_sync(hub, hub->ctx_list[i]);
+    }
+    return result;
 }
 
-static int lssdp_packet_parser(const char * data, size_t data_len, lssdp_packet * packet) {
-    if (data == NULL) {
-        lssdp_error("data should not be NULL\n");
+// 14. lssdp_hub_socket_read
+int lssdp_hub_socket_read(lssdp_hub * hub) {
+    if (hub == NULL) {
+        lssdp_error("hub should not be NULL\n");
         return -1;
     }
 
-    if (data_len != strlen(data)) {
-        lssdp_error("data_len (%zu) is not match to the data length (%zu)\n", data_len, strlen(data));
+    lssdp_ctx * lssdp = &hub->ctx;
+    char buffer[LSSDP_BUFFER_LEN] = {};
+    struct sockaddr_in address = {};
+    long long timestamp = 0;
+    ssize_t recv_len = lssdp_socket_recv(lssdp, buffer, sizeof(buffer), &address, &timestamp);
+    if (recv_len < 0) {
         return -1;
     }
 
-    if (packet == NULL) {
-        lssdp_error("packet should not be NULL\n");
-        return -1;
+    // ignore the SSDP packet received from self
+    if (lssdp_is_self_address(lssdp, AF_INET, &address.sin_addr)) {
+        lssdp->stats.packet_self++;
+        goto end;
+    }
+
+    // parse SSDP packet once
+    lssdp_packet packet = {};
+    if (lssdp_packet_parser(lssdp, buffer, recv_len, &packet) != 0) {
+        lssdp->stats.packet_invalid++;
+        goto end;
+    }
+    packet.addr = address.sin_addr.s_addr;
+    packet.update_time = packet_arrival_time(lssdp, timestamp);
+    if (packet.update_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", packet.update_time);
+        goto end;
+    }
+
+    // collect RESPONSE by search session of hub.ctx
+    if (lssdp->search.num > 0) {
+        search_packet_process(lssdp, &packet);
     }
 
-    // 1. compare SSDP Method Header: M-SEARCH, NOTIFY, RESPONSE
     size_t i;
-    if ((i = strlen(Global.HEADER_MSEARCH)) < data_len && memcmp(data, Global.HEADER_MSEARCH, i) == 0) {
-        strcpy(packet->method, Global.MSEARCH);
-    } else if ((i = strlen(Global.HEADER_NOTIFY)) < data_len && memcmp(data, Global.HEADER_NOTIFY, i) == 0) {
-        strcpy(packet->method, Global.NOTIFY);
-    } else if ((i = strlen(Global.HEADER_RESPONSE)) < data_len && memcmp(data, Global.HEADER_RESPONSE, i) == 0) {
-        strcpy(packet->method, Global.RESPONSE);
-    } else {
-        lssdp_warn("received unknown SSDP packet\n");
-        lssdp_debug("%s\n", data);
-        return -1;
+
+    // 1. M-SEARCH ssdp:all: every context
+    if (strcmp(packet.method, Global.MSEARCH) == 0 && strcmp(packet.st, Global.ST_ALL) == 0) {
+        for (i = 0; i < hub->ctx_num; i++) {
+            lssdp_packet_process(hub->ctx_list[i], &packet, address);
+        }
+        goto end;
     }
 
-    // 2. parse each field line
-    size_t start = i;
-    for (i = start; i < data_len; i++) {
-        if (data[i] == '\n' && i - 1 > start && data[i - 1] == '\r') {
-            parse_field_line(data, start, i - 2, packet);
-            start = i + 1;
+    // 2. contexts indexed by search target
+    if (hub->st_index_size > 0) {
+        uint32_t hash = hub_st_hash(packet.st);
+        size_t mask = hub->st_index_size - 1;
+        for (i = hash & mask; hub->st_index[i].ctx != NULL; i = (i + 1) & mask) {
+            if (hub->st_index[i].hash == hash) {
+                lssdp_packet_process(hub->st_index[i].ctx, &packet, address);
+            }
         }
     }
 
-    // 3. set update_time
-    long long current_time = get_current_time();
-    if (current_time < 0) {
-        lssdp_error("got invalid timestamp %lld\n", current_time);
-        return -1;
+    // 3. wildcard contexts
+    for (i = 0; i < hub->wildcard_num; i++) {
+        lssdp_packet_process(hub->wildcard_list[i], &packet, address);
     }
-    packet->update_time = current_time;
+
+end:
+    // invoke packet received callback
+    packet_received(lssdp, buffer, recv_len, address.sin_addr.s_addr);
+
     return 0;
 }
 
-static int parse_field_line(const char * data, size_t start, size_t end, lssdp_packet * packet) {
-    // 1. find the colon
-    if (data[start] == ':') {
-        lssdp_warn("the first character of line should not be colon\n");
-        lssdp_debug("%s\n", data);
+// 15. lssdp_hub_close
+int lssdp_hub_close(lssdp_hub * hub) {
+    if (hub == NULL) {
+        lssdp_error("hub should not be NULL\n");
         return -1;
     }
 
-    int colon = get_colon_index(data, start + 1, end);
-    if (colon == -1) {
-        lssdp_warn("there is no colon in line\n");
-        lssdp_debug("%s\n", data);
+    // 1. unregister all contexts
+    size_t i;
+    for (i = 0; i < hub->ctx_num; i++) {
+        lssdp_ctx * lssdp = hub->ctx_list[i];
+        lssdp->hub  = NULL;
+        lssdp->sock = -1;
+        lssdp_neighbor_remove_all(lssdp);
+    }
+
+    // 2. free hub resources
+    free(hub->ctx_list);
+    free(hub->st_index);
+    free(hub->wildcard_list);
+    hub->ctx_list      = NULL;
+    hub->st_index      = NULL;
+    hub->wildcard_list = NULL;
+    hub->ctx_num = hub->ctx_list_size = hub->st_index_size = hub->wildcard_num = 0;
+
+    // 3. close SSDP socket
+    lssdp_self_address_clear(&hub->ctx);
+    return lssdp_socket_close(&hub->ctx);
+}
+
+
+
+// 16. lssdp_capture_open
+int lssdp_capture_open(lssdp_ctx * lssdp, const char * path) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
         return -1;
     }
 
-    if (colon == end) {
-        // value is empty
+    if (path == NULL) {
+        lssdp_error("capture path should not be NULL\n");
         return -1;
     }
 
+    // close original capture
+    lssdp_capture_close(lssdp);
 
-    // 2. get field, field_len
-    size_t i = start;
-    size_t j = colon - 1;
-    if (trim_spaces(data, &i, &j) == -1) {
+    FILE * file = fopen(path, "wb");
+    if (file == NULL) {
+        lssdp_error("open capture file %s failed, errno = %s (%d)\n", path, strerror(errno), errno);
         return -1;
     }
-    const char * field = &data[i];
-    size_t field_len = j - i + 1;
-
 
-    // 3. get value, value_len
-    i = colon + 1;
-    j = end;
-    if (trim_spaces(data, &i, &j) == -1) {
+    // 1. Section Header Block: byte order magic, version 1.0, unknown section length
+    struct {
+        uint32_t    magic;
+        uint16_t    major;
+        uint16_t    minor;
+        uint32_t    length[2];
+    } shb = {PCAPNG_BYTE_ORDER_MAGIC, 1, 0, {0xFFFFFFFF, 0xFFFFFFFF}};
+
+    // 2. Interface Description Block: raw IP, microsecond timestamp (default resolution)
+    struct {
+        uint16_t    link_type;
+        uint16_t    reserved;
+        uint32_t    snap_len;
+    } idb = {PCAPNG_LINKTYPE_RAW, 0, LSSDP_BUFFER_LEN + 28};
+
+    struct iovec shb_iov = {&shb, sizeof(shb)};
+    struct iovec idb_iov = {&idb, sizeof(idb)};
+    if (capture_write_block(file, PCAPNG_BLOCK_SHB, &shb_iov, 1) != 0
+     || capture_write_block(file, PCAPNG_BLOCK_IDB, &idb_iov, 1) != 0) {
+        lssdp_error("write capture file %s failed, errno = %s (%d)\n", path, strerror(errno), errno);
+        fclose(file);
         return -1;
-    };
-    const char * value = &data[i];
-    size_t value_len = j - i + 1;
+    }
 
+    lssdp->capture = file;
+    lssdp_info("capture received packets into %s\n", path);
+    return 0;
+}
 
-    // 4. set each field's value to packet
-    if (field_len == strlen("st") && strncasecmp(field, "st", field_len) == 0) {
-        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
+// 17. lssdp_capture_close
+int lssdp_capture_close(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
     }
 
-    if (field_len == strlen("nt") && strncasecmp(field, "nt", field_len) == 0) {
-        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+    if (lssdp->capture == NULL) {
         return 0;
     }
 
-    if (field_len == strlen("usn") && strncasecmp(field, "usn", field_len) == 0) {
-        memcpy(packet->usn, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
+    int ret = fclose(lssdp->capture);
+    lssdp->capture = NULL;
+    if (ret != 0) {
+        lssdp_error("close capture file failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
     }
+    return 0;
+}
 
-    if (field_len == strlen("location") && strncasecmp(field, "location", field_len) == 0) {
-        memcpy(packet->location, value, value_len < LSSDP_LOCATION_LEN ? value_len : LSSDP_LOCATION_LEN - 1);
-        return 0;
+
+// 18. lssdp_self_address_add
+int lssdp_self_address_add(lssdp_ctx * lssdp, int family, const void * address) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
     }
 
-    if (field_len == strlen("sm_id") && strncasecmp(field, "sm_id", field_len) == 0) {
-        memcpy(packet->sm_id, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
+    // the context in SSDP hub shares the set of hub.ctx
+    if (lssdp->hub != NULL) {
+        lssdp = &lssdp->hub->ctx;
     }
 
-    if (field_len == strlen("dev_type") && strncasecmp(field, "dev_type", field_len) == 0) {
-        memcpy(packet->device_type, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+    uint8_t key[16];
+    if (self_address_key(family, address, key) != 0) {
+        lssdp_error("invalid address family %d\n", family);
+        return -1;
+    }
+
+    // all zero is empty slot, :: is never a local address
+    static const uint8_t EMPTY[16] = {};
+    if (memcmp(key, EMPTY, 16) == 0) {
         return 0;
     }
 
-    // the field is not in the struct packet
-    return 0;
-}
+    int ret = self_address_insert(lssdp, key, true);
+    if (ret < 0) {
+        return -1;
+    }
 
-static int get_colon_index(const char * string, size_t start, size_t end) {
-    size_t i;
-    for (i = start; i <= end; i++) {
-        if (string[i] == ':') {
-            return i;
-        }
+    // regenerate socket filter with the new address
+    if (ret > 0 && lssdp->sock > 0 && get_transport(lssdp) == &lssdp_transport_udp) {
+        udp_socket_filter(lssdp, lssdp->sock);
     }
-    return -1;
+    return 0;
 }
 
-static int trim_spaces(const char * string, size_t * start, size_t * end) {
-    int i = *start;
-    int j = *end;
+// 19. lssdp_is_self_address
+bool lssdp_is_self_address(lssdp_ctx * lssdp, int family, const void * address) {
+    if (lssdp != NULL && lssdp->hub != NULL) {
+        lssdp = &lssdp->hub->ctx;
+    }
 
-    while (i <= *end   && (!isprint(string[i]) || isspace(string[i]))) i++;
-    while (j >= *start && (!isprint(string[j]) || isspace(string[j]))) j--;
+    if (lssdp == NULL || lssdp->self_address.num == 0) {
+        return false;
+    }
 
-    if (i > j) {
-        return -1;
+    // all zero key would match an empty slot
+    static const uint8_t EMPTY[16] = {};
+    uint8_t key[16];
+    if (self_address_key(family, address, key) != 0 || memcmp(key, EMPTY, 16) == 0) {
+        return false;
     }
+    return memcmp(self_address_find(lssdp, key)->addr, key, 16) == 0;
+}
 
-    *start = i;
-    *end   = j;
-    return 0;
+
+// 20. lssdp_set_log_callback_data
+void lssdp_set_log_callback_data(void (* callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message, void * user_data), void * user_data) {
+    Global.log_callback      = NULL;
+    Global.log_callback_data = callback;
+    Global.log_user_data     = user_data;
 }
 
-static long long get_current_time() {
-    struct timeval time = {};
-    if (gettimeofday(&time, NULL) == -1) {
-        lssdp_error("gettimeofday failed, errno = %s (%d)\n", strerror(errno), errno);
+// 21. lssdp_next_timeout
+long lssdp_next_timeout(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
         return -1;
     }
-    return (long long) time.tv_sec * 1000 + (long long) time.tv_usec / 1000;
-}
 
-static int lssdp_log(int level, int line, const char * func, const char * format, ...) {
-    if (Global.log_callback == NULL) {
+    long long current_time = get_current_time(lssdp);
+    if (current_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", current_time);
         return -1;
     }
 
-    char message[LSSDP_BUFFER_LEN] = {};
-
-    // create message by va_list
-    va_list args;
-    va_start(args, format);
-    vsnprintf(message, LSSDP_BUFFER_LEN, format, args);
-    va_end(args);
+    long long next_time = -1;
 
-    // invoke log callback function
-    Global.log_callback(__FILE__, "SSDP", level, line, func, message);
-    return 0;
-}
+    // 1. M-SEARCH scheduler, counted after the first lssdp_msearch_schedule
+    if (lssdp->msearch.interval > 0) {
+        next_time = lssdp->msearch.next_time;
+    }
 
-static int neighbor_list_add(lssdp_ctx * lssdp, const lssdp_packet packet) {
-    lssdp_nbr * last_nbr = lssdp->neighbor_list;
+    // 2. search session, session list is ordered by deadline
+    if (lssdp->search.list != NULL && (next_time < 0 || lssdp->search.list->deadline < next_time)) {
+        next_time = lssdp->search.list->deadline;
+    }
 
-    bool is_changed = false;
-    lssdp_nbr * nbr;
-    for (nbr = lssdp->neighbor_list; nbr != NULL; last_nbr = nbr, nbr = nbr->next) {
-        if (strcmp(nbr->location, packet.location) != 0) {
-            // location is not match
-            continue;
+    // 3. neighbor timeout and probe, neighbor list is ordered by update_time
+    if (lssdp->neighbor_timeout > 0 && lssdp->neighbor_list != NULL) {
+        long long timeout_time = lssdp->neighbor_list->update_time + lssdp->neighbor_timeout;
+        if (next_time < 0 || timeout_time < next_time) {
+            next_time = timeout_time;
         }
 
-        /* location is not found in SSDP list: update neighbor */
-
-        // usn
-        if (strcmp(nbr->usn, packet.usn) != 0) {
-            lssdp_debug("neighbor usn is changed. (%s -> %s)\n", nbr->usn, packet.usn);
-            memcpy(nbr->usn, packet.usn, LSSDP_FIELD_LEN);
-            is_changed = true;
+        if (lssdp->neighbor_probe == true) {
+            long probe_timeout = lssdp->neighbor_timeout / 100 * LSSDP_NEIGHBOR_PROBE_RATIO;
+            lssdp_nbr * nbr;
+            for (nbr = lssdp->neighbor_list; nbr != NULL; nbr = nbr->next) {
+                long long probe_time = nbr->update_time + probe_timeout;
+                if (probe_time >= next_time) {
+                    break;
+                }
+
+                // the first neighbor which has not been probed
+                if (nbr->probe_time < nbr->update_time) {
+                    next_time = probe_time;
+                    break;
+                }
+            }
         }
+    }
 
-        // sm_id
-        if (strcmp(nbr->sm_id, packet.sm_id) != 0) {
-            lssdp_debug("neighbor sm_id is changed. (%s -> %s)\n", nbr->sm_id, packet.sm_id);
-            memcpy(nbr->sm_id, packet.sm_id, LSSDP_FIELD_LEN);
-            is_changed = true;
+    // 4. description fetch: waiting fetch which can be started, timeout and completed fetch
+    if (fetch_startable(lssdp)) {
+        next_time = current_time;
+    }
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        long long deadline = fetch->state == FETCH_DONE ? current_time : fetch->deadline;
+        if (next_time < 0 || deadline < next_time) {
+            next_time = deadline;
         }
+    }
 
-        // device type
-        if (strcmp(nbr->device_type, packet.device_type) != 0) {
-            lssdp_debug("neighbor device_type is changed. (%s -> %s)\n", nbr->device_type, packet.device_type);
-            memcpy(nbr->device_type, packet.device_type, LSSDP_FIELD_LEN);
-            is_changed = true;
+    // 5. description responder: idle connection
+    lssdp_http_connection * conn;
+    for (conn = lssdp->http.connection; conn != NULL; conn = conn->next) {
+        if (next_time < 0 || conn->deadline < next_time) {
+            next_time = conn->deadline;
         }
-
-        // update_time
-        nbr->update_time = packet.update_time;
-        goto end;
     }
 
+    if (next_time < 0) {
+        return -1;
+    }
+    if (next_time <= current_time) {
+        return 0;
+    }
+    return (long) (next_time - current_time);
+}
 
-    /* location is not found in SSDP list: add to list */
-
-    // 1. memory allocate lssdp_nbr
-    nbr = (lssdp_nbr *) malloc(sizeof(lssdp_nbr));
-    if (nbr == NULL) {
-        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+// 22. lssdp_search_start
+int lssdp_search_start(lssdp_ctx * lssdp, const char * st, long timeout, void (* callback)(lssdp_ctx * lssdp, const lssdp_search * search, void * user_data), void * user_data) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
         return -1;
     }
 
-    // 2. setup neighbor
-    memcpy(nbr->usn,         packet.usn,         LSSDP_FIELD_LEN);
-    memcpy(nbr->sm_id,       packet.sm_id,       LSSDP_FIELD_LEN);
-    memcpy(nbr->device_type, packet.device_type, LSSDP_FIELD_LEN);
-    memcpy(nbr->location,    packet.location,    LSSDP_LOCATION_LEN);
-    nbr->update_time = packet.update_time;
-    nbr->next = NULL;
+    if (callback == NULL) {
+        lssdp_error("callback should not be NULL\n");
+        return -1;
+    }
 
-    // 3. add neighbor to the end of list
-    if (last_nbr == NULL) {
-        // it's the first neighbor
-        lssdp->neighbor_list = nbr;
-    } else {
-        last_nbr->next = nbr;
+    if (timeout <= 0) {
+        lssdp_error("search timeout (%ld) is invalid\n", timeout);
+        return -1;
     }
 
-    is_changed = true;
-end:
-    // invoke neighbor list changed callback
-    if (lssdp->neighbor_list_changed_callback != NULL && is_changed == true) {
-        lssdp->neighbor_list_changed_callback(lssdp);
+    if (lssdp->port == 0) {
+        lssdp_error("SSDP port (%d) has not been setup.\n", lssdp->port);
+        return -1;
     }
 
-    return 0;
-}
+    long long current_time = get_current_time(lssdp);
+    if (current_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", current_time);
+        return -1;
+    }
 
-static int lssdp_neighbor_remove_all(lssdp_ctx * lssdp) {
-    if (lssdp->neighbor_list == NULL) {
-        return 0;
+    // 1. memory allocate lssdp_search
+    lssdp_search * search = (lssdp_search *) calloc(1, sizeof(lssdp_search));
+    if (search == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
     }
 
-    // free neighbor_list
-    neighbor_list_free(lssdp->neighbor_list);
-    lssdp->neighbor_list = NULL;
+    // 2. setup session
+    snprintf(search->st, LSSDP_FIELD_LEN, "%s", st != NULL ? st : lssdp->header.search_target);
+    search->start_time = current_time;
+    search->deadline   = current_time + timeout;
+    search->callback   = callback;
+    search->user_data  = user_data;
+    search->hash       = fnv1a_hash(0, search->st, strlen(search->st));
+
+    // 3. send M-SEARCH
+    if (send_msearch_multicast(lssdp, search->st) != 0) {
+        free(search);
+        return -1;
+    }
 
-    lssdp_info("neighbor list has been force clean up.\n");
+    // 4. add to session list ordered by deadline, and to session index
+    lssdp->search.last_id = lssdp->search.last_id < INT_MAX ? lssdp->search.last_id + 1 : 1;
+    search->id = lssdp->search.last_id;
 
-    // invoke neighbor list changed callback
-    if (lssdp->neighbor_list_changed_callback != NULL) {
-        lssdp->neighbor_list_changed_callback(lssdp);
+    lssdp_search ** prev = &lssdp->search.list;
+    while (*prev != NULL && (*prev)->deadline <= search->deadline) {
+        prev = &(*prev)->next;
     }
-    return 0;
-}
+    search->next = *prev;
+    *prev = search;
+
+    lssdp_search ** bucket = &lssdp->search.bucket[search->hash & (LSSDP_SEARCH_BUCKET_NUM - 1)];
+    search->hash_next = *bucket;
+    *bucket = search;
+    lssdp->search.num++;
 
-static void neighbor_list_free(lssdp_nbr * list) {
-    if (list != NULL) {
-        neighbor_list_free(list->next);
-        free(list);
+    if (lssdp->debug) {
+        lssdp_info("search session %d (%s) is started, timeout %ld ms\n", search->id, search->st, timeout);
     }
+    return search->id;
 }
 
-static struct lssdp_interface * find_interface_in_LAN(lssdp_ctx * lssdp, uint32_t address) {
+// 23. lssdp_search_cancel
+int lssdp_search_cancel(lssdp_ctx * lssdp, int id) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    int ret = id == 0 ? 0 : -1;
+    lssdp_search * search = lssdp->search.list;
+    while (search != NULL) {
+        lssdp_search * next = search->next;
+        if (id == 0 || search->id == id) {
+            search_unlink(lssdp, search);
+            search_free(search);
+            ret = 0;
+        }
+        search = next;
+    }
+    return ret;
+}
+
+// 24. lssdp_search_check_timeout
+int lssdp_search_check_timeout(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    if (lssdp->search.list == NULL) {
+        return 0;
+    }
+
+    long long current_time = get_current_time(lssdp);
+    if (current_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", current_time);
+        return -1;
+    }
+
+    // session list is ordered by deadline, callback may start or cancel sessions
+    while (lssdp->search.list != NULL && lssdp->search.list->deadline <= current_time) {
+        lssdp_search * search = lssdp->search.list;
+        search_unlink(lssdp, search);
+
+        if (lssdp->debug) {
+            lssdp_info("search session %d (%s) is completed, %zu results\n", search->id, search->st, search->result_num);
+        }
+        search->callback(lssdp, search, search->user_data);
+        search_free(search);
+    }
+    return 0;
+}
+
+// 25. lssdp_header_interest_add
+int lssdp_header_interest_add(lssdp_ctx * lssdp, const char * name) {
+    if (lssdp == NULL || name == NULL) {
+        lssdp_error("lssdp and name should not be NULL\n");
+        return -1;
+    }
+
+    size_t name_len = strlen(name);
+    if (name_len == 0 || name_len >= LSSDP_HEADER_NAME_LEN) {
+        lssdp_error("header name length (%zu) should be 1 ~ %d\n", name_len, LSSDP_HEADER_NAME_LEN - 1);
+        return -1;
+    }
+
+    size_t i;
+    for (i = 0; i < lssdp->header_interest.num; i++) {
+        if (strcasecmp(lssdp->header_interest.name[i], name) == 0) {
+            return i;
+        }
+    }
+
+    if (lssdp->header_interest.num >= LSSDP_HEADER_INTEREST_NUM) {
+        lssdp_error("header interest set is full (%d)\n", LSSDP_HEADER_INTEREST_NUM);
+        return -1;
+    }
+
+    memcpy(lssdp->header_interest.name[i], name, name_len + 1);
+    lssdp->header_interest.num++;
+    return i;
+}
+
+// 26. lssdp_neighbor_header
+const char * lssdp_neighbor_header(const lssdp_nbr * nbr, int index) {
+    if (nbr == NULL || index < 0 || index >= LSSDP_HEADER_INTEREST_NUM) {
+        return NULL;
+    }
+
+    const lssdp_extra_header * extra = &nbr->extra[index];
+    return extra->len > 0 ? &nbr->extra_arena[extra->offset] : NULL;
+}
+
+// 27. lssdp_event_fdset
+int lssdp_event_fdset(lssdp_ctx * lssdp, fd_set * read_fds, fd_set * write_fds) {
+    if (lssdp == NULL || read_fds == NULL || write_fds == NULL) {
+        lssdp_error("lssdp, read_fds and write_fds should not be NULL\n");
+        return -1;
+    }
+
+    int max_fd = -1;
+
+    // 1. SSDP socket, the socket of SSDP hub is read by lssdp_hub_socket_read
+    if (lssdp->hub == NULL && lssdp->sock > 0) {
+        FD_SET(lssdp->sock, read_fds);
+        max_fd = lssdp->sock;
+    }
+
+    // 2. description fetch connections
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        if (fetch->state == FETCH_DONE) {
+            continue;
+        }
+        FD_SET(fetch->sock, fetch->state == FETCH_RECEIVING ? read_fds : write_fds);
+        if (fetch->sock > max_fd) {
+            max_fd = fetch->sock;
+        }
+    }
+
+    // 3. description responder, stop accepting when connections are full
+    size_t connection_max = lssdp->http.connection_max > 0 ? lssdp->http.connection_max : LSSDP_HTTP_CONNECTION_MAX;
+    if (lssdp->http.sock > 0 && lssdp->http.connection_num < connection_max) {
+        FD_SET(lssdp->http.sock, read_fds);
+        if (lssdp->http.sock > max_fd) {
+            max_fd = lssdp->http.sock;
+        }
+    }
+
+    lssdp_http_connection * conn;
+    for (conn = lssdp->http.connection; conn != NULL; conn = conn->next) {
+        FD_SET(conn->sock, conn->state == HTTP_READING ? read_fds : write_fds);
+        if (conn->sock > max_fd) {
+            max_fd = conn->sock;
+        }
+    }
+    return max_fd;
+}
+
+// 28. lssdp_event_process
+int lssdp_event_process(lssdp_ctx * lssdp, const fd_set * read_fds, const fd_set * write_fds) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    lssdp_event_readiness ready = {
+        .read_fds  = read_fds,
+        .write_fds = write_fds,
+        .fd        = -1
+    };
+    return event_process(lssdp, &ready);
+}
+
+// 29. lssdp_fetch_close
+int lssdp_fetch_close(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    lssdp_fetch * list[2] = {lssdp->fetch.queue, lssdp->fetch.active};
+    size_t i;
+    for (i = 0; i < 2; i++) {
+        while (list[i] != NULL) {
+            lssdp_fetch * next = list[i]->next;
+            fetch_free(list[i]);
+            list[i] = next;
+        }
+    }
+
+    lssdp_fetch_cache * cache = lssdp->fetch.cache;
+    while (cache != NULL) {
+        lssdp_fetch_cache * next = cache->next;
+        free(cache->body);
+        free(cache);
+        cache = next;
+    }
+
+    lssdp->fetch.queue      = NULL;
+    lssdp->fetch.active     = NULL;
+    lssdp->fetch.active_num = 0;
+    lssdp->fetch.cache      = NULL;
+    lssdp->fetch.cache_num  = 0;
+    return 0;
+}
+
+// 30. lssdp_http_open
+int lssdp_http_open(lssdp_ctx * lssdp, unsigned short port) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    if (lssdp->http.sock > 0) {
+        lssdp_warn("HTTP socket is opened (%d), ignore http_open request.\n", lssdp->http.sock);
+        return 0;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    int result = -1;
+
+    // set non-blocking
+    int opt = 1;
+    if (ioctl(sock, FIONBIO, &opt) != 0) {
+        lssdp_error("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set reuse address
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0) {
+        lssdp_error("setsockopt SO_REUSEADDR failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set FD_CLOEXEC
+    int sock_opt = fcntl(sock, F_GETFD);
+    if (sock_opt == -1 || fcntl(sock, F_SETFD, sock_opt | FD_CLOEXEC) == -1) {
+        lssdp_error("fcntl FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+
+    // bind and listen
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY)
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+    if (listen(sock, SOMAXCONN) != 0) {
+        lssdp_error("listen failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+    if (getsockname(sock, (struct sockaddr *) &addr, &addr_len) != 0) {
+        lssdp_error("getsockname failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    lssdp->http.sock = sock;
+    lssdp->http.port = ntohs(addr.sin_port);
+    if (lssdp->debug) {
+        lssdp_info("open HTTP socket %d, port %u\n", sock, lssdp->http.port);
+    }
+    result = 0;
+end:
+    if (result != 0) {
+        close(sock);
+    }
+    return result;
+}
+
+// 31. lssdp_http_add
+int lssdp_http_add(lssdp_ctx * lssdp, const char * path, const char * content_type, const char * data, size_t data_len) {
+    if (lssdp == NULL || path == NULL || data == NULL) {
+        lssdp_error("lssdp, path and data should not be NULL\n");
+        return -1;
+    }
+
+    lssdp_http_resource * resource = http_resource_add(lssdp, path, content_type);
+    if (resource == NULL) {
+        return -1;
+    }
+
+    resource->data = data;
+    resource->len  = data_len;
+    snprintf(resource->etag, sizeof(resource->etag), "\"%08x-%zx\"", fnv1a_hash(0, data, data_len), data_len);
+    return 0;
+}
+
+// 32. lssdp_http_add_file
+int lssdp_http_add_file(lssdp_ctx * lssdp, const char * path, const char * content_type, const char * file_path) {
+    if (lssdp == NULL || path == NULL || file_path == NULL) {
+        lssdp_error("lssdp, path and file_path should not be NULL\n");
+        return -1;
+    }
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        lssdp_error("open %s failed, errno = %s (%d)\n", file_path, strerror(errno), errno);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        lssdp_error("%s is not a regular file\n", file_path);
+        close(fd);
+        return -1;
+    }
+
+    int fd_opt = fcntl(fd, F_GETFD);
+    if (fd_opt == -1 || fcntl(fd, F_SETFD, fd_opt | FD_CLOEXEC) == -1) {
+        lssdp_error("fcntl FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+
+    lssdp_http_resource * resource = http_resource_add(lssdp, path, content_type);
+    if (resource == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    resource->fd  = fd;
+    resource->len = st.st_size;
+    snprintf(resource->etag, sizeof(resource->etag), "\"%llx-%zx\"", (long long) st.st_mtime, resource->len);
+    return 0;
+}
+
+// 33. lssdp_http_close
+int lssdp_http_close(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    if (lssdp->http.sock > 0) {
+        close(lssdp->http.sock);
+    }
+
+    while (lssdp->http.connection != NULL) {
+        lssdp_http_connection * next = lssdp->http.connection->next;
+        http_connection_free(lssdp->http.connection);
+        lssdp->http.connection = next;
+    }
+
+    while (lssdp->http.resource != NULL) {
+        lssdp_http_resource * next = lssdp->http.resource->next;
+        if (lssdp->http.resource->fd >= 0) {
+            close(lssdp->http.resource->fd);
+        }
+        free(lssdp->http.resource);
+        lssdp->http.resource = next;
+    }
+
+    lssdp->http.sock           = 0;
+    lssdp->http.port           = 0;
+    lssdp->http.connection_num = 0;
+    return 0;
+}
+
+// 34. lssdp_event_pollfd
+int lssdp_event_pollfd(lssdp_ctx * lssdp, struct pollfd * fds, size_t fds_size) {
+    if (lssdp == NULL || (fds == NULL && fds_size > 0)) {
+        lssdp_error("lssdp and fds should not be NULL\n");
+        return -1;
+    }
+
+    // the same sockets as lssdp_event_fdset, n is counted even when fds is full
+    size_t n = 0;
+
+    // 1. SSDP socket, the socket of SSDP hub is read by lssdp_hub_socket_read
+    if (lssdp->hub == NULL && lssdp->sock > 0) {
+        event_pollfd_add(fds, fds_size, &n, lssdp->sock, POLLIN);
+    }
+
+    // 2. description fetch connections
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        if (fetch->state != FETCH_DONE) {
+            event_pollfd_add(fds, fds_size, &n, fetch->sock, fetch->state == FETCH_RECEIVING ? POLLIN : POLLOUT);
+        }
+    }
+
+    // 3. description responder, stop accepting when connections are full
+    size_t connection_max = lssdp->http.connection_max > 0 ? lssdp->http.connection_max : LSSDP_HTTP_CONNECTION_MAX;
+    if (lssdp->http.sock > 0 && lssdp->http.connection_num < connection_max) {
+        event_pollfd_add(fds, fds_size, &n, lssdp->http.sock, POLLIN);
+    }
+
+    lssdp_http_connection * conn;
+    for (conn = lssdp->http.connection; conn != NULL; conn = conn->next) {
+        event_pollfd_add(fds, fds_size, &n, conn->sock, conn->state == HTTP_READING ? POLLIN : POLLOUT);
+    }
+    return n;
+}
+
+// 35. lssdp_event_ready
+int lssdp_event_ready(lssdp_ctx * lssdp, int fd, short revents) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    lssdp_event_readiness ready = {
+        .fd      = fd,
+        .revents = revents
+    };
+    return event_process(lssdp, &ready);
+}
+
+// 36. lssdp_self_address_clear
+int lssdp_self_address_clear(lssdp_ctx * lssdp) {
+    if (lssdp == NULL) {
+        lssdp_error("lssdp should not be NULL\n");
+        return -1;
+    }
+
+    free(lssdp->self_address.slot);
+    memset(&lssdp->self_address, 0, sizeof(lssdp->self_address));
+    return 0;
+}
+
+// 37. lssdp_search_result_header
+const char * lssdp_search_result_header(const lssdp_search_result * result, int index) {
+    if (result == NULL || index < 0 || index >= LSSDP_HEADER_INTEREST_NUM) {
+        return NULL;
+    }
+
+    const lssdp_extra_header * extra = &result->extra[index];
+    return extra->len > 0 ? &result->extra_arena[extra->offset] : NULL;
+}
+
+/** Internal Function **/
+
+/* process ready sockets of select or poll, timeout, waiting and completed fetch, see lssdp_event_process */
+static int event_process(lssdp_ctx * lssdp, const lssdp_event_readiness * ready) {
+    int ret = 0;
+
+    // 1. SSDP socket
+    if (lssdp->hub == NULL && lssdp->sock > 0 && (event_revents(ready, lssdp->sock) & POLLIN)) {
+        ret = lssdp_socket_read(lssdp);
+    }
+
+    long long current_time = get_current_time(lssdp);
+    if (current_time < 0) {
+        lssdp_error("got invalid timestamp %lld\n", current_time);
+        return -1;
+    }
+
+    // 2. description responder: serve ready connections, close idle connections, then accept
+    lssdp_http_connection ** prev = &lssdp->http.connection;
+    while (*prev != NULL) {
+        lssdp_http_connection * conn = *prev;
+        bool is_ready = event_revents(ready, conn->sock) != 0;
+        int result = 0;
+        if (is_ready) {
+            result = http_connection_process(lssdp, conn);
+        } else if (conn->deadline <= current_time) {
+            result = -1;
+        }
+
+        if (result != 0) {
+            *prev = conn->next;
+            lssdp->http.connection_num--;
+            http_connection_free(conn);
+            continue;
+        }
+        prev = &conn->next;
+    }
+
+    if (lssdp->http.sock > 0 && (event_revents(ready, lssdp->http.sock) & POLLIN)) {
+        http_accept(lssdp);
+    }
+
+    // 3. transfer description fetch connections, then check timeout
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        if (fetch->state == FETCH_DONE) {
+            continue;
+        }
+
+        short revents = event_revents(ready, fetch->sock);
+        bool is_readable = revents & POLLIN;
+        bool is_writable = revents & POLLOUT;
+        if (is_readable || is_writable) {
+            fetch_transfer(lssdp, fetch, is_readable, is_writable);
+        }
+
+        if (fetch->state != FETCH_DONE && fetch->deadline <= current_time) {
+            lssdp_debug("fetch %s timeout\n", fetch->location);
+            fetch_done(fetch, -1);
+        }
+    }
+
+    // 4. start waiting fetch, new socket is added by the next lssdp_event_fdset or lssdp_event_pollfd
+    fetch_start(lssdp);
+
+    // 5. complete fetch, callback may start or close fetch
+    for (;;) {
+        lssdp_fetch ** done = &lssdp->fetch.active;
+        while (*done != NULL && (*done)->state != FETCH_DONE) {
+            done = &(*done)->next;
+        }
+        if (*done == NULL) {
+            break;
+        }
+
+        fetch = *done;
+        *done = fetch->next;
+        lssdp->fetch.active_num--;
+        fetch_complete(lssdp, fetch);
+        fetch_free(fetch);
+    }
+    return ret;
+}
+
+
+/* append (fd, events) if fds is not full, n is counted anyway */
+static void event_pollfd_add(struct pollfd * fds, size_t fds_size, size_t * n, int fd, short events) {
+    if (*n < fds_size) {
+        fds[*n].fd      = fd;
+        fds[*n].events  = events;
+        fds[*n].revents = 0;
+    }
+    (*n)++;
+}
+
+/* POLLIN and POLLOUT of fd, error and hangup are processed as both */
+static short event_revents(const lssdp_event_readiness * ready, int fd) {
+    short revents = 0;
+    if (ready->read_fds != NULL && FD_ISSET(fd, ready->read_fds)) {
+        revents |= POLLIN;
+    }
+    if (ready->write_fds != NULL && FD_ISSET(fd, ready->write_fds)) {
+        revents |= POLLOUT;
+    }
+    if (ready->fd >= 0 && ready->fd == fd) {
+        revents |= ready->revents & (POLLERR | POLLHUP) ? POLLIN | POLLOUT : ready->revents & (POLLIN | POLLOUT);
+    }
+    return revents;
+}
+
+static ssize_t lssdp_socket_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, struct sockaddr_in * address, long long * timestamp) {
+    // check socket and port
+    if (lssdp->sock <= 0) {
+        lssdp_error("SSDP socket (%d) has not been setup.\n", lssdp->sock);
+        return -1;
+    }
+
+    if (lssdp->port == 0) {
+        lssdp_error("SSDP port (%d) has not been setup.\n", lssdp->port);
+        return -1;
+    }
+
+    // keep the last byte for null terminator
+    const lssdp_transport * transport = get_transport(lssdp);
+    lssdp_recv_info info = {};
+    ssize_t recv_len = transport->recv(lssdp, buffer, buffer_len - 1, &info);
+    if (recv_len < 0) {
+        return -1;
+    }
+    buffer[recv_len] = '\0';
+
+    lssdp->stats.packet_received++;
+    lssdp->stats.byte_received += recv_len;
+    if (info.drop_counter != lssdp->stats.drop_counter) {
+        rcvbuf_drop_update(lssdp, info.drop_counter);
+    }
+
+    // write into capture file
+    if (lssdp->capture != NULL && capture_write_packet(lssdp, buffer, recv_len, &info) != 0) {
+        lssdp_error("write capture file failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+
+    address->sin_family      = AF_INET;
+    address->sin_addr.s_addr = info.addr;
+    address->sin_port        = htons(info.port);
+    *timestamp = info.timestamp;
+    return recv_len;
+}
+
+static int capture_write_block(FILE * file, uint32_t type, const struct iovec * iov, size_t iov_num) {
+    // block = type + total length + body (padded to 32 bits) + total length
+    size_t body_len = 0;
+    size_t i;
+    for (i = 0; i < iov_num; i++) {
+        body_len += iov[i].iov_len;
+    }
+
+    const uint8_t padding[4] = {};
+    size_t padding_len = (4 - body_len % 4) % 4;
+    uint32_t head[2] = {type, 12 + body_len + padding_len};
+
+    if (fwrite(head, sizeof(head), 1, file) != 1) {
+        return -1;
+    }
+    for (i = 0; i < iov_num; i++) {
+        if (iov[i].iov_len > 0 && fwrite(iov[i].iov_base, iov[i].iov_len, 1, file) != 1) {
+            return -1;
+        }
+    }
+    if (padding_len > 0 && fwrite(padding, padding_len, 1, file) != 1) {
+        return -1;
+    }
+    if (fwrite(&head[1], sizeof(head[1]), 1, file) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+static int capture_write_packet(lssdp_ctx * lssdp, const char * data, size_t data_len, const lssdp_recv_info * info) {
+    long long timestamp = info->timestamp > 0 ? info->timestamp : get_current_time(lssdp) * 1000;   // microseconds
+
+    // IPv4 header (20 bytes) + UDP header (8 bytes), UDP checksum 0 is "not computed"
+    uint8_t header[28] = {
+        0x45, 0, 0, 0,              // version 4, IHL 5, total length
+        0, 0, 0, 0,                 // identification, fragment
+        2, 17, 0, 0                 // TTL 2, protocol UDP, header checksum
+    };
+    uint16_t total_len = htons(sizeof(header) + data_len);
+    uint16_t udp_len   = htons(8 + data_len);
+    uint16_t src_port  = htons(info->port);
+    uint16_t dst_port  = htons(lssdp->port);
+    uint32_t dst_addr  = inet_addr(Global.ADDR_MULTICAST);
+    memcpy(header + 2,  &total_len, 2);
+    memcpy(header + 12, &info->addr, 4);
+    memcpy(header + 16, &dst_addr, 4);
+    memcpy(header + 20, &src_port, 2);
+    memcpy(header + 22, &dst_port, 2);
+    memcpy(header + 24, &udp_len, 2);
+
+    uint32_t sum = 0;
+    size_t i;
+    for (i = 0; i < 20; i += 2) {
+        sum += (header[i] << 8) | header[i + 1];
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~(sum + (sum >> 16)) & 0xFFFF;
+    header[10] = sum >> 8;
+    header[11] = sum & 0xFF;
+
+    // Enhanced Packet Block: interface 0, timestamp (high, low), captured length, original length
+    uint32_t epb[5] = {
+        0,
+        (uint32_t) ((unsigned long long) timestamp >> 32),
+        (uint32_t) timestamp,
+        sizeof(header) + data_len,
+        sizeof(header) + data_len
+    };
+
+    struct iovec iov[3] = {
+        {epb, sizeof(epb)},
+        {header, sizeof(header)},
+        {(void *) data, data_len}
+    };
+    if (capture_write_block(lssdp->capture, PCAPNG_BLOCK_EPB, iov, 3) != 0) {
+        return -1;
+    }
+
+    // keep the capture complete when process is killed
+    return fflush(lssdp->capture);
+}
+
+static void rcvbuf_drop_update(lssdp_ctx * lssdp, uint32_t drop_counter) {
+    // the counter is cumulative, unsigned subtraction handles wrap around
+    uint32_t dropped = drop_counter - lssdp->stats.drop_counter;
+    lssdp->stats.drop_counter = drop_counter;
+
+    // kernel counts the packets dropped by socket filter into the same counter (sk_drops),
+    // they are not overflow, so the counter is ignored while the filter is attached
+    if (lssdp->socket_filter && get_transport(lssdp) == &lssdp_transport_udp) {
+        return;
+    }
+    lssdp->stats.packet_dropped += dropped;
+
+    // warn once per interval with the dropped packets since the last warning
+    long long now = get_current_time(lssdp);
+    lssdp->stats.drop_unreported += dropped;
+    if (lssdp->stats.drop_warn_time == 0 || now - lssdp->stats.drop_warn_time >= LSSDP_DROP_WARN_INTERVAL) {
+        lssdp_warn("kernel dropped %zu packets on socket %d (rcvbuf = %d)\n", lssdp->stats.drop_unreported, lssdp->sock, lssdp->stats.rcvbuf);
+        lssdp->stats.drop_unreported = 0;
+        lssdp->stats.drop_warn_time  = now > 0 ? now : 1;
+    }
+
+    // adaptive receive buffer
+    if (lssdp->rcvbuf.size_max <= 0 || get_transport(lssdp) != &lssdp_transport_udp) {
+        return;
+    }
+
+    // kernel reports double of the requested size
+    int size = udp_rcvbuf_size(lssdp);
+    if (size <= 0) {
+        size = lssdp->stats.rcvbuf / 2;
+    }
+    if (size >= lssdp->rcvbuf.size_max) {
+        return;
+    }
+
+    // rcvbuf.size is the user configuration, the grown size is kept in stats
+    lssdp->stats.rcvbuf_size = size > lssdp->rcvbuf.size_max / 2 ? lssdp->rcvbuf.size_max : size * 2;
+    if (udp_socket_rcvbuf(lssdp, lssdp->sock) == 0) {
+        lssdp->stats.rcvbuf_grow++;
+        lssdp_info("grow receive buffer of socket %d to %d\n", lssdp->sock, lssdp->stats.rcvbuf);
+    }
+}
+
+static int self_address_key(int family, const void * address, uint8_t key[16]) {
+    if (address == NULL) {
+        return -1;
+    }
+
+    if (family == AF_INET6) {
+        memcpy(key, address, 16);
+        return 0;
+    }
+
+    if (family == AF_INET) {
+        // IPv4-mapped IPv6 address ::ffff:a.b.c.d
+        memset(key, 0, 10);
+        key[10] = key[11] = 0xFF;
+        memcpy(key + 12, address, 4);
+        return 0;
+    }
+    return -1;
+}
+
+/* linear probing, slot_num should be > 0
+ *
+ * @return the slot of key, or the empty slot to insert key
+ */
+static lssdp_self_address_slot * self_address_find(const lssdp_ctx * lssdp, const uint8_t key[16]) {
+    static const uint8_t EMPTY[16] = {};
+    size_t mask = lssdp->self_address.slot_num - 1;
+    size_t i;
+    for (i = fnv1a_hash(0, (const char *) key, 16) & mask; memcmp(lssdp->self_address.slot[i].addr, EMPTY, 16) != 0; i = (i + 1) & mask) {
+        if (memcmp(lssdp->self_address.slot[i].addr, key, 16) == 0) {
+            break;
+        }
+    }
+    return &lssdp->self_address.slot[i];
+}
+
+/* insert address key, the set is doubled when it is half full
+ *
+ * @return = 1      inserted
+ *         = 0      already in the set
+ *         < 0      failed
+ */
+static int self_address_insert(lssdp_ctx * lssdp, const uint8_t key[16], bool is_user) {
+    if (lssdp->self_address.slot_num > 0) {
+        lssdp_self_address_slot * slot = self_address_find(lssdp, key);
+        if (memcmp(slot->addr, key, 16) == 0) {
+            slot->is_user |= is_user;
+            return 0;
+        }
+    }
+
+    // load factor is under 0.5
+    if (lssdp->self_address.num + 1 > lssdp->self_address.slot_num / 2) {
+        size_t slot_num = lssdp->self_address.slot_num > 0 ? lssdp->self_address.slot_num * 2 : LSSDP_SELF_ADDRESS_SIZE;
+        if (self_address_resize(lssdp, slot_num, false) != 0) {
+            return -1;
+        }
+    }
+
+    lssdp_self_address_slot * slot = self_address_find(lssdp, key);
+    memcpy(slot->addr, key, 16);
+    slot->is_user = is_user;
+    lssdp->self_address.num++;
+    return 1;
+}
+
+/* rehash the set to slot_num, the interface addresses are removed if is_user_only is true */
+static int self_address_resize(lssdp_ctx * lssdp, size_t slot_num, bool is_user_only) {
+    lssdp_self_address_slot * slot = (lssdp_self_address_slot *) calloc(slot_num, sizeof(lssdp_self_address_slot));
+    if (slot == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    static const uint8_t EMPTY[16] = {};
+    lssdp_self_address_slot * old_slot = lssdp->self_address.slot;
+    size_t old_slot_num = lssdp->self_address.slot_num;
+    lssdp->self_address.slot     = slot;
+    lssdp->self_address.slot_num = slot_num;
+    lssdp->self_address.num      = 0;
+
+    size_t i;
+    for (i = 0; i < old_slot_num; i++) {
+        if (memcmp(old_slot[i].addr, EMPTY, 16) == 0 || (is_user_only && old_slot[i].is_user == false)) {
+            continue;
+        }
+        *self_address_find(lssdp, old_slot[i].addr) = old_slot[i];
+        lssdp->self_address.num++;
+    }
+    free(old_slot);
+    return 0;
+}
+
+/* interface addresses are replaced by lssdp.interface, the addresses of lssdp_self_address_add are kept */
+static void self_address_rebuild(lssdp_ctx * lssdp) {
+    if (lssdp->self_address.slot_num > 0) {
+        self_address_resize(lssdp, lssdp->self_address.slot_num, true);
+    }
+
+    size_t i;
+    for (i = 0; i < lssdp->interface_num; i++) {
+        uint8_t key[16];
+        self_address_key(AF_INET, &lssdp->interface[i].addr, key);
+        self_address_insert(lssdp, key, false);
+    }
+}
+
+static int send_msearch_unicast(lssdp_ctx * lssdp, uint32_t address, const char * st) {
+    // check socket and port
+    if (lssdp->sock <= 0) {
+        lssdp_error("SSDP socket (%d) has not been setup.\n", lssdp->sock);
+        return -1;
+    }
+
+    if (lssdp->port == 0) {
+        lssdp_error("SSDP port (%d) has not been setup.\n", lssdp->port);
+        return -1;
+    }
+
+    struct sockaddr_in dest_addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(lssdp->port),
+        .sin_addr.s_addr = address
+    };
+
+    char ip[LSSDP_IP_LEN] = {};
+    if (inet_ntop(AF_INET, &dest_addr.sin_addr, ip, sizeof(ip)) == NULL) {
+        lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    // 1. set M-SEARCH packet
+    struct iovec iov[LSSDP_IOV_NUM];
+    size_t iov_num = msearch_packet_iov(lssdp, iov, ip, st);
+    if (iov_num == 0) {
+        return -1;
+    }
+
+    // 2. send M-SEARCH
+    const lssdp_transport * transport = get_transport(lssdp);
+    if (transport->send(lssdp, iov, iov_num, address, lssdp->port) < 0) {
+        lssdp_error("send %s to %s failed\n", Global.MSEARCH, ip);
+        return -1;
+    }
+
+    if (lssdp->debug) {
+        lssdp_info("SEND => %-8s   UNICAST => %s (%s)\n", Global.MSEARCH, ip, st);
+    }
+
+    return 0;
+}
+
+static int send_msearch_multicast(lssdp_ctx * lssdp, const char * st) {
+    // check network inerface number
+    if (lssdp->interface_num == 0) {
+        lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.MSEARCH);
+        return -1;
+    }
+
+    // 1. set M-SEARCH packet
+    struct iovec iov[LSSDP_IOV_NUM];
+    size_t iov_num = msearch_packet_iov(lssdp, iov, Global.ADDR_MULTICAST, st);
+    if (iov_num == 0) {
+        return -1;
+    }
+
+    // 2. send M-SEARCH to each interface
+    size_t i;
+    for (i = 0; i < lssdp->interface_num; i++) {
+        struct lssdp_interface * interface = &lssdp->interface[i];
+
+        // avoid sending multicast to localhost
+        if (interface->addr == inet_addr(Global.ADDR_LOCALHOST)) {
+            continue;
+        }
+
+        // send M-SEARCH
+        int ret = send_multicast_data(lssdp, iov, iov_num, interface);
+        if (ret == 0 && lssdp->debug) {
+            lssdp_info("SEND => %-8s   %s => MULTICAST (%s)\n", Global.MSEARCH, interface->ip, st);
+        }
+    }
+
+    return 0;
+}
+
+static int send_multicast_data(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, const struct lssdp_interface * interface) {
+    if (iov == NULL || iov_num == 0) {
+        lssdp_error("data should not be empty\n");
+        return -1;
+    }
+
+    if (strlen(interface->name) == 0) {
+        lssdp_error("interface.name should not be empty\n");
+        return -1;
+    }
+
+    return get_transport(lssdp)->send_multicast(lssdp, interface, iov, iov_num) < 0 ? -1 : 0;
+}
+
+static int lssdp_send_response(lssdp_ctx * lssdp, struct sockaddr_in address, const char * st) {
+    // get M-SEARCH IP
+    char msearch_ip[LSSDP_IP_LEN] = {};
+    if (inet_ntop(AF_INET, &address.sin_addr, msearch_ip, sizeof(msearch_ip)) == NULL) {
+        lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    // reply "ssdp:all" with own search target, otherwise echo the requested search target
+    if (strcmp(st, Global.ST_ALL) == 0) {
+        st = lssdp->header.search_target;
+    }
+
+    // 1. find the interface which is in LAN
+    struct lssdp_interface * interface = find_interface_in_LAN(lssdp, address.sin_addr.s_addr);
+    if (interface == NULL) {
+        if (lssdp->debug) {
+            lssdp_info("RECV <- %-8s   Interface is not found        %s\n", Global.MSEARCH, msearch_ip);
+        }
+
+        if (lssdp->interface_num == 0) {
+            lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.RESPONSE);
+        }
+        return -1;
+    }
+
+    // 2. set response packet from template
+    if (packet_template_update(lssdp) != 0) {
+        return -1;
+    }
+
+    char * domain = lssdp->header.location.domain;
+    struct iovec iov[5] = {
+        packet_template_segment(lssdp, LSSDP_TEMPLATE_RESPONSE_HEAD),
+        iov_string(strlen(domain) > 0 ? domain : interface->ip),   // LOCATION host
+        packet_template_segment(lssdp, LSSDP_TEMPLATE_RESPONSE_MID),
+        iov_string(st),                                             // ST (Search Target)
+        packet_template_segment(lssdp, LSSDP_TEMPLATE_RESPONSE_TAIL)
+    };
+
+    if (lssdp->debug) {
+        lssdp_info("RECV <- %-8s   %s <- %s\n", Global.MSEARCH, interface->ip, msearch_ip);
+    }
+
+    // 3. send data
+    const lssdp_transport * transport = get_transport(lssdp);
+    if (transport->send(lssdp, iov, 5, address.sin_addr.s_addr, lssdp->port) < 0) {
+        lssdp_error("send RESPONSE to %s failed\n", msearch_ip);
+        return -1;
+    }
+
+    if (lssdp->debug) {
+        lssdp_info("SEND => %-8s   %s => %s\n", Global.RESPONSE, interface->ip, msearch_ip);
+    }
+
+    return 0;
+}
+
+static int lssdp_packet_process(lssdp_ctx * lssdp, const lssdp_packet * packet, struct sockaddr_in address) {
+    // compile search target if it has been changed
+    lssdp_st_pattern * pattern = &lssdp->st_pattern;
+    if (strcmp(pattern->source, lssdp->header.search_target) != 0) {
+        st_pattern_compile(lssdp->header.search_target, pattern);
+    }
+
+    // monitor mode: keep every device, never respond
+    if (lssdp->monitor) {
+        if (strcmp(packet->method, Global.MSEARCH) != 0) {
+            if (packet->is_byebye) {
+                neighbor_list_remove(lssdp, packet);
+            } else {
+                neighbor_list_add(lssdp, packet);
+            }
+        }
+        return 0;
+    }
+
+    // M-SEARCH: send RESPONSE back
+    if (strcmp(packet->method, Global.MSEARCH) == 0) {
+        if (st_pattern_match_msearch(pattern, packet->st)) {
+            lssdp_send_response(lssdp, address, packet->st);
+        } else if (lssdp->debug) {
+            lssdp_info("RECV <- %-8s   not match with %-14s %s\n", packet->method, lssdp->header.search_target, packet->st);
+        }
+        return 0;
+    }
+
+    // check search target
+    if (st_pattern_match_neighbor(pattern, lssdp->st_match, packet->st) == false) {
+        // search target is not match
+        if (lssdp->debug) {
+            lssdp_info("RECV <- %-8s   not match with %-14s %s\n", packet->method, lssdp->header.search_target, packet->location);
+        }
+        return 0;
+    }
+
+    // NOTIFY ssdp:byebye: remove from neighbor_list
+    if (packet->is_byebye) {
+        neighbor_list_remove(lssdp, packet);
+        return 0;
+    }
+
+    // RESPONSE, NOTIFY: add to neighbor_list
+    neighbor_list_add(lssdp, packet);
+
+    if (lssdp->debug) {
+        lssdp_info("RECV <- %-8s   %-28s  %s\n", packet->method, packet->location, packet->sm_id);
+    }
+    return 0;
+}
+
+static size_t msearch_packet_iov(lssdp_ctx * lssdp, struct iovec * iov, const char * host, const char * st) {
+    // rebuild packet template if header is changed
+    if (packet_template_update(lssdp) != 0) {
+        return 0;
+    }
+
+    iov[0] = packet_template_segment(lssdp, LSSDP_TEMPLATE_MSEARCH_HEAD);
+    iov[1] = iov_string(host);                                  // HOST
+    iov[2] = packet_template_segment(lssdp, LSSDP_TEMPLATE_MSEARCH_MID);
+    iov[3] = iov_string(st);                                    // ST (Search Target)
+    iov[4] = packet_template_segment(lssdp, LSSDP_TEMPLATE_MSEARCH_TAIL);
+    return 5;
+}
+
+/* preformat static segments of each packet, only rebuilt when header or port is changed */
+static int packet_template_update(lssdp_ctx * lssdp) {
+    // caller supplied static segments are never rebuilt
+    if (lssdp->static_template != NULL) {
+        return 0;
+    }
+
+    if (lssdp->packet_template.port == lssdp->port
+            && memcmp(&lssdp->packet_template.header, &lssdp->header, sizeof(struct lssdp_header)) == 0) {
+        return 0;
+    }
+
+    memcpy(&lssdp->packet_template.header, &lssdp->header, sizeof(struct lssdp_header));
+    lssdp->packet_template.port = lssdp->port;
+
+    const struct lssdp_header * header = &lssdp->header;
+    const char * segment[LSSDP_TEMPLATE_SEGMENT_NUM] = {};
+    char port[8] = {};
+    snprintf(port, sizeof(port), "%d", lssdp->port);
+
+    // 1. M-SEARCH
+    char msearch_mid[64] = {};
+    snprintf(msearch_mid, sizeof(msearch_mid),
+        ":%s\r\n"
+        "MAN:\"ssdp:discover\"\r\n"
+        "MX:1\r\n"
+        "ST:",
+        port
+    );
+    segment[LSSDP_TEMPLATE_MSEARCH_HEAD] = "M-SEARCH * HTTP/1.1\r\nHOST:";
+    segment[LSSDP_TEMPLATE_MSEARCH_MID]  = msearch_mid;
+    segment[LSSDP_TEMPLATE_MSEARCH_TAIL] = "\r\nUSER-AGENT:OS/version product/version\r\n\r\n";
+
+    // 2. NOTIFY, RESPONSE
+    char notify_head[LSSDP_BUFFER_LEN] = {};
+    char notify_tail[LSSDP_BUFFER_LEN] = {};
+    char response_head[LSSDP_BUFFER_LEN] = {};
+    char response_mid[LSSDP_BUFFER_LEN] = {};
+    char response_tail[LSSDP_BUFFER_LEN] = {};
+    snprintf(notify_head, sizeof(notify_head),
+        "%s"
+        "HOST:%s:%s\r\n"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "LOCATION:%s",
+        Global.HEADER_NOTIFY,                       // HEADER
+        Global.ADDR_MULTICAST, port,                // HOST
+        header->location.prefix                     // LOCATION
+    );
+    snprintf(notify_tail, sizeof(notify_tail),
+        "%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "NT:%s\r\n"
+        "NTS:ssdp:alive\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        header->location.suffix,
+        header->search_target,                      // NT (Notify Type)
+        header->unique_service_name,                // USN
+        header->sm_id,                              // SM_ID    (addtional field)
+        header->device_type                         // DEV_TYPE (addtional field)
+    );
+    snprintf(response_head, sizeof(response_head),
+        "%s"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "DATE:\r\n"
+        "EXT:\r\n"
+        "LOCATION:%s",
+        Global.HEADER_RESPONSE,                     // HEADER
+        header->location.prefix                     // LOCATION
+    );
+    snprintf(response_mid, sizeof(response_mid),
+        "%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "ST:",
+        header->location.suffix
+    );
+    snprintf(response_tail, sizeof(response_tail),
+        "\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        header->unique_service_name,                // USN
+        header->sm_id,                              // SM_ID    (addtional field)
+        header->device_type                         // DEV_TYPE (addtional field)
+    );
+    segment[LSSDP_TEMPLATE_NOTIFY_HEAD]   = notify_head;
+    segment[LSSDP_TEMPLATE_NOTIFY_TAIL]   = notify_tail;
+    segment[LSSDP_TEMPLATE_RESPONSE_HEAD] = response_head;
+    segment[LSSDP_TEMPLATE_RESPONSE_MID]  = response_mid;
+    segment[LSSDP_TEMPLATE_RESPONSE_TAIL] = response_tail;
+
+    // 3. copy each segment to template buffer
+    size_t offset = 0;
+    int i;
+    for (i = 0; i < LSSDP_TEMPLATE_SEGMENT_NUM; i++) {
+        size_t len = segment[i] != NULL ? strlen(segment[i]) : 0;
+        if (offset + len > LSSDP_TEMPLATE_LEN) {
+            lssdp_error("packet template is over than %d bytes\n", LSSDP_TEMPLATE_LEN);
+            memset(&lssdp->packet_template, 0, sizeof(lssdp->packet_template));
+            return -1;
+        }
+
+        memcpy(lssdp->packet_template.buffer + offset, segment[i], len);
+        lssdp->packet_template.segment[i].offset = offset;
+        lssdp->packet_template.segment[i].len    = len;
+        offset += len;
+    }
+    return 0;
+}
+
+static struct iovec packet_template_segment(lssdp_ctx * lssdp, int segment) {
+    if (lssdp->static_template != NULL) {
+        struct iovec iov = {
+            .iov_base = (void *) lssdp->static_template->segment[segment].data,
+            .iov_len  = lssdp->static_template->segment[segment].len
+        };
+        return iov;
+    }
+
+    struct iovec iov = {
+        .iov_base = lssdp->packet_template.buffer + lssdp->packet_template.segment[segment].offset,
+        .iov_len  = lssdp->packet_template.segment[segment].len
+    };
+    return iov;
+}
+
+static struct iovec iov_string(const char * string) {
+    struct iovec iov = {
+        .iov_base = (void *) string,
+        .iov_len  = strlen(string)
+    };
+    return iov;
+}
+
+static int lssdp_packet_parser(lssdp_ctx * lssdp, const char * data, size_t data_len, lssdp_packet * packet) {
+    if (data == NULL) {
+        lssdp_error("data should not be NULL\n");
+        return -1;
+    }
+
+    size_t str_len = strlen(data);
+    if (data_len != str_len) {
+        lssdp_warn("data_len (%zu) is not match to the data length (%zu)\n", data_len, str_len);
+        return -1;
+    }
+
+    if (packet == NULL) {
+        lssdp_error("packet should not be NULL\n");
+        return -1;
+    }
+
+    // 1. compare SSDP Method Header: M-SEARCH, NOTIFY, RESPONSE
+    size_t i;
+    if ((i = strlen(Global.HEADER_MSEARCH)) < data_len && memcmp(data, Global.HEADER_MSEARCH, i) == 0) {
+        strcpy(packet->method, Global.MSEARCH);
+    } else if ((i = strlen(Global.HEADER_NOTIFY)) < data_len && memcmp(data, Global.HEADER_NOTIFY, i) == 0) {
+        strcpy(packet->method, Global.NOTIFY);
+    } else if ((i = strlen(Global.HEADER_RESPONSE)) < data_len && memcmp(data, Global.HEADER_RESPONSE, i) == 0) {
+        strcpy(packet->method, Global.RESPONSE);
+    } else {
+        lssdp_warn("received unknown SSDP packet\n");
+        lssdp_debug("%s\n", data);
+        return -1;
+    }
+
+    /* 2. parse each field line [start, end), until the empty line (end of header)
+     *    each byte is visited by a constant number of times, so parsing is linear to data_len
+     */
+    packet->data         = data;
+    packet->boot_id      = -1;
+    packet->config_id    = -1;
+    packet->next_boot_id = -1;
+    size_t start = i;
+    for (; i < data_len; i++) {
+        if (data[i] != '\n') {
+            continue;
+        }
+
+        // strip CR of CRLF
+        size_t end = i;
+        if (end > start && data[end - 1] == '\r') {
+            end--;
+        }
+
+        if (end == start) {
+            // empty line
+            break;
+        }
+
+        parse_field_line(lssdp, data, start, end, packet);
+        start = i + 1;
+    }
+
+    return 0;
+}
+
+static void st_pattern_compile(const char * st, lssdp_st_pattern * pattern) {
+    memset(pattern, 0, sizeof(lssdp_st_pattern));
+    snprintf(pattern->source, sizeof(pattern->source), "%s", st);
+    pattern->len     = strlen(pattern->source);
+    pattern->is_all  = strcmp(pattern->source, Global.ST_ALL) == 0;
+    pattern->version = st_version(pattern->source, pattern->len, &pattern->type_len);
+}
+
+static bool st_pattern_match_msearch(const lssdp_st_pattern * pattern, const char * st) {
+    // 1. empty search target never match
+    if (pattern->len == 0) {
+        return false;
+    }
+
+    // 2. ssdp:all
+    if (strcmp(st, Global.ST_ALL) == 0) {
+        return true;
+    }
+
+    // 3. exact
+    size_t st_len = strlen(st);
+    if (st_len == pattern->len && memcmp(st, pattern->source, st_len) == 0) {
+        return true;
+    }
+
+    // 4. UPnP type: device should respond the search for lower version
+    if (pattern->version < 0 || st_len <= pattern->type_len || memcmp(st, pattern->source, pattern->type_len) != 0) {
+        return false;
+    }
+    size_t type_len;
+    long version = st_version(st, st_len, &type_len);
+    return version >= 0 && type_len == pattern->type_len && version <= pattern->version;
+}
+
+static bool st_pattern_match_neighbor(const lssdp_st_pattern * pattern, int mode, const char * st) {
+    if (pattern->is_all) {
+        return true;
+    }
+
+    // empty search target never match
+    if (pattern->len == 0) {
+        return false;
+    }
+
+    size_t st_len = strlen(st);
+    switch (mode) {
+        case LSSDP_ST_MATCH_PREFIX:
+            return st_len >= pattern->len && memcmp(st, pattern->source, pattern->len) == 0;
+
+        case LSSDP_ST_MATCH_VERSION:
+            if (pattern->version >= 0) {
+                if (st_len <= pattern->type_len || memcmp(st, pattern->source, pattern->type_len) != 0) {
+                    return false;
+                }
+                size_t type_len;
+                long version = st_version(st, st_len, &type_len);
+                return version >= 0 && type_len == pattern->type_len && version >= pattern->version;
+            }
+            // search target is not versioned, fall through to exact match
+
+        default:
+            return st_len == pattern->len && memcmp(st, pattern->source, st_len) == 0;
+    }
+}
+
+/* get UPnP version of "urn:domain:device:type:version" or "urn:domain:service:type:version"
+ *
+ * @return >= 0     version, type_len is the length before version
+ *         <  0     search target is not versioned
+ */
+static long st_version(const char * st, size_t st_len, size_t * type_len) {
+    if (st_len < 4 || strncasecmp(st, "urn:", 4) != 0) {
+        return -1;
+    }
+
+    // find the last colon, which should be followed by digits only
+    size_t i = st_len;
+    while (i > 0 && isdigit((unsigned char) st[i - 1])) i--;
+    if (i == st_len || i <= 4 || st[i - 1] != ':' || st_len - i > 9) {
+        return -1;
+    }
+
+    long version = 0;
+    size_t j;
+    for (j = i; j < st_len; j++) {
+        version = version * 10 + (st[j] - '0');
+    }
+
+    *type_len = i;
+    return version;
+}
+
+/* parse field line [start, end) */
+static int parse_field_line(lssdp_ctx * lssdp, const char * data, size_t start, size_t end, lssdp_packet * packet) {
+    // 1. find the colon
+    if (data[start] == ':') {
+        lssdp_warn("the first character of line should not be colon\n");
+        lssdp_debug("%.*s\n", (int) (end - start), &data[start]);
+        return -1;
+    }
+
+    size_t colon;
+    if (get_colon_index(data, start + 1, end, &colon) != 0) {
+        lssdp_warn("there is no colon in line\n");
+        lssdp_debug("%.*s\n", (int) (end - start), &data[start]);
+        return -1;
+    }
+
+
+    // 2. get field, field_len
+    size_t i = start;
+    size_t j = colon;
+    if (trim_spaces(data, &i, &j) == -1) {
+        return -1;
+    }
+    const char * field = &data[i];
+    size_t field_len = j - i;
+
+
+    // 3. get value, value_len
+    i = colon + 1;
+    j = end;
+    if (trim_spaces(data, &i, &j) == -1) {
+        // value is empty
+        return -1;
+    }
+    const char * value = &data[i];
+    size_t value_len = j - i;
+
+
+    // 4. set each field's value to packet
+    if (field_len == strlen("st") && strncasecmp(field, "st", field_len) == 0) {
+        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("nt") && strncasecmp(field, "nt", field_len) == 0) {
+        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("nts") && strncasecmp(field, "nts", field_len) == 0) {
+        packet->is_byebye = value_len == strlen(Global.NTS_BYEBYE) && strncasecmp(value, Global.NTS_BYEBYE, value_len) == 0;
+        return 0;
+    }
+
+    if (field_len == strlen("usn") && strncasecmp(field, "usn", field_len) == 0) {
+        memcpy(packet->usn, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("location") && strncasecmp(field, "location", field_len) == 0) {
+        memcpy(packet->location, value, value_len < LSSDP_LOCATION_LEN ? value_len : LSSDP_LOCATION_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("sm_id") && strncasecmp(field, "sm_id", field_len) == 0) {
+        memcpy(packet->sm_id, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("dev_type") && strncasecmp(field, "dev_type", field_len) == 0) {
+        memcpy(packet->device_type, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        return 0;
+    }
+
+    if (field_len == strlen("bootid.upnp.org") && strncasecmp(field, "bootid.upnp.org", field_len) == 0) {
+        packet->boot_id = parse_upnp_id(value, value_len);
+        return 0;
+    }
+
+    if (field_len == strlen("configid.upnp.org") && strncasecmp(field, "configid.upnp.org", field_len) == 0) {
+        packet->config_id = parse_upnp_id(value, value_len);
+        return 0;
+    }
+
+    if (field_len == strlen("nextbootid.upnp.org") && strncasecmp(field, "nextbootid.upnp.org", field_len) == 0) {
+        packet->next_boot_id = parse_upnp_id(value, value_len);
+        return 0;
+    }
+
+    // 5. extra header in interest set: keep the offset only, value is copied when it is stored in neighbor
+    size_t k;
+    for (k = 0; k < lssdp->header_interest.num; k++) {
+        const char * name = lssdp->header_interest.name[k];
+        if (strncasecmp(field, name, field_len) == 0 && name[field_len] == '\0') {
+            packet->extra[k].offset = value - data;
+            packet->extra[k].len    = value_len;
+            return 0;
+        }
+    }
+
+    // the field is not in the struct packet
+    return 0;
+}
+
+/* parse BOOTID.UPNP.ORG, CONFIGID.UPNP.ORG: non-negative 31-bit decimal
+ *
+ * @return >= 0     id
+ *         <  0     invalid
+ */
+static long parse_upnp_id(const char * value, size_t value_len) {
+    if (value_len == 0 || value_len > 10) {
+        return -1;
+    }
+
+    long id = 0;
+    size_t i;
+    for (i = 0; i < value_len; i++) {
+        if (!isdigit((unsigned char) value[i])) {
+            return -1;
+        }
+        id = id * 10 + (value[i] - '0');
+    }
+    return id <= INT_MAX ? id : -1;
+}
+
+/* find the first colon in [start, end) */
+static int get_colon_index(const char * string, size_t start, size_t end, size_t * colon) {
+    const char * c = start < end ? memchr(&string[start], ':', end - start) : NULL;
+    if (c == NULL) {
+        return -1;
+    }
+
+    *colon = c - string;
+    return 0;
+}
+
+/* trim non-printable and space characters of [start, end) */
+static int trim_spaces(const char * string, size_t * start, size_t * end) {
+    size_t i = *start;
+    size_t j = *end;
+
+    while (i < j && (!isprint((unsigned char) string[i])     || isspace((unsigned char) string[i])))     i++;
+    while (j > i && (!isprint((unsigned char) string[j - 1]) || isspace((unsigned char) string[j - 1]))) j--;
+
+    if (i == j) {
+        return -1;
+    }
+
+    *start = i;
+    *end   = j;
+    return 0;
+}
+
+static const lssdp_transport * get_transport(lssdp_ctx * lssdp) {
+    return lssdp->transport != NULL ? lssdp->transport : &lssdp_transport_udp;
+}
+
+static long long get_current_time(lssdp_ctx * lssdp) {
+    return get_transport(lssdp)->now(lssdp);
+}
+
+static long long get_current_time_us(lssdp_ctx * lssdp) {
+    // UDP transport clock is gettimeofday, read it directly for microsecond precision
+    struct timeval time = {};
+    if (get_transport(lssdp) == &lssdp_transport_udp && gettimeofday(&time, NULL) == 0) {
+        return (long long) time.tv_sec * 1000000 + (long long) time.tv_usec;
+    }
+    return get_current_time(lssdp) * 1000;
+}
+
+static long long packet_arrival_time(lssdp_ctx * lssdp, long long timestamp) {
+    // transport has no arrival timestamp, the packet arrives now
+    if (timestamp <= 0) {
+        return get_current_time(lssdp);
+    }
+
+    // latency histogram: bucket of the highest bit
+    long long latency = get_current_time_us(lssdp) - timestamp;
+    size_t bucket = 0;
+    while (latency > 0 && bucket < LSSDP_LATENCY_BUCKET_NUM - 1) {
+        latency >>= 1;
+        bucket++;
+    }
+    lssdp->stats.latency[bucket]++;
+
+    return timestamp / 1000;
+}
+
+static int lssdp_log(int level, int line, const char * func, const char * format, ...) {
+    if (Global.log_callback == NULL && Global.log_callback_data == NULL) {
+        return -1;
+    }
+
+    char message[LSSDP_BUFFER_LEN] = {};
+
+    // create message by va_list
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, LSSDP_BUFFER_LEN, format, args);
+    va_end(args);
+
+    // invoke log callback function
+    if (Global.log_callback_data != NULL) {
+        Global.log_callback_data(__FILE__, "SSDP", level, line, func, message, Global.log_user_data);
+    } else {
+        Global.log_callback(__FILE__, "SSDP", level, line, func, message);
+    }
+    return 0;
+}
+
+static int neighbor_list_add(lssdp_ctx * lssdp, const lssdp_packet * packet) {
+    bool is_changed = false;
+    bool is_rebooted = false;
+    bool is_config_changed = false;
+    neighbor_index_rekey(lssdp);
+    uint32_t hash = neighbor_key_hash(lssdp, packet->usn, packet->st, packet->location);
+    lssdp_nbr * nbr = neighbor_index_find(lssdp, packet, hash);
+    if (nbr != NULL) {
+        /* neighbor is found in SSDP list: update neighbor */
+
+        // usn
+        if (strcmp(nbr->usn, packet->usn) != 0) {
+            lssdp_debug("neighbor usn is changed. (%s -> %s)\n", nbr->usn, packet->usn);
+            memcpy(nbr->usn, packet->usn, LSSDP_FIELD_LEN);
+            is_changed = true;
+        }
+
+        // location and addr: the paths of every interface and location
+        if (neighbor_path_update(lssdp, nbr, packet) == true) {
+            lssdp_debug("neighbor %s paths are changed. (%zu paths, location %s)\n", nbr->usn, nbr->path_num, nbr->location);
+            is_changed = true;
+        }
+
+        // st
+        if (strcmp(nbr->st, packet->st) != 0) {
+            lssdp_debug("neighbor st is changed. (%s -> %s)\n", nbr->st, packet->st);
+            memcpy(nbr->st, packet->st, LSSDP_FIELD_LEN);
+            is_changed = true;
+        }
+
+        // sm_id
+        if (strcmp(nbr->sm_id, packet->sm_id) != 0) {
+            lssdp_debug("neighbor sm_id is changed. (%s -> %s)\n", nbr->sm_id, packet->sm_id);
+            memcpy(nbr->sm_id, packet->sm_id, LSSDP_FIELD_LEN);
+            is_changed = true;
+        }
+
+        // device type
+        if (strcmp(nbr->device_type, packet->device_type) != 0) {
+            lssdp_debug("neighbor device_type is changed. (%s -> %s)\n", nbr->device_type, packet->device_type);
+            memcpy(nbr->device_type, packet->device_type, LSSDP_FIELD_LEN);
+            is_changed = true;
+        }
+
+        // extra headers
+        if (extra_header_update(nbr->extra, &nbr->extra_arena, nbr->extra_is_notify, packet) == true) {
+            lssdp_debug("neighbor extra header is changed. (%s)\n", nbr->usn);
+            is_changed = true;
+        }
+
+        /* boot id: ssdp:update announces NEXTBOOTID of the same BOOTID, it is not a reboot.
+         *          a changed BOOTID is a reboot, BOOTID which appears or disappears is an update.
+         */
+        if (packet->next_boot_id >= 0 && packet->boot_id == nbr->boot_id) {
+            lssdp_debug("neighbor %s boot id is updated. (%ld -> %ld)\n", nbr->usn, nbr->boot_id, packet->next_boot_id);
+            nbr->boot_id = packet->next_boot_id;
+        } else if (packet->boot_id != nbr->boot_id) {
+            lssdp_debug("neighbor %s boot id is changed. (%ld -> %ld)\n", nbr->usn, nbr->boot_id, packet->boot_id);
+            if (nbr->boot_id >= 0 && packet->boot_id >= 0) {
+                is_rebooted = true;
+            } else {
+                is_changed = true;
+            }
+            nbr->boot_id = packet->boot_id;
+        }
+
+        // config id
+        if (packet->config_id != nbr->config_id) {
+            lssdp_debug("neighbor %s config id is changed. (%ld -> %ld)\n", nbr->usn, nbr->config_id, packet->config_id);
+            if (nbr->config_id >= 0 && packet->config_id >= 0) {
+                is_config_changed = true;
+            } else {
+                is_changed = true;
+            }
+            nbr->config_id = packet->config_id;
+        }
+
+        // update_time
+        nbr->update_time = packet->update_time;
+
+        // move to the end of list, keep neighbor list ordered by update_time
+        neighbor_list_unlink(lssdp, nbr);
+        neighbor_list_append(lssdp, nbr);
+        if (is_rebooted == true) {
+            neighbor_event(lssdp, LSSDP_NEIGHBOR_REBOOTED, nbr);
+        }
+        if (is_config_changed == true) {
+            neighbor_event(lssdp, LSSDP_NEIGHBOR_CONFIG_CHANGED, nbr);
+        }
+        if (is_changed == true) {
+            neighbor_event(lssdp, LSSDP_NEIGHBOR_UPDATED, nbr);
+        }
+        is_changed = is_changed || is_rebooted || is_config_changed;
+        goto end;
+    }
+
+
+    /* neighbor is not found in SSDP list: add to list */
+
+    // 1. evict the oldest neighbor if neighbor list is full
+    if (lssdp->neighbor_max > 0 && lssdp->neighbor_num >= lssdp->neighbor_max && lssdp->neighbor_list != NULL) {
+        lssdp_nbr * oldest = lssdp->neighbor_list;
+        if (lssdp->debug) {
+            lssdp_info("neighbor list is full (%zu), evict %s (%s)\n", lssdp->neighbor_max, oldest->usn, oldest->location);
+        }
+        neighbor_list_unlink(lssdp, oldest);
+        neighbor_event(lssdp, LSSDP_NEIGHBOR_REMOVED, oldest);
+        neighbor_free(oldest);
+    }
+
+    // 2. memory allocate lssdp_nbr
+    nbr = (lssdp_nbr *) malloc(sizeof(lssdp_nbr));
+    if (nbr == NULL) {
+        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    // 3. setup neighbor
+    memcpy(nbr->usn,         packet->usn,         LSSDP_FIELD_LEN);
+    memcpy(nbr->st,          packet->st,          LSSDP_FIELD_LEN);
+    memcpy(nbr->sm_id,       packet->sm_id,       LSSDP_FIELD_LEN);
+    memcpy(nbr->device_type, packet->device_type, LSSDP_FIELD_LEN);
+    nbr->boot_id     = packet->boot_id;
+    nbr->config_id   = packet->config_id;
+    nbr->update_time = packet->update_time;
+    nbr->probe_time  = 0;
+    nbr->hash        = hash;
+    nbr->addr        = 0;
+    nbr->location[0] = '\0';
+    nbr->path        = NULL;
+    nbr->path_num    = 0;
+    nbr->extra_arena = NULL;
+    memset(nbr->extra, 0, sizeof(nbr->extra));
+    memset(nbr->extra_is_notify, 0, sizeof(nbr->extra_is_notify));
+    neighbor_path_update(lssdp, nbr, packet);
+    extra_header_update(nbr->extra, &nbr->extra_arena, nbr->extra_is_notify, packet);
+
+    // 4. grow hash bucket when load factor is over than 1
+    if (lssdp->neighbor_num >= lssdp->neighbor_index.bucket_num) {
+        size_t bucket_num = lssdp->neighbor_index.bucket_num > 0 ? lssdp->neighbor_index.bucket_num * 2 : LSSDP_NEIGHBOR_BUCKET_NUM;
+        if (neighbor_index_resize(lssdp, bucket_num) != 0) {
+            neighbor_free(nbr);
+            return -1;
+        }
+    }
+
+    // 5. add neighbor to the end of list
+    neighbor_list_append(lssdp, nbr);
+    neighbor_event(lssdp, LSSDP_NEIGHBOR_ADDED, nbr);
+
+    is_changed = true;
+    lssdp->msearch.is_changed = true;
+end:
+    // invoke neighbor list changed callback
+    if (is_changed == true) {
+        neighbor_list_changed(lssdp);
+    }
+
+    return 0;
+}
+
+static void neighbor_event(lssdp_ctx * lssdp, int event, const lssdp_nbr * nbr) {
+    // fetch device description of new or reconfigured neighbor
+    if (lssdp->description_fetched_callback != NULL && (event == LSSDP_NEIGHBOR_ADDED || event == LSSDP_NEIGHBOR_CONFIG_CHANGED)) {
+        fetch_enqueue(lssdp, nbr);
+    }
+
+    if (lssdp->neighbor_event_callback != NULL) {
+        lssdp->neighbor_event_callback(lssdp, event, nbr, lssdp->user_data);
+    }
+}
+
+/* the callback with user_data is invoked instead of the callback without it */
+static void neighbor_list_changed(lssdp_ctx * lssdp) {
+    if (lssdp->neighbor_list_changed_callback_data != NULL) {
+        lssdp->neighbor_list_changed_callback_data(lssdp, lssdp->neighbor_list, lssdp->neighbor_num, lssdp->user_data);
+    } else if (lssdp->neighbor_list_changed_callback != NULL) {
+        lssdp->neighbor_list_changed_callback(lssdp);
+    }
+}
+
+static void network_interface_changed(lssdp_ctx * lssdp) {
+    if (lssdp->network_interface_changed_callback_data != NULL) {
+        lssdp->network_interface_changed_callback_data(lssdp, lssdp->interface, lssdp->interface_num, lssdp->user_data);
+    } else if (lssdp->network_interface_changed_callback != NULL) {
+        lssdp->network_interface_changed_callback(lssdp);
+    }
+}
+
+static void packet_received(lssdp_ctx * lssdp, const char * packet, size_t packet_len, uint32_t address) {
+    if (lssdp->packet_received_callback_data != NULL) {
+        const struct lssdp_interface * interface = find_interface_in_LAN(lssdp, address);
+        lssdp->packet_received_callback_data(lssdp, packet, packet_len, address, interface, lssdp->user_data);
+    } else if (lssdp->packet_received_callback != NULL) {
+        lssdp->packet_received_callback(lssdp, packet, packet_len);
+    }
+}
+
+/* copy extra header values of packet to the arena of neighbor or search result
+ *
+ * current_is_notify: packet type of each value (neighbor only, NULL for search result).
+ * NOTIFY and RESPONSE may carry different headers (e.g. SEARCHPORT.UPNP.ORG is in NOTIFY only),
+ * so a value is kept while the header is absent in the packet of the other type,
+ * and removed when the header is absent in the packet of the same type.
+ *
+ * @return true     any value is changed
+ */
+static bool extra_header_update(lssdp_extra_header * current, char ** current_arena, bool * current_is_notify, const lssdp_packet * packet) {
+    lssdp_extra_header extra[LSSDP_HEADER_INTEREST_NUM] = {};
+    bool is_notify[LSSDP_HEADER_INTEREST_NUM] = {};
+    char arena[LSSDP_HEADER_ARENA_LEN];
+    size_t arena_len = 0;
+    bool is_packet_notify = strcmp(packet->method, Global.NOTIFY) == 0;
+
+    // 1. pack values into arena, NUL terminated
+    size_t i;
+    for (i = 0; i < LSSDP_HEADER_INTEREST_NUM; i++) {
+        const char * value;
+        size_t len = packet->extra[i].len;
+        if (len > 0) {
+            value        = &packet->data[packet->extra[i].offset];
+            is_notify[i] = is_packet_notify;
+        } else if (current_is_notify != NULL && current[i].len > 0 && current_is_notify[i] != is_packet_notify) {
+            value        = &(*current_arena)[current[i].offset];
+            len          = current[i].len;
+            is_notify[i] = current_is_notify[i];
+        } else {
+            continue;
+        }
+        if (arena_len + len + 1 > sizeof(arena)) {
+            lssdp_debug("extra header %zu (%zu bytes) is not fit in arena, skip\n", i, len);
+            continue;
+        }
+        memcpy(&arena[arena_len], value, len);
+        arena[arena_len + len] = '\0';
+        extra[i].offset = arena_len;
+        extra[i].len    = len;
+        arena_len += len + 1;
+    }
+
+    // 2. compare with the current values, packet type is always updated
+    if (current_is_notify != NULL) {
+        memcpy(current_is_notify, is_notify, sizeof(is_notify));
+    }
+    bool is_changed = false;
+    for (i = 0; i < LSSDP_HEADER_INTEREST_NUM && is_changed == false; i++) {
+        if (extra[i].len != current[i].len) {
+            is_changed = true;
+        } else if (extra[i].len > 0) {
+            is_changed = memcmp(&arena[extra[i].offset], &(*current_arena)[current[i].offset], extra[i].len) != 0;
+        }
+    }
+
+    if (is_changed == false) {
+        return false;
+    }
+
+    // 3. values are allocated out of line in exact size
+    char * extra_arena = NULL;
+    if (arena_len > 0) {
+        extra_arena = (char *) realloc(*current_arena, arena_len);
+        if (extra_arena == NULL) {
+            lssdp_error("realloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            return false;
+        }
+        memcpy(extra_arena, arena, arena_len);
+    } else {
+        free(*current_arena);
+    }
+    memcpy(current, extra, sizeof(extra));
+    *current_arena = extra_arena;
+    return true;
+}
+
+/* update location and addr of neighbor by packet
+ *
+ * neighbor_merge: add or refresh the path (interface, location) of packet, remove the path which is not received within neighbor_timeout.
+ * location and addr of neighbor are of path[0], so the neighbor which is reachable by many paths is stable.
+ *
+ * @return true     location or any path is added, changed or removed
+ */
+static bool neighbor_path_update(lssdp_ctx * lssdp, lssdp_nbr * nbr, const lssdp_packet * packet) {
+    bool is_changed = false;
+    size_t i;
+
+    // 1. not merged: location and addr of the last packet, paths are not kept
+    if (lssdp->neighbor_merge == false) {
+        if (strcmp(nbr->location, packet->location) != 0) {
+            memcpy(nbr->location, packet->location, LSSDP_LOCATION_LEN);
+            is_changed = true;
+        }
+        nbr->addr = packet->addr;
+        free(nbr->path);
+        nbr->path     = NULL;
+        nbr->path_num = 0;
+        return is_changed;
+    }
+
+    struct lssdp_interface * interface = find_interface_in_LAN(lssdp, packet->addr);
+    const char * name = interface != NULL ? interface->name : "";
+
+    // 2. neighbor_merge is turned on: the current location is the first path
+    if (nbr->path_num == 0 && strlen(nbr->location) > 0) {
+        if ((nbr->path = (lssdp_nbr_path *) malloc(sizeof(lssdp_nbr_path))) == NULL) {
+            lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            return false;
+        }
+        struct lssdp_interface * current = find_interface_in_LAN(lssdp, nbr->addr);
+        snprintf(nbr->path[0].interface, sizeof(nbr->path[0].interface), "%s", current != NULL ? current->name : "");
+        memcpy(nbr->path[0].location, nbr->location, LSSDP_LOCATION_LEN);
+        nbr->path[0].addr        = nbr->addr;
+        nbr->path[0].update_time = nbr->update_time;
+        nbr->path_num = 1;
+    }
+
+    // 3. refresh the path of the same interface, a changed address (e.g. DHCP) replaces the path in place.
+    //    the path which is not in LAN of any interface is matched by location or address
+    lssdp_nbr_path * path = NULL;
+    for (i = 0; i < nbr->path_num && path == NULL; i++) {
+        lssdp_nbr_path * p = &nbr->path[i];
+        if (strcmp(p->interface, name) == 0
+                && (strlen(name) > 0 || strcmp(p->location, packet->location) == 0 || p->addr == packet->addr)) {
+            path = p;
+        }
+    }
+    if (path != NULL) {
+        if (path->addr != packet->addr || strcmp(path->location, packet->location) != 0) {
+            lssdp_debug("neighbor %s path is changed. (%s %s -> %s)\n", nbr->usn, path->interface, path->location, packet->location);
+            memcpy(path->location, packet->location, LSSDP_LOCATION_LEN);
+            path->addr = packet->addr;
+            is_changed = true;
+        }
+        path->update_time = packet->update_time;
+    }
+
+    // 4. remove timeout path, the neighbor is still received by the other path
+    if (lssdp->neighbor_timeout > 0) {
+        size_t n = 0;
+        for (i = 0; i < nbr->path_num; i++) {
+            lssdp_nbr_path * p = &nbr->path[i];
+            if (p != path && packet->update_time - p->update_time >= lssdp->neighbor_timeout) {
+                lssdp_debug("neighbor %s path is timeout. (%s %s)\n", nbr->usn, p->interface, p->location);
+                is_changed = true;
+                continue;
+            }
+            if (n != i) {
+                nbr->path[n] = *p;
+            }
+            n++;
+        }
+        nbr->path_num = n;
+    }
+
+    // 5. add new path, replace the oldest path if full
+    if (path == NULL) {
+        lssdp_nbr_path * list = NULL;
+        if (nbr->path_num < LSSDP_NEIGHBOR_PATH_NUM && (list = (lssdp_nbr_path *) realloc(nbr->path, sizeof(lssdp_nbr_path) * (nbr->path_num + 1))) != NULL) {
+            nbr->path = list;
+            path = &nbr->path[nbr->path_num++];
+        } else if (nbr->path_num > 0) {
+            path = &nbr->path[0];
+            for (i = 1; i < nbr->path_num; i++) {
+                if (nbr->path[i].update_time < path->update_time) {
+                    path = &nbr->path[i];
+                }
+            }
+        } else {
+            lssdp_error("realloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            memcpy(nbr->location, packet->location, LSSDP_LOCATION_LEN);
+            nbr->addr = packet->addr;
+            return true;
+        }
+
+        snprintf(path->interface, sizeof(path->interface), "%s", name);
+        memcpy(path->location, packet->location, LSSDP_LOCATION_LEN);
+        path->addr        = packet->addr;
+        path->update_time = packet->update_time;
+        is_changed = true;
+    }
+
+    // 6. location and addr are of the first path
+    memcpy(nbr->location, nbr->path[0].location, LSSDP_LOCATION_LEN);
+    nbr->addr = nbr->path[0].addr;
+    return is_changed;
+}
+
+static int neighbor_list_remove(lssdp_ctx * lssdp, const lssdp_packet * packet) {
+    neighbor_index_rekey(lssdp);
+    lssdp_nbr * nbr = neighbor_index_find(lssdp, packet, neighbor_key_hash(lssdp, packet->usn, packet->st, packet->location));
+    size_t removed = 0;
+    if (nbr != NULL) {
+        neighbor_byebye(lssdp, nbr);
+        removed++;
+    } else if (strlen(packet->location) == 0 && strlen(packet->usn) > 0) {
+        // byebye has no LOCATION: the neighbors keyed by location are found by USN
+        lssdp_nbr * next;
+        for (nbr = lssdp->neighbor_list; nbr != NULL; nbr = next) {
+            next = nbr->next;
+            if (strcmp(nbr->usn, packet->usn) == 0) {
+                neighbor_byebye(lssdp, nbr);
+                removed++;
+            }
+        }
+    }
+
+    if (removed == 0) {
+        return 0;
+    }
+    lssdp->msearch.is_changed = true;
+
+    // invoke neighbor list changed callback
+    neighbor_list_changed(lssdp);
+    return 0;
+}
+
+/* unlink and free the byebye neighbor */
+static void neighbor_byebye(lssdp_ctx * lssdp, lssdp_nbr * nbr) {
+    if (lssdp->debug) {
+        lssdp_info("remove byebye SSDP neighbor: %s (%s)\n", nbr->sm_id, nbr->location);
+    }
+
+    neighbor_list_unlink(lssdp, nbr);
+    neighbor_event(lssdp, LSSDP_NEIGHBOR_REMOVED, nbr);
+    neighbor_free(nbr);
+}
+
+/* free neighbor with the out of line paths and extra header values */
+static void neighbor_free(lssdp_nbr * nbr) {
+    free(nbr->path);
+    free(nbr->extra_arena);
+    free(nbr);
+}
+
+/* unlink neighbor from the list and hash bucket, the neighbor is not freed */
+static void neighbor_list_unlink(lssdp_ctx * lssdp, lssdp_nbr * nbr) {
+    // 1. neighbor list
+    if (nbr->prev != NULL) {
+        nbr->prev->next = nbr->next;
+    } else {
+        lssdp->neighbor_list = nbr->next;
+    }
+
+    if (nbr->next != NULL) {
+        nbr->next->prev = nbr->prev;
+    } else {
+        lssdp->neighbor_index.tail = nbr->prev;
+    }
+
+    // 2. hash bucket
+    lssdp_nbr ** p = &lssdp->neighbor_index.bucket[nbr->hash & (lssdp->neighbor_index.bucket_num - 1)];
+    while (*p != NULL && *p != nbr) {
+        p = &(*p)->hash_next;
+    }
+    if (*p == nbr) {
+        *p = nbr->hash_next;
+    }
+
+    nbr->prev = nbr->next = nbr->hash_next = NULL;
+    lssdp->neighbor_num--;
+}
+
+/* append neighbor to the end of list and hash bucket */
+static void neighbor_list_append(lssdp_ctx * lssdp, lssdp_nbr * nbr) {
+    // 1. neighbor list
+    nbr->next = NULL;
+    nbr->prev = lssdp->neighbor_index.tail;
+    if (nbr->prev != NULL) {
+        nbr->prev->next = nbr;
+    } else {
+        lssdp->neighbor_list = nbr;
+    }
+    lssdp->neighbor_index.tail = nbr;
+
+    // 2. hash bucket
+    size_t n = nbr->hash & (lssdp->neighbor_index.bucket_num - 1);
+    nbr->hash_next = lssdp->neighbor_index.bucket[n];
+    lssdp->neighbor_index.bucket[n] = nbr;
+    lssdp->neighbor_num++;
+}
+
+static lssdp_nbr * neighbor_index_find(lssdp_ctx * lssdp, const lssdp_packet * packet, uint32_t hash) {
+    if (lssdp->neighbor_index.bucket_num == 0) {
+        return NULL;
+    }
+
+    bool is_merged  = lssdp->neighbor_merge && strlen(packet->usn) > 0;
+    bool is_usn_key = lssdp->monitor && strlen(packet->usn) > 0;
+
+    lssdp_nbr * nbr;
+    for (nbr = lssdp->neighbor_index.bucket[hash & (lssdp->neighbor_index.bucket_num - 1)]; nbr != NULL; nbr = nbr->hash_next) {
+        if (nbr->hash != hash) {
+            continue;
+        }
+
+        if (is_merged) {
+            if (strcmp(nbr->usn, packet->usn) == 0) {
+                return nbr;
+            }
+        } else if (is_usn_key) {
+            if (strcmp(nbr->usn, packet->usn) == 0 && strcmp(nbr->st, packet->st) == 0) {
+                return nbr;
+            }
+        } else if (strcmp(nbr->location, packet->location) == 0) {
+            return nbr;
+        }
+    }
+    return NULL;
+}
+
+static int neighbor_index_resize(lssdp_ctx * lssdp, size_t bucket_num) {
+    lssdp_nbr ** bucket = (lssdp_nbr **) calloc(bucket_num, sizeof(lssdp_nbr *));
+    if (bucket == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    // rehash neighbors
+    lssdp_nbr * nbr;
+    for (nbr = lssdp->neighbor_list; nbr != NULL; nbr = nbr->next) {
+        size_t n = nbr->hash & (bucket_num - 1);
+        nbr->hash_next = bucket[n];
+        bucket[n] = nbr;
+    }
+
+    free(lssdp->neighbor_index.bucket);
+    lssdp->neighbor_index.bucket     = bucket;
+    lssdp->neighbor_index.bucket_num = bucket_num;
+    return 0;
+}
+
+/* FNV-1a hash of neighbor key: location, or ST and USN in monitor mode, or USN if neighbor_merge */
+static uint32_t neighbor_key_hash(lssdp_ctx * lssdp, const char * usn, const char * st, const char * location) {
+    if (lssdp->neighbor_merge && strlen(usn) > 0) {
+        return fnv1a_hash(0, usn, strlen(usn));
+    }
+
+    if (lssdp->monitor && strlen(usn) > 0) {
+        uint32_t hash = fnv1a_hash(0, usn, strlen(usn));
+        hash = fnv1a_hash(hash, "\n", 1);
+        return fnv1a_hash(hash, st, strlen(st));
+    }
+
+    return fnv1a_hash(0, location, strlen(location));
+}
+
+/* rehash every neighbor when monitor or neighbor_merge is changed,
+ * the neighbors of the same new key are reduced to the latest updated one
+ */
+static void neighbor_index_rekey(lssdp_ctx * lssdp) {
+    int key = lssdp->neighbor_merge ? NEIGHBOR_KEY_USN : lssdp->monitor ? NEIGHBOR_KEY_ST_USN : NEIGHBOR_KEY_LOCATION;
+    if (key == lssdp->neighbor_index.key) {
+        return;
+    }
+    lssdp->neighbor_index.key = key;
+    if (lssdp->neighbor_index.bucket_num == 0) {
+        return;
+    }
+
+    lssdp_debug("neighbor key is changed (%d), rebuild neighbor index of %zu neighbors\n", key, lssdp->neighbor_num);
+    memset(lssdp->neighbor_index.bucket, 0, lssdp->neighbor_index.bucket_num * sizeof(lssdp_nbr *));
+
+    // the latest first, so the duplicated older neighbor is removed
+    size_t removed = 0;
+    lssdp_nbr * nbr = lssdp->neighbor_index.tail;
+    while (nbr != NULL) {
+        lssdp_nbr * prev = nbr->prev;
+        lssdp_packet packet = {};
+        memcpy(packet.usn,      nbr->usn,      LSSDP_FIELD_LEN);
+        memcpy(packet.st,       nbr->st,       LSSDP_FIELD_LEN);
+        memcpy(packet.location, nbr->location, LSSDP_LOCATION_LEN);
+        nbr->hash      = neighbor_key_hash(lssdp, nbr->usn, nbr->st, nbr->location);
+        nbr->hash_next = NULL;
+
+        if (neighbor_index_find(lssdp, &packet, nbr->hash) != NULL) {
+            neighbor_list_unlink(lssdp, nbr);
+            neighbor_event(lssdp, LSSDP_NEIGHBOR_REMOVED, nbr);
+            neighbor_free(nbr);
+            removed++;
+        } else {
+            size_t n = nbr->hash & (lssdp->neighbor_index.bucket_num - 1);
+            nbr->hash_next = lssdp->neighbor_index.bucket[n];
+            lssdp->neighbor_index.bucket[n] = nbr;
+        }
+        nbr = prev;
+    }
+
+    if (removed > 0) {
+        lssdp->msearch.is_changed = true;
+        neighbor_list_changed(lssdp);
+    }
+}
+
+/* FNV-1a hash, hash = 0 to start a new hash */
+static uint32_t fnv1a_hash(uint32_t hash, const char * data, size_t data_len) {
+    if (hash == 0) {
+        hash = 2166136261u;
+    }
+
+    size_t i;
+    for (i = 0; i < data_len; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int lssdp_neighbor_remove_all(lssdp_ctx * lssdp) {
+    // free neighbor index
+    free(lssdp->neighbor_index.bucket);
+    memset(&lssdp->neighbor_index, 0, sizeof(lssdp->neighbor_index));
+
+    if (lssdp->neighbor_list == NULL) {
+        return 0;
+    }
+
+    // free neighbor_list
+    lssdp_nbr * list = lssdp->neighbor_list;
+    lssdp->neighbor_list = NULL;
+    lssdp->neighbor_num  = 0;
+    neighbor_list_free(lssdp, list);
+    lssdp->msearch.is_changed = true;
+
+    lssdp_info("neighbor list has been force clean up.\n");
+
+    // invoke neighbor list changed callback
+    neighbor_list_changed(lssdp);
+    return 0;
+}
+
+static void neighbor_list_free(lssdp_ctx * lssdp, lssdp_nbr * list) {
+    while (list != NULL) {
+        lssdp_nbr * next = list->next;
+        neighbor_event(lssdp, LSSDP_NEIGHBOR_REMOVED, list);
+        neighbor_free(list);
+        list = next;
+    }
+}
+
+static struct lssdp_interface * find_interface_in_LAN(lssdp_ctx * lssdp, uint32_t address) {
     struct lssdp_interface * ifc;
     size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        ifc = &lssdp->interface[i];
+    for (i = 0; i < lssdp->interface_num; i++) {
+        ifc = &lssdp->interface[i];
+
+        // mask address to check whether the interface is under the same Local Network Area or not
+        if ((ifc->addr & ifc->netmask) == (address & ifc->netmask)) {
+            return ifc;
+        }
+    }
+    return NULL;
+}
+
+/* share SSDP socket, port and network interface of hub.ctx to the context */
+static void hub_sync(lssdp_hub * hub, lssdp_ctx * lssdp) {
+    lssdp->sock = hub->ctx.sock;
+    lssdp->port = hub->ctx.port;
+
+    if (lssdp->interface_num == hub->ctx.interface_num && memcmp(lssdp->interface, hub->ctx.interface, sizeof(lssdp->interface)) == 0) {
+        return;
+    }
+
+    // network interface is changed
+    lssdp->interface_num = hub->ctx.interface_num;
+    memcpy(lssdp->interface, hub->ctx.interface, sizeof(lssdp->interface));
+    lssdp_neighbor_remove_all(lssdp);
+    lssdp->msearch.next_time  = 0;
+    lssdp->msearch.is_changed = true;
+}
+
+static int hub_index_rebuild(lssdp_hub * hub) {
+    // 1. allocate index, load factor is under 0.5
+    size_t size = 16;
+    while (size < hub->ctx_num * 2) size *= 2;
+
+    struct lssdp_hub_entry * index = (struct lssdp_hub_entry *) calloc(size, sizeof(struct lssdp_hub_entry));
+    lssdp_ctx ** wildcard_list = (lssdp_ctx **) calloc(hub->ctx_num > 0 ? hub->ctx_num : 1, sizeof(lssdp_ctx *));
+    if (index == NULL || wildcard_list == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        free(index);
+        free(wildcard_list);
+        return -1;
+    }
+
+    // 2. add each context to index or wildcard list
+    size_t wildcard_num = 0;
+    size_t i;
+    for (i = 0; i < hub->ctx_num; i++) {
+        lssdp_ctx * lssdp = hub->ctx_list[i];
+        if (lssdp->monitor || lssdp->st_pattern.is_all || lssdp->st_match == LSSDP_ST_MATCH_PREFIX) {
+            wildcard_list[wildcard_num++] = lssdp;
+            continue;
+        }
+
+        uint32_t hash = hub_st_hash(lssdp->header.search_target);
+        size_t j = hash & (size - 1);
+        while (index[j].ctx != NULL) j = (j + 1) & (size - 1);
+        index[j].hash = hash;
+        index[j].ctx  = lssdp;
+    }
+
+    free(hub->st_index);
+    free(hub->wildcard_list);
+    hub->st_index      = index;
+    hub->st_index_size = size;
+    hub->wildcard_list = wildcard_list;
+    hub->wildcard_num  = wildcard_num;
+    return 0;
+}
+
+/* hash of search target, UPnP version is excluded so that all versions of the type are in the same slot */
+static uint32_t hub_st_hash(const char * st) {
+    size_t st_len = strlen(st);
+    size_t type_len;
+    if (st_version(st, st_len, &type_len) >= 0) {
+        st_len = type_len;
+    }
+    return fnv1a_hash(0, st, st_len);
+}
+
+static void search_packet_process(lssdp_ctx * lssdp, const lssdp_packet * packet) {
+    if (strcmp(packet->method, Global.RESPONSE) != 0) {
+        return;
+    }
+
+    // 1. sessions of the same st, then 2. sessions of ssdp:all
+    const char * st_list[2] = {packet->st, Global.ST_ALL};
+    size_t st_num = strcmp(packet->st, Global.ST_ALL) == 0 ? 1 : 2;
+    size_t i;
+    for (i = 0; i < st_num; i++) {
+        uint32_t hash = fnv1a_hash(0, st_list[i], strlen(st_list[i]));
+        lssdp_search * search;
+        for (search = lssdp->search.bucket[hash & (LSSDP_SEARCH_BUCKET_NUM - 1)]; search != NULL; search = search->hash_next) {
+            if (search->hash == hash && strcmp(search->st, st_list[i]) == 0) {
+                search_result_add(search, packet);
+            }
+        }
+    }
+}
+
+static int search_result_add(lssdp_search * search, const lssdp_packet * packet) {
+    // 1. result is keyed by USN and location, indexed by hash
+    uint32_t hash = fnv1a_hash(fnv1a_hash(0, packet->usn, strlen(packet->usn)), packet->location, strlen(packet->location));
+
+    lssdp_search_result * result = NULL;
+    size_t n;
+    for (n = search->result_max > 0 ? search->result_bucket[hash & (search->result_max - 1)] : 0; n > 0; n = search->result[n - 1].hash_next) {
+        lssdp_search_result * r = &search->result[n - 1];
+        if (r->hash == hash && strcmp(r->usn, packet->usn) == 0 && strcmp(r->location, packet->location) == 0) {
+            result = r;
+            break;
+        }
+    }
+
+    // 2. new result: grow result array and bucket, then link to bucket
+    if (result == NULL) {
+        if (search->result_num >= search->result_max && search_result_grow(search) != 0) {
+            return -1;
+        }
+        size_t bucket = hash & (search->result_max - 1);
+        result = &search->result[search->result_num++];
+        result->hash_next = search->result_bucket[bucket];
+        result->extra_arena = NULL;
+        search->result_bucket[bucket] = search->result_num;
+    }
+
+    // 3. the latest RESPONSE
+    size_t hash_next = result->hash_next;
+    free(result->extra_arena);
+    memset(result, 0, sizeof(lssdp_search_result));
+    memcpy(result->usn,         packet->usn,         LSSDP_FIELD_LEN);
+    memcpy(result->st,          packet->st,          LSSDP_FIELD_LEN);
+    memcpy(result->sm_id,       packet->sm_id,       LSSDP_FIELD_LEN);
+    memcpy(result->device_type, packet->device_type, LSSDP_FIELD_LEN);
+    memcpy(result->location,    packet->location,    LSSDP_LOCATION_LEN);
+    result->boot_id     = packet->boot_id;
+    result->config_id   = packet->config_id;
+    result->update_time = packet->update_time;
+    result->addr        = packet->addr;
+    result->hash        = hash;
+    result->hash_next   = hash_next;
+    extra_header_update(result->extra, &result->extra_arena, NULL, packet);
+    return 0;
+}
+
+/* double result array and bucket, the results are re-linked to the new bucket */
+static int search_result_grow(lssdp_search * search) {
+    size_t result_max = search->result_max > 0 ? search->result_max * 2 : LSSDP_SEARCH_RESULT_NUM;
+    lssdp_search_result * result = (lssdp_search_result *) realloc(search->result, sizeof(lssdp_search_result) * result_max);
+    if (result == NULL) {
+        lssdp_error("realloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    search->result = result;
+
+    size_t * bucket = (size_t *) calloc(result_max, sizeof(size_t));
+    if (bucket == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    free(search->result_bucket);
+    search->result_bucket = bucket;
+    search->result_max    = result_max;
+
+    size_t i;
+    for (i = 0; i < search->result_num; i++) {
+        size_t n = result[i].hash & (result_max - 1);
+        result[i].hash_next = bucket[n];
+        bucket[n] = i + 1;
+    }
+    return 0;
+}
+
+static void search_unlink(lssdp_ctx * lssdp, lssdp_search * search) {
+    lssdp_search ** prev;
+    for (prev = &lssdp->search.list; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == search) {
+            *prev = search->next;
+            break;
+        }
+    }
+
+    for (prev = &lssdp->search.bucket[search->hash & (LSSDP_SEARCH_BUCKET_NUM - 1)]; *prev != NULL; prev = &(*prev)->hash_next) {
+        if (*prev == search) {
+            *prev = search->hash_next;
+            break;
+        }
+    }
+
+    search->next      = NULL;
+    search->hash_next = NULL;
+    lssdp->search.num--;
+}
+
+static void search_free(lssdp_search * search) {
+    size_t i;
+    for (i = 0; i < search->result_num; i++) {
+        free(search->result[i].extra_arena);
+    }
+    free(search->result);
+    free(search->result_bucket);
+    free(search);
+}
+
+static void fetch_enqueue(lssdp_ctx * lssdp, const lssdp_nbr * nbr) {
+    // 1. waiting fetch of the same location: fetch the latest CONFIGID only
+    lssdp_fetch ** prev = &lssdp->fetch.queue;
+    for (; *prev != NULL; prev = &(*prev)->next) {
+        lssdp_fetch * fetch = *prev;
+        if (strcmp(fetch->location, nbr->location) == 0) {
+            memcpy(fetch->usn, nbr->usn, LSSDP_FIELD_LEN);
+            fetch->config_id = nbr->config_id;
+            return;
+        }
+    }
+
+    // 2. active fetch of the same location and CONFIGID
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        if (fetch->config_id == nbr->config_id && strcmp(fetch->location, nbr->location) == 0) {
+            return;
+        }
+    }
+
+    // 3. append to the end of queue
+    fetch = (lssdp_fetch *) calloc(1, sizeof(lssdp_fetch));
+    if (fetch == NULL) {
+        lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return;
+    }
+
+    if (fetch_location_parse(fetch, nbr->location) != 0) {
+        lssdp_debug("location %s is not supported, skip fetch\n", nbr->location);
+        free(fetch);
+        return;
+    }
+
+    memcpy(fetch->usn,      nbr->usn,      LSSDP_FIELD_LEN);
+    memcpy(fetch->location, nbr->location, LSSDP_LOCATION_LEN);
+    fetch->config_id = nbr->config_id;
+    fetch->sock      = -1;
+    fetch->status    = -1;
+    *prev = fetch;
+}
+
+/* parse location: [http://]IPv4[:port][/path] */
+static int fetch_location_parse(lssdp_fetch * fetch, const char * location) {
+    const char * host = location;
+    if (strncasecmp(host, "http://", strlen("http://")) == 0) {
+        host += strlen("http://");
+    } else if (strstr(host, "://") != NULL) {
+        return -1;
+    }
+
+    size_t host_len = strcspn(host, "/");
+    if (host_len == 0 || host_len >= LSSDP_FIELD_LEN) {
+        return -1;
+    }
+    memcpy(fetch->host, host, host_len);
+    fetch->host[host_len] = '\0';
+
+    // port
+    long port = 80;
+    char * colon = strchr(fetch->host, ':');
+    size_t ip_len = colon != NULL ? (size_t) (colon - fetch->host) : host_len;
+    if (colon != NULL) {
+        char * end;
+        port = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0' || port <= 0 || port > 0xFFFF) {
+            return -1;
+        }
+    }
+
+    // IPv4 address only, host name is not resolved
+    char ip[LSSDP_IP_LEN] = {};
+    struct in_addr addr;
+    if (ip_len >= LSSDP_IP_LEN) {
+        return -1;
+    }
+    memcpy(ip, fetch->host, ip_len);
+    if (inet_aton(ip, &addr) == 0) {
+        return -1;
+    }
+
+    fetch->addr        = addr.s_addr;
+    fetch->port        = port;
+    fetch->path_offset = (host - location) + host_len;
+    return 0;
+}
+
+static size_t fetch_host_count(lssdp_ctx * lssdp, uint32_t addr) {
+    size_t count = 0;
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.active; fetch != NULL; fetch = fetch->next) {
+        if (fetch->state != FETCH_DONE && fetch->addr == addr) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static bool fetch_startable(lssdp_ctx * lssdp) {
+    size_t connection_max = lssdp->fetch.connection_max > 0 ? lssdp->fetch.connection_max : LSSDP_FETCH_CONNECTION_MAX;
+    size_t host_max       = lssdp->fetch.host_max > 0 ? lssdp->fetch.host_max : LSSDP_FETCH_HOST_MAX;
+    if (lssdp->fetch.active_num >= connection_max) {
+        return false;
+    }
+
+    lssdp_fetch * fetch;
+    for (fetch = lssdp->fetch.queue; fetch != NULL; fetch = fetch->next) {
+        if (fetch_host_count(lssdp, fetch->addr) < host_max) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void fetch_start(lssdp_ctx * lssdp) {
+    size_t connection_max = lssdp->fetch.connection_max > 0 ? lssdp->fetch.connection_max : LSSDP_FETCH_CONNECTION_MAX;
+    size_t host_max       = lssdp->fetch.host_max > 0 ? lssdp->fetch.host_max : LSSDP_FETCH_HOST_MAX;
+
+    lssdp_fetch ** prev = &lssdp->fetch.queue;
+    while (*prev != NULL && lssdp->fetch.active_num < connection_max) {
+        lssdp_fetch * fetch = *prev;
+
+        // 1. the same location and CONFIGID is cached, no request
+        lssdp_fetch_cache * cache = fetch_cache_find(lssdp, fetch->location);
+        bool is_cached = cache != NULL && fetch->config_id >= 0 && cache->config_id == fetch->config_id;
+
+        // 2. the host is busy, keep waiting in order
+        if (is_cached == false && fetch_host_count(lssdp, fetch->addr) >= host_max) {
+            prev = &fetch->next;
+            continue;
+        }
+
+        // 3. move to the end of active list
+        *prev = fetch->next;
+        fetch->next = NULL;
+        lssdp_fetch ** tail = &lssdp->fetch.active;
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+        *tail = fetch;
+        lssdp->fetch.active_num++;
+
+        if (is_cached == true) {
+            fetch_done(fetch, 304);
+        } else if (fetch_connect(lssdp, fetch, cache) != 0) {
+            fetch_done(fetch, -1);
+        }
+    }
+}
+
+static int fetch_connect(lssdp_ctx * lssdp, lssdp_fetch * fetch, const lssdp_fetch_cache * cache) {
+    // 1. build request, conditional by the cached description of location
+    char condition[2 * LSSDP_FIELD_LEN + 64] = {};
+    if (cache != NULL) {
+        int len = 0;
+        if (cache->etag[0] != '\0') {
+            len = snprintf(condition, sizeof(condition), "If-None-Match: %s\r\n", cache->etag);
+        }
+        if (cache->last_modified[0] != '\0') {
+            snprintf(&condition[len], sizeof(condition) - len, "If-Modified-Since: %s\r\n", cache->last_modified);
+        }
+    }
+
+    const char * path = fetch->location[fetch->path_offset] != '\0' ? &fetch->location[fetch->path_offset] : "/";
+    fetch->buffer_size = LSSDP_FETCH_HEADER_LEN;
+    fetch->buffer = (char *) malloc(fetch->buffer_size);
+    if (fetch->buffer == NULL) {
+        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    int len = snprintf(fetch->buffer, fetch->buffer_size,
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Connection: close\r\n"
+        "%s"
+        "\r\n",
+        path, fetch->host, condition
+    );
+    if (len < 0 || (size_t) len >= fetch->buffer_size) {
+        lssdp_warn("request of %s is too long\n", fetch->location);
+        return -1;
+    }
+    fetch->buffer_len = len;
+
+    // 2. non-blocking connect
+    fetch->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (fetch->sock < 0) {
+        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    if (fetch->sock >= FD_SETSIZE) {
+        lssdp_error("socket %d is over than FD_SETSIZE\n", fetch->sock);
+        return -1;
+    }
+
+    int opt = 1;
+    if (ioctl(fetch->sock, FIONBIO, &opt) != 0) {
+        lssdp_error("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    int sock_opt = fcntl(fetch->sock, F_GETFD);
+    if (sock_opt == -1 || fcntl(fetch->sock, F_SETFD, sock_opt | FD_CLOEXEC) == -1) {
+        lssdp_error("fcntl FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+#ifdef SO_NOSIGPIPE
+    setsockopt(fetch->sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(fetch->port),
+        .sin_addr.s_addr = fetch->addr
+    };
+    if (connect(fetch->sock, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        fetch->state = FETCH_SENDING;
+    } else if (errno == EINPROGRESS) {
+        fetch->state = FETCH_CONNECTING;
+    } else {
+        lssdp_debug("connect %s failed, errno = %s (%d)\n", fetch->host, strerror(errno), errno);
+        return -1;
+    }
+
+    long timeout = lssdp->fetch.timeout > 0 ? lssdp->fetch.timeout : LSSDP_FETCH_TIMEOUT;
+    fetch->deadline = get_current_time(lssdp) + timeout;
+    if (lssdp->debug) {
+        lssdp_info("fetch %s (config id %ld)%s\n", fetch->location, fetch->config_id, cache != NULL ? ", conditional" : "");
+    }
+    return 0;
+}
+
+static void fetch_transfer(lssdp_ctx * lssdp, lssdp_fetch * fetch, bool is_readable, bool is_writable) {
+    // 1. connected or failed
+    if (fetch->state == FETCH_CONNECTING) {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(fetch->sock, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+            lssdp_debug("connect %s failed, errno = %s (%d)\n", fetch->host, strerror(error), error);
+            fetch_done(fetch, -1);
+            return;
+        }
+        fetch->state = FETCH_SENDING;
+    }
+
+    // 2. send request
+    if (fetch->state == FETCH_SENDING) {
+        ssize_t len = send(fetch->sock, &fetch->buffer[fetch->sent], fetch->buffer_len - fetch->sent, MSG_NOSIGNAL);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                lssdp_debug("send to %s failed, errno = %s (%d)\n", fetch->host, strerror(errno), errno);
+                fetch_done(fetch, -1);
+            }
+            return;
+        }
+
+        fetch->sent += len;
+        if (fetch->sent == fetch->buffer_len) {
+            // buffer is reused by response
+            fetch->state          = FETCH_RECEIVING;
+            fetch->buffer_len     = 0;
+            fetch->content_length = -1;
+        }
+        return;
+    }
+
+    // 3. receive response
+    if (fetch->state != FETCH_RECEIVING || is_readable == false) {
+        return;
+    }
+
+    size_t body_max = lssdp->fetch.body_max > 0 ? lssdp->fetch.body_max : LSSDP_FETCH_BODY_MAX;
+    size_t buffer_max = LSSDP_FETCH_HEADER_LEN + body_max + 1;
+    for (;;) {
+        // keep one byte for NUL
+        if (fetch->buffer_len + 1 >= fetch->buffer_size) {
+            if (fetch->buffer_size >= buffer_max) {
+                lssdp_debug("response of %s is over than %zu bytes\n", fetch->location, body_max);
+                fetch_done(fetch, -1);
+                return;
+            }
+            size_t buffer_size = fetch->buffer_size * 2 < buffer_max ? fetch->buffer_size * 2 : buffer_max;
+            char * buffer = (char *) realloc(fetch->buffer, buffer_size);
+            if (buffer == NULL) {
+                lssdp_error("realloc failed, errno = %s (%d)\n", strerror(errno), errno);
+                fetch_done(fetch, -1);
+                return;
+            }
+            fetch->buffer      = buffer;
+            fetch->buffer_size = buffer_size;
+        }
+
+        ssize_t len = recv(fetch->sock, &fetch->buffer[fetch->buffer_len], fetch->buffer_size - fetch->buffer_len - 1, 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                lssdp_debug("recv from %s failed, errno = %s (%d)\n", fetch->host, strerror(errno), errno);
+                fetch_done(fetch, -1);
+            }
+            return;
+        }
+
+        fetch->buffer_len += len;
+        fetch->buffer[fetch->buffer_len] = '\0';
+        if (fetch_response_end(lssdp, fetch, len == 0) == true || len == 0) {
+            return;
+        }
+    }
+}
+
+/* check response is complete
+ *
+ * @return true     fetch is done (success or failed)
+ */
+static bool fetch_response_end(lssdp_ctx * lssdp, lssdp_fetch * fetch, bool is_eof) {
+    // 1. parse header once
+    if (fetch->header_len == 0) {
+        char * end = strstr(fetch->buffer, "\r\n\r\n");
+        if (end == NULL) {
+            if (is_eof || fetch->buffer_len >= LSSDP_FETCH_HEADER_LEN) {
+                lssdp_debug("invalid response header of %s\n", fetch->location);
+                fetch_done(fetch, -1);
+                return true;
+            }
+            return false;
+        }
+
+        fetch->header_len = end - fetch->buffer + strlen("\r\n\r\n");
+        if (fetch_response_header(fetch) != 0) {
+            lssdp_debug("invalid response header of %s\n", fetch->location);
+            fetch_done(fetch, -1);
+            return true;
+        }
+
+        // response without body
+        if (fetch->status != 200) {
+            fetch_done(fetch, fetch->status);
+            return true;
+        }
+
+        size_t body_max = lssdp->fetch.body_max > 0 ? lssdp->fetch.body_max : LSSDP_FETCH_BODY_MAX;
+        if (fetch->content_length > (long long) body_max) {
+            lssdp_debug("description of %s is over than %zu bytes\n", fetch->location, body_max);
+            fetch_done(fetch, -1);
+            return true;
+        }
+    }
+
+    // 2. body by Content-Length
+    size_t body_len = fetch->buffer_len - fetch->header_len;
+    if (fetch->is_chunked == false && fetch->content_length >= 0) {
+        if (body_len >= (size_t) fetch->content_length) {
+            fetch->body_len = fetch->content_length;
+            fetch->buffer[fetch->header_len + fetch->body_len] = '\0';
+            fetch_done(fetch, 200);
+            return true;
+        }
+        if (is_eof) {
+            lssdp_debug("description of %s is truncated\n", fetch->location);
+            fetch_done(fetch, -1);
+            return true;
+        }
+        return false;
+    }
+
+    // 3. chunked or no Content-Length: body is ended by connection close (Connection: close)
+    if (is_eof == false) {
+        return false;
+    }
+
+    if (fetch->is_chunked && chunked_decode(&fetch->buffer[fetch->header_len], body_len, &body_len) != 0) {
+        lssdp_debug("invalid chunked body of %s\n", fetch->location);
+        fetch_done(fetch, -1);
+        return true;
+    }
+    fetch->body_len = body_len;
+    fetch->buffer[fetch->header_len + fetch->body_len] = '\0';
+    fetch_done(fetch, 200);
+    return true;
+}
+
+/* parse status line and header fields [0, header_len) */
+static int fetch_response_header(lssdp_fetch * fetch) {
+    // 1. status line: HTTP/1.x NNN reason
+    const char * data = fetch->buffer;
+    if (strncmp(data, "HTTP/1.", strlen("HTTP/1.")) != 0 || data[8] != ' '
+            || !isdigit((unsigned char) data[9]) || !isdigit((unsigned char) data[10]) || !isdigit((unsigned char) data[11])) {
+        return -1;
+    }
+    fetch->status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+
+    // 2. header fields, until the empty line
+    size_t start = strchr(data, '\n') - data + 1;
+    const char * field;
+    const char * value;
+    size_t field_len;
+    size_t value_len;
+    while (http_header_next(data, fetch->header_len - strlen("\r\n"), &start, &field, &field_len, &value, &value_len) == 0) {
+        if (field_len == strlen("content-length") && strncasecmp(field, "content-length", field_len) == 0) {
+            fetch->content_length = strtoll(value, NULL, 10);
+        } else if (field_len == strlen("transfer-encoding") && strncasecmp(field, "transfer-encoding", field_len) == 0) {
+            fetch->is_chunked = value_len == strlen("chunked") && strncasecmp(value, "chunked", value_len) == 0;
+        } else if (field_len == strlen("etag") && strncasecmp(field, "etag", field_len) == 0) {
+            memcpy(fetch->etag, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        } else if (field_len == strlen("last-modified") && strncasecmp(field, "last-modified", field_len) == 0) {
+            memcpy(fetch->last_modified, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
+        }
+    }
+    return 0;
+}
+
+/* decode chunked body in place: size CRLF data CRLF ... 0 CRLF */
+static int chunked_decode(char * data, size_t data_len, size_t * decoded_len) {
+    size_t i = 0;
+    size_t len = 0;
+    for (;;) {
+        if (i >= data_len || !isxdigit((unsigned char) data[i])) {
+            return -1;
+        }
+
+        // chunk size, chunk extension is ignored
+        unsigned long size = strtoul(&data[i], NULL, 16);
+        const char * line_end = memchr(&data[i], '\n', data_len - i);
+        if (line_end == NULL) {
+            return -1;
+        }
+        i = line_end - data + 1;
+        if (size == 0) {
+            break;
+        }
+
+        if (size > data_len - i || data_len - i - size < strlen("\r\n")) {
+            return -1;
+        }
+        memmove(&data[len], &data[i], size);
+        len += size;
+        i   += size + strlen("\r\n");
+    }
+
+    *decoded_len = len;
+    return 0;
+}
+
+static void fetch_done(lssdp_fetch * fetch, int status) {
+    if (fetch->sock >= 0) {
+        close(fetch->sock);
+        fetch->sock = -1;
+    }
+    fetch->status = status;
+    fetch->state  = FETCH_DONE;
+}
+
+static void fetch_complete(lssdp_ctx * lssdp, lssdp_fetch * fetch) {
+    lssdp_description description = {
+        .config_id = fetch->config_id,
+        .status    = fetch->status
+    };
+    memcpy(description.usn,      fetch->usn,      LSSDP_FIELD_LEN);
+    memcpy(description.location, fetch->location, LSSDP_LOCATION_LEN);
+
+    if (fetch->status == 200) {
+        // new description
+        description.body     = &fetch->buffer[fetch->header_len];
+        description.body_len = fetch->body_len;
+        fetch_cache_store(lssdp, fetch, description.body, description.body_len);
+    } else if (fetch->status == 304) {
+        // not modified, or the same CONFIGID
+        lssdp_fetch_cache * cache = fetch_cache_find(lssdp, fetch->location);
+        if (cache != NULL) {
+            cache->config_id      = fetch->config_id;
+            description.body      = cache->body;
+            description.body_len  = cache->body_len;
+            description.is_cached = true;
+        } else {
+            description.status = -1;
+        }
+    }
+
+    if (lssdp->debug) {
+        lssdp_info("fetch %s is completed, status = %d, %zu bytes%s\n",
+            fetch->location, description.status, description.body_len, description.is_cached ? " (cached)" : "");
+    }
+    lssdp->description_fetched_callback(lssdp, &description, lssdp->user_data);
+}
+
+/* find cache by location, and move it to the front */
+static lssdp_fetch_cache * fetch_cache_find(lssdp_ctx * lssdp, const char * location) {
+    lssdp_fetch_cache ** prev;
+    for (prev = &lssdp->fetch.cache; *prev != NULL; prev = &(*prev)->next) {
+        lssdp_fetch_cache * cache = *prev;
+        if (strcmp(cache->location, location) == 0) {
+            *prev = cache->next;
+            cache->next = lssdp->fetch.cache;
+            lssdp->fetch.cache = cache;
+            return cache;
+        }
+    }
+    return NULL;
+}
+
+static void fetch_cache_store(lssdp_ctx * lssdp, const lssdp_fetch * fetch, const char * body, size_t body_len) {
+    char * copy = (char *) malloc(body_len + 1);
+    if (copy == NULL) {
+        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return;
+    }
+    memcpy(copy, body, body_len);
+    copy[body_len] = '\0';
+
+    lssdp_fetch_cache * cache = fetch_cache_find(lssdp, fetch->location);
+    if (cache == NULL) {
+        // evict the least recently used cache
+        size_t cache_max = lssdp->fetch.cache_max > 0 ? lssdp->fetch.cache_max : LSSDP_FETCH_CACHE_NUM;
+        if (lssdp->fetch.cache_num >= cache_max) {
+            lssdp_fetch_cache ** prev = &lssdp->fetch.cache;
+            while ((*prev)->next != NULL) {
+                prev = &(*prev)->next;
+            }
+            free((*prev)->body);
+            free(*prev);
+            *prev = NULL;
+            lssdp->fetch.cache_num--;
+        }
+
+        cache = (lssdp_fetch_cache *) calloc(1, sizeof(lssdp_fetch_cache));
+        if (cache == NULL) {
+            lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            free(copy);
+            return;
+        }
+        memcpy(cache->location, fetch->location, LSSDP_LOCATION_LEN);
+        cache->next = lssdp->fetch.cache;
+        lssdp->fetch.cache = cache;
+        lssdp->fetch.cache_num++;
+    }
+
+    free(cache->body);
+    cache->body      = copy;
+    cache->body_len  = body_len;
+    cache->config_id = fetch->config_id;
+    memcpy(cache->etag,          fetch->etag,          LSSDP_FIELD_LEN);
+    memcpy(cache->last_modified, fetch->last_modified, LSSDP_FIELD_LEN);
+}
+
+static void fetch_free(lssdp_fetch * fetch) {
+    if (fetch->sock >= 0) {
+        close(fetch->sock);
+    }
+    free(fetch->buffer);
+    free(fetch);
+}
+
+/* get the next HTTP header field line [start, header_end), the lines without colon are skipped
+ *
+ * @return = 0      field and value are trimmed, start is moved to the next line
+ *         < 0      end of header
+ */
+static int http_header_next(const char * data, size_t header_end, size_t * start, const char ** field, size_t * field_len, const char ** value, size_t * value_len) {
+    while (*start < header_end) {
+        const char * line_end = memchr(&data[*start], '\n', header_end - *start);
+        size_t line = *start;
+        size_t end  = line_end != NULL ? (size_t) (line_end - data) : header_end;
+        *start = end + 1;
+        if (end > line && data[end - 1] == '\r') {
+            end--;
+        }
+
+        size_t colon;
+        if (get_colon_index(data, line, end, &colon) != 0) {
+            continue;
+        }
+
+        size_t i = line;
+        size_t j = colon;
+        size_t k = colon + 1;
+        size_t l = end;
+        if (trim_spaces(data, &i, &j) != 0 || trim_spaces(data, &k, &l) != 0) {
+            continue;
+        }
+
+        *field     = &data[i];
+        *field_len = j - i;
+        *value     = &data[k];
+        *value_len = l - k;
+        return 0;
+    }
+    return -1;
+}
+
+/* find or create resource of path, the connections which are sending the replaced resource are closed */
+static lssdp_http_resource * http_resource_add(lssdp_ctx * lssdp, const char * path, const char * content_type) {
+    if (path[0] != '/' || strlen(path) >= LSSDP_FIELD_LEN) {
+        lssdp_error("path %s should start with '/' and be shorter than %d\n", path, LSSDP_FIELD_LEN);
+        return NULL;
+    }
+
+    lssdp_http_resource * resource;
+    for (resource = lssdp->http.resource; resource != NULL; resource = resource->next) {
+        if (strcmp(resource->path, path) == 0) {
+            break;
+        }
+    }
+
+    if (resource != NULL) {
+        // replace: stop sending the old content
+        lssdp_http_connection * conn;
+        for (conn = lssdp->http.connection; conn != NULL; conn = conn->next) {
+            if (conn->resource == resource) {
+                conn->resource   = NULL;
+                conn->keep_alive = false;
+                conn->deadline   = 0;
+            }
+        }
+        if (resource->fd >= 0) {
+            close(resource->fd);
+        }
+    } else {
+        resource = (lssdp_http_resource *) calloc(1, sizeof(lssdp_http_resource));
+        if (resource == NULL) {
+            lssdp_error("calloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            return NULL;
+        }
+        snprintf(resource->path, sizeof(resource->path), "%s", path);
+        resource->next = lssdp->http.resource;
+        lssdp->http.resource = resource;
+    }
+
+    snprintf(resource->content_type, sizeof(resource->content_type), "%s", content_type != NULL ? content_type : "");
+    resource->data = NULL;
+    resource->fd   = -1;
+    resource->len  = 0;
+    return resource;
+}
+
+static void http_accept(lssdp_ctx * lssdp) {
+    size_t connection_max = lssdp->http.connection_max > 0 ? lssdp->http.connection_max : LSSDP_HTTP_CONNECTION_MAX;
+    long idle_timeout = lssdp->http.idle_timeout > 0 ? lssdp->http.idle_timeout : LSSDP_HTTP_IDLE_TIMEOUT;
+
+    while (lssdp->http.connection_num < connection_max) {
+        int sock = accept(lssdp->http.sock, NULL, NULL);
+        if (sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                lssdp_warn("accept failed, errno = %s (%d)\n", strerror(errno), errno);
+            }
+            return;
+        }
+
+        int opt = 1;
+        if (sock >= FD_SETSIZE || ioctl(sock, FIONBIO, &opt) != 0) {
+            lssdp_warn("socket %d can not be served, close it\n", sock);
+            close(sock);
+            continue;
+        }
+        int sock_opt = fcntl(sock, F_GETFD);
+        if (sock_opt == -1 || fcntl(sock, F_SETFD, sock_opt | FD_CLOEXEC) == -1) {
+            lssdp_error("fcntl FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+        }
+#ifdef SO_NOSIGPIPE
+        setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+
+        lssdp_http_connection * conn = (lssdp_http_connection *) malloc(sizeof(lssdp_http_connection));
+        if (conn == NULL) {
+            lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+            close(sock);
+            return;
+        }
+        conn->sock        = sock;
+        conn->state       = HTTP_READING;
+        conn->keep_alive  = true;
+        conn->deadline    = get_current_time(lssdp) + idle_timeout;
+        conn->request_len = 0;
+        conn->resource    = NULL;
+        conn->next        = lssdp->http.connection;
+        lssdp->http.connection = conn;
+        lssdp->http.connection_num++;
+    }
+}
+
+/* read requests and write responses until the socket would block
+ *
+ * @return = 0      keep connection
+ *         < 0      close connection
+ */
+static int http_connection_process(lssdp_ctx * lssdp, lssdp_http_connection * conn) {
+    long idle_timeout = lssdp->http.idle_timeout > 0 ? lssdp->http.idle_timeout : LSSDP_HTTP_IDLE_TIMEOUT;
+    for (;;) {
+        if (conn->state == HTTP_READING) {
+            // 1. a complete request (may be pipelined in buffer), or read more
+            char * end = conn->request_len > 0 ? strstr(conn->request, "\r\n\r\n") : NULL;
+            if (end == NULL) {
+                if (conn->request_len + 1 >= sizeof(conn->request)) {
+                    lssdp_debug("HTTP request is too long\n");
+                    return -1;
+                }
+
+                ssize_t len = recv(conn->sock, &conn->request[conn->request_len], sizeof(conn->request) - conn->request_len - 1, 0);
+                if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    return 0;
+                }
+                if (len <= 0) {
+                    // closed by peer
+                    return -1;
+                }
+                conn->request_len += len;
+                conn->request[conn->request_len] = '\0';
+                conn->deadline = get_current_time(lssdp) + idle_timeout;
+                continue;
+            }
+
+            if (http_response(lssdp, conn, end - conn->request + strlen("\r\n\r\n")) != 0) {
+                return -1;
+            }
+            conn->state = HTTP_WRITING;
+        }
+
+        // 2. write response
+        int result = http_write(conn);
+        if (result < 0) {
+            return -1;
+        }
+        conn->deadline = get_current_time(lssdp) + idle_timeout;
+        if (result > 0) {
+            // would block
+            return 0;
+        }
+
+        // 3. response is sent, keep-alive for the next (pipelined) request
+        if (conn->keep_alive == false) {
+            return -1;
+        }
+        conn->state = HTTP_READING;
+    }
+}
+
+/* parse the request [0, request_len), build response header, then remove the request from buffer */
+static int http_response(lssdp_ctx * lssdp, lssdp_http_connection * conn, size_t request_len) {
+    const char * data = conn->request;
+    int status = 200;
+    const char * reason = "OK";
+    const lssdp_http_resource * resource = NULL;
+    bool is_head = false;
+
+    // 1. request line: METHOD SP path SP HTTP/1.x
+    char method[8] = {};
+    char path[LSSDP_FIELD_LEN] = {};
+    char version[16] = {};
+    const char * line_end = strstr(data, "\r\n");
+    size_t line_len = line_end - data;
+    const char * sp1 = memchr(data, ' ', line_len);
+    const char * sp2 = sp1 != NULL ? memchr(sp1 + 1, ' ', line_end - sp1 - 1) : NULL;
+    if (sp2 == NULL || (size_t) (sp1 - data) >= sizeof(method) || (size_t) (sp2 - sp1 - 1) >= sizeof(path)
+            || (size_t) (line_end - sp2 - 1) >= sizeof(version)) {
+        status = 400;
+        reason = "Bad Request";
+    } else {
+        memcpy(method,  data,    sp1 - data);
+        memcpy(path,    sp1 + 1, sp2 - sp1 - 1);
+        memcpy(version, sp2 + 1, line_end - sp2 - 1);
+        path[strcspn(path, "?")] = '\0';
+    }
+
+    if (status == 200) {
+        if (strcmp(version, "HTTP/1.1") == 0) {
+            conn->keep_alive = true;
+        } else if (strcmp(version, "HTTP/1.0") == 0) {
+            conn->keep_alive = false;
+        } else {
+            status = 400;
+            reason = "Bad Request";
+        }
+    }
+
+    if (status == 200) {
+        is_head = strcmp(method, "HEAD") == 0;
+        if (is_head == false && strcmp(method, "GET") != 0) {
+            status = 501;
+            reason = "Not Implemented";
+        }
+    }
+
+    // 2. header fields: Connection, If-None-Match
+    size_t start = line_len + strlen("\r\n");
+    const char * field;
+    const char * value;
+    size_t field_len;
+    size_t value_len;
+    const char * etag = NULL;
+    size_t etag_len = 0;
+    while (http_header_next(data, request_len - strlen("\r\n"), &start, &field, &field_len, &value, &value_len) == 0) {
+        if (field_len == strlen("connection") && strncasecmp(field, "connection", field_len) == 0) {
+            if (value_len == strlen("close") && strncasecmp(value, "close", value_len) == 0) {
+                conn->keep_alive = false;
+            } else if (value_len == strlen("keep-alive") && strncasecmp(value, "keep-alive", value_len) == 0) {
+                conn->keep_alive = true;
+            }
+        } else if (field_len == strlen("if-none-match") && strncasecmp(field, "if-none-match", field_len) == 0) {
+            etag     = value;
+            etag_len = value_len;
+        }
+    }
+
+    // 3. find document
+    if (status == 200) {
+        for (resource = lssdp->http.resource; resource != NULL; resource = resource->next) {
+            if (strcmp(resource->path, path) == 0) {
+                break;
+            }
+        }
+        if (resource == NULL) {
+            status = 404;
+            reason = "Not Found";
+        } else if (etag != NULL && etag_len == strlen(resource->etag) && memcmp(etag, resource->etag, etag_len) == 0) {
+            status = 304;
+            reason = "Not Modified";
+        }
+    }
+
+    if (status == 400 || status == 501) {
+        conn->keep_alive = false;
+    }
+
+    // 4. response header
+    int len;
+    if (status == 200 || status == 304) {
+        // 304 has no Content-Length, it should be the same as 200 if present (RFC 7230 3.3.2)
+        char content_length[32] = {};
+        if (status == 200) {
+            snprintf(content_length, sizeof(content_length), "Content-Length: %zu\r\n", resource->len);
+        }
+        len = snprintf(conn->header, sizeof(conn->header),
+            "HTTP/1.1 %d %s\r\n"
+            "%s"
+            "%s%s%s"
+            "ETag: %s\r\n"
+            "Connection: %s\r\n"
+            "\r\n",
+            status, reason,
+            content_length,
+            resource->content_type[0] != '\0' ? "Content-Type: " : "", resource->content_type, resource->content_type[0] != '\0' ? "\r\n" : "",
+            resource->etag,
+            conn->keep_alive ? "keep-alive" : "close"
+        );
+    } else {
+        len = snprintf(conn->header, sizeof(conn->header),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: %s\r\n"
+            "\r\n",
+            status, reason,
+            conn->keep_alive ? "keep-alive" : "close"
+        );
+    }
+    if (len < 0 || (size_t) len >= sizeof(conn->header)) {
+        lssdp_error("HTTP response header is too long\n");
+        return -1;
+    }
+
+    if (lssdp->debug) {
+        lssdp_info("HTTP %s %s -> %d\n", method, path, status);
+    }
+
+    conn->header_len  = len;
+    conn->header_sent = 0;
+    conn->body_sent   = 0;
+    conn->resource    = status == 200 && is_head == false ? resource : NULL;
+
+    // 5. remove the request, keep the pipelined requests
+    conn->request_len -= request_len;
+    memmove(conn->request, &conn->request[request_len], conn->request_len + 1);
+    return 0;
+}
+
+/* send response header and body
+ *
+ * @return = 0      response is sent
+ *         > 0      would block
+ *         < 0      failed
+ */
+static int http_write(lssdp_http_connection * conn) {
+    const lssdp_http_resource * resource = conn->resource;
+    size_t body_len = resource != NULL ? resource->len : 0;
+
+    while (conn->header_sent < conn->header_len || conn->body_sent < body_len) {
+        ssize_t len;
+        size_t header_left = conn->header_len - conn->header_sent;
+        if (resource == NULL || resource->data != NULL || header_left > 0) {
+            // 1. header and in-memory body by one sendmsg (writev)
+            struct iovec iov[2] = {
+                {
+                    .iov_base = &conn->header[conn->header_sent],
+                    .iov_len  = header_left
+                },
+                {
+                    .iov_base = (void *) (resource != NULL && resource->data != NULL ? &resource->data[conn->body_sent] : NULL),
+                    .iov_len  = resource != NULL && resource->data != NULL ? body_len - conn->body_sent : 0
+                }
+            };
+            struct msghdr msg = {
+                .msg_iov    = iov,
+                .msg_iovlen = 2
+            };
+            int flags = MSG_NOSIGNAL;
+#ifdef MSG_MORE
+            // file body follows
+            if (resource != NULL && resource->data == NULL) {
+                flags |= MSG_MORE;
+            }
+#endif
+            len = sendmsg(conn->sock, &msg, flags);
+        } else {
+            // 2. file body by sendfile, the file offset is not shared by connections
+#ifdef __linux__
+            off_t offset = conn->body_sent;
+            len = sendfile(conn->sock, resource->fd, &offset, body_len - conn->body_sent);
+#else
+            char buffer[LSSDP_BUFFER_LEN];
+            size_t size = body_len - conn->body_sent < sizeof(buffer) ? body_len - conn->body_sent : sizeof(buffer);
+            len = pread(resource->fd, buffer, size, conn->body_sent);
+            if (len > 0) {
+                len = send(conn->sock, buffer, len, MSG_NOSIGNAL);
+            } else if (len == 0) {
+                // file is truncated
+                return -1;
+            }
+#endif
+        }
+
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return 1;
+            }
+            return -1;
+        }
+        if (len == 0 && resource != NULL && resource->data == NULL && header_left == 0) {
+            // file is truncated
+            return -1;
+        }
+
+        // advance header, then body
+        size_t sent = len;
+        size_t header_sent = sent < header_left ? sent : header_left;
+        conn->header_sent += header_sent;
+        conn->body_sent   += sent - header_sent;
+    }
+    return 0;
+}
+
+static void http_connection_free(lssdp_http_connection * conn) {
+    close(conn->sock);
+    free(conn);
+}
+
+
+/** UDP Transport **/
+
+static int udp_socket_open(lssdp_ctx * lssdp) {
+    // create UDP socket
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    int result = -1;
+
+    // set non-blocking
+    int opt = 1;
+    if (ioctl(sock, FIONBIO, &opt) != 0) {
+        lssdp_error("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set reuse address
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0) {
+        lssdp_error("setsockopt SO_REUSEADDR failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set FD_CLOEXEC (http://kaivy2001.pixnet.net/blog/post/32726732)
+    int sock_opt = fcntl(sock, F_GETFD);
+    if (sock_opt == -1) {
+        lssdp_error("fcntl F_GETFD failed, errno = %s (%d)\n", strerror(errno), errno);
+    } else {
+        // F_SETFD
+        if (fcntl(sock, F_SETFD, sock_opt | FD_CLOEXEC) == -1) {
+            lssdp_error("fcntl F_SETFD FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+        }
+    }
+
+    // bind socket
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(lssdp->port),
+        .sin_addr.s_addr = htonl(INADDR_ANY)
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set IP_ADD_MEMBERSHIP
+    struct ip_mreq imr = {
+        .imr_multiaddr.s_addr = inet_addr(Global.ADDR_MULTICAST),
+        .imr_interface.s_addr = htonl(INADDR_ANY)
+    };
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imr, sizeof(struct ip_mreq)) != 0) {
+        lssdp_error("setsockopt IP_ADD_MEMBERSHIP failed: %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set receive buffer size
+    if (udp_socket_rcvbuf(lssdp, sock) != 0) {
+        goto end;
+    }
+
+#ifdef SO_RXQ_OVFL
+    // report kernel drop counter with each datagram, not with socket filter: its drops are in the same counter
+    if (lssdp->socket_filter == false && setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) != 0) {
+        lssdp_warn("setsockopt SO_RXQ_OVFL failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+#endif
+
+#if defined(SO_TIMESTAMPNS)
+    // kernel arrival timestamp with each datagram
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) != 0) {
+        lssdp_warn("setsockopt SO_TIMESTAMPNS failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+#elif defined(SO_TIMESTAMP)
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt)) != 0) {
+        lssdp_warn("setsockopt SO_TIMESTAMP failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+#endif
+
+    // attach socket filter
+    if (udp_socket_filter(lssdp, sock) != 0) {
+        goto end;
+    }
+
+    result = sock;
+end:
+    if (result == -1 && close(sock) != 0) {
+        lssdp_error("close fd %d failed, errno = %s (%d)\n", sock, strerror(errno), errno);
+    }
+    return result;
+}
+
+static int udp_socket_close(lssdp_ctx * lssdp, int sock) {
+    if (close(sock) != 0) {
+        lssdp_error("close socket %d failed, errno = %s (%d)\n", sock, strerror(errno), errno);
+        return -1;
+    }
+    return 0;
+}
+
+/* requested SO_RCVBUF: the larger of rcvbuf.size and the size grown by adaptive receive buffer, 0 is system default */
+static int udp_rcvbuf_size(lssdp_ctx * lssdp) {
+    return lssdp->stats.rcvbuf_size > lssdp->rcvbuf.size ? lssdp->stats.rcvbuf_size : lssdp->rcvbuf.size;
+}
+
+static int udp_socket_rcvbuf(lssdp_ctx * lssdp, int sock) {
+    int size = udp_rcvbuf_size(lssdp);
+    if (size > 0 && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) {
+        lssdp_error("setsockopt SO_RCVBUF %d failed, errno = %s (%d)\n", size, strerror(errno), errno);
+        return -1;
+    }
+
+    // the size is limited by system (net.core.rmem_max on Linux)
+    socklen_t len = sizeof(lssdp->stats.rcvbuf);
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &lssdp->stats.rcvbuf, &len) != 0) {
+        lssdp_warn("getsockopt SO_RCVBUF failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+    return 0;
+}
+
+/* classic BPF program of SSDP socket, the UDP header is at offset 0 and payload is at offset 8
+ *
+ * 1. drop packet whose IP source address is an IPv4 address of self address set
+ * 2. accept packet whose payload starts with M-SEARCH, NOTIFY or RESPONSE header line
+ * 3. drop others
+ *
+ * ST is not checked: classic BPF has no loop, ST line can be at any offset.
+ */
+static int udp_socket_filter(lssdp_ctx * lssdp, int sock) {
+    if (lssdp->socket_filter == false) {
+        return 0;
+    }
+
+#ifndef __linux__
+    lssdp_warn("socket filter is not supported on this platform\n");
+    return 0;
+#else
+    const char * header[] = {Global.HEADER_MSEARCH, Global.HEADER_NOTIFY, Global.HEADER_RESPONSE};
+    const size_t HEADER_NUM = sizeof(header) / sizeof(header[0]);
+
+    // IPv4 address of self address set is IPv4-mapped IPv6 address ::ffff:a.b.c.d
+    static const uint8_t IPV4_MAPPED[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    const lssdp_self_address_slot * slot = lssdp->self_address.slot;
+    size_t i, j;
+
+    // 1. length of program: each self address is jeq + ret, each compare is ld + jeq, each header ends with ret
+    size_t len = 1;
+    for (i = 0; i < lssdp->self_address.slot_num; i++) {
+        if (memcmp(slot[i].addr, IPV4_MAPPED, 12) == 0) {
+            len += 2;
+        }
+    }
+    for (i = 0; i < HEADER_NUM; i++) {
+        size_t n = strlen(header[i]);
+        len += 2 * (n / 4 + (n % 4) / 2 + (n % 2)) + 1;
+    }
+    len++;
+    if (len > LSSDP_FILTER_LEN) {
+        lssdp_error("socket filter is too long (%zu)\n", len);
+        return -1;
+    }
+
+    struct sock_filter * code = (struct sock_filter *) malloc(sizeof(struct sock_filter) * len);
+    if (code == NULL) {
+        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    size_t pc = 0;
+
+    // 2. A = IP source address, drop if it is self address. jeq skips its ret, so the jump is short for any set size
+    code[pc++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12);
+    for (i = 0; i < lssdp->self_address.slot_num; i++) {
+        if (memcmp(slot[i].addr, IPV4_MAPPED, 12) != 0) {
+            continue;
+        }
+        uint32_t addr;
+        memcpy(&addr, &slot[i].addr[12], sizeof(addr));
+        code[pc++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(addr), 0, 1);
+        code[pc++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+    }
+
+    // 3. compare payload with each header line, mismatch jumps to next header line
+    for (i = 0; i < HEADER_NUM; i++) {
+        const uint8_t * h = (const uint8_t *) header[i];
+        size_t n = strlen(header[i]);
+        size_t next = pc + 2 * (n / 4 + (n % 4) / 2 + (n % 2)) + 1;
+
+        for (j = 0; j < n; ) {
+            uint32_t size, value;
+            if (n - j >= 4) {
+                size  = BPF_W;
+                value = (uint32_t) h[j] << 24 | h[j + 1] << 16 | h[j + 2] << 8 | h[j + 3];
+                j += 4;
+            } else if (n - j >= 2) {
+                size  = BPF_H;
+                value = h[j] << 8 | h[j + 1];
+                j += 2;
+            } else {
+                size  = BPF_B;
+                value = h[j];
+                j += 1;
+            }
+            size_t offset = 8 + j - (size == BPF_W ? 4 : size == BPF_H ? 2 : 1);
+            code[pc++] = (struct sock_filter) BPF_STMT(BPF_LD | size | BPF_ABS, offset);
+            code[pc]   = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, value, 0, next - pc - 1);
+            pc++;
+        }
+        code[pc++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF);
+    }
+
+    // 4. drop
+    code[pc++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+
+    struct sock_fprog program = {
+        .len    = pc,
+        .filter = code
+    };
+    int ret = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+    free(code);
+    if (ret != 0) {
+        lssdp_error("setsockopt SO_ATTACH_FILTER failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    lssdp_debug("attach socket filter (%zu instructions) to socket %d\n", pc, sock);
+    return 0;
+#endif
+}
+
+static ssize_t udp_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info) {
+    struct sockaddr_in address = {};
+    struct iovec iov = {
+        .iov_base = buffer,
+        .iov_len  = buffer_len
+    };
+    union {
+        struct cmsghdr header;
+        char    buffer[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec))];
+    } control;
+    struct msghdr msg = {
+        .msg_name       = &address,
+        .msg_namelen    = sizeof(address),
+        .msg_iov        = &iov,
+        .msg_iovlen     = 1,
+        .msg_control    = &control,
+        .msg_controllen = sizeof(control)
+    };
+
+    ssize_t recv_len = recvmsg(lssdp->sock, &msg, 0);
+    if (recv_len == -1) {
+        lssdp_error("recvmsg fd %d failed, errno = %s (%d)\n", lssdp->sock, strerror(errno), errno);
+        return -1;
+    }
+
+    info->addr = address.sin_addr.s_addr;
+    info->port = ntohs(address.sin_port);
+
+    struct cmsghdr * cmsg;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&info->drop_counter, CMSG_DATA(cmsg), sizeof(uint32_t));
+        }
+#endif
+#if defined(SO_TIMESTAMPNS)
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            info->timestamp = (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        }
+#elif defined(SO_TIMESTAMP)
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            info->timestamp = (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+        }
+#endif
+    }
+    return recv_len;
+}
+
+static ssize_t udp_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port) {
+    struct sockaddr_in dest_addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = address
+    };
+    struct msghdr msg = {
+        .msg_name    = &dest_addr,
+        .msg_namelen = sizeof(dest_addr),
+        .msg_iov     = (struct iovec *) iov,
+        .msg_iovlen  = iov_num
+    };
+
+    ssize_t send_len = sendmsg(lssdp->sock, &msg, 0);
+    if (send_len == -1) {
+        lssdp_error("sendmsg fd %d failed, errno = %s (%d)\n", lssdp->sock, strerror(errno), errno);
+    }
+    return send_len;
+}
+
+static ssize_t udp_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num) {
+    ssize_t result = -1;
+
+    // 1. create UDP socket
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 2. bind socket
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = interface->addr
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 3. disable IP_MULTICAST_LOOP
+    char opt = 0;
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &opt, sizeof(opt)) < 0) {
+        lssdp_error("setsockopt IP_MULTICAST_LOOP failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 4. set destination address
+    struct sockaddr_in dest_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(lssdp->port)
+    };
+    if (inet_aton(Global.ADDR_MULTICAST, &dest_addr.sin_addr) == 0) {
+        lssdp_error("inet_aton failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 5. send data
+    struct msghdr msg = {
+        .msg_name    = &dest_addr,
+        .msg_namelen = sizeof(dest_addr),
+        .msg_iov     = (struct iovec *) iov,
+        .msg_iovlen  = iov_num
+    };
+    result = sendmsg(fd, &msg, 0);
+    if (result == -1) {
+        lssdp_error("sendto %s (%s) failed, errno = %s (%d)\n", interface->name, interface->ip, strerror(errno), errno);
+        goto end;
+    }
+
+end:
+    if (fd >= 0 && close(fd) != 0) {
+        lssdp_error("close fd %d failed, errno = %s (%d)\n", fd, strerror(errno), errno);
+    }
+    return result;
+}
+
+static int udp_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size) {
+    memset(list, 0, sizeof(struct lssdp_interface) * list_size);
+
+    int result = -1;
+    size_t interface_num = 0;
+
+    /* Reference to this article:
+     * http://stackoverflow.com/a/8007079
+     */
+
+    // 1. create UDP socket
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 2. get ifconfig
+    char buffer[LSSDP_BUFFER_LEN] = {};
+    struct ifconf ifc = {
+        .ifc_len = sizeof(buffer),
+        .ifc_buf = (caddr_t) buffer
+    };
+
+    if (ioctl(fd, SIOCGIFCONF, &ifc) < 0) {
+        lssdp_error("ioctl SIOCGIFCONF failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // 3. setup interface list
+    size_t i;
+    struct ifreq * ifr;
+    for (i = 0; i < ifc.ifc_len; i += _SIZEOF_ADDR_IFREQ(*ifr)) {
+        ifr = (struct ifreq *)(buffer + i);
+        if (ifr->ifr_addr.sa_family != AF_INET) {
+            // only support IPv4
+            continue;
+        }
 
-        // mask address to check whether the interface is under the same Local Network Area or not
-        if ((ifc->addr & ifc->netmask) == (address & ifc->netmask)) {
-            return ifc;
+        // 3-1. get interface ip string
+        char ip[LSSDP_IP_LEN] = {};
+        struct sockaddr_in * addr = (struct sockaddr_in *) &ifr->ifr_addr;
+        if (inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip)) == NULL) {
+            lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
+            continue;
+        }
+
+        // 3-2. get network mask
+        struct ifreq netmask = {};
+        strcpy(netmask.ifr_name, ifr->ifr_name);
+        if (ioctl(fd, SIOCGIFNETMASK, &netmask) != 0) {
+            lssdp_error("ioctl SIOCGIFNETMASK failed, errno = %s (%d)\n", strerror(errno), errno);
+            continue;
         }
+
+        // 3-3. check network interface number
+        if (interface_num >= list_size) {
+            lssdp_warn("interface number is over than MAX SIZE (%zu)     %s %s\n", list_size, ifr->ifr_name, ip);
+            continue;
+        }
+
+        // 3-4. set interface
+        size_t n = interface_num;
+        snprintf(list[n].name, LSSDP_INTERFACE_NAME_LEN, "%.*s", IFNAMSIZ - 1, ifr->ifr_name);  // name
+        snprintf(list[n].ip,   LSSDP_IP_LEN,             "%s", ip);             // ip string
+        list[n].addr = addr->sin_addr.s_addr;                                   // address in network byte order
+
+        // set network mask
+        addr = (struct sockaddr_in *) &netmask.ifr_addr;
+        list[n].netmask = addr->sin_addr.s_addr;                                // mask in network byte order
+
+        // increase interface number
+        interface_num++;
     }
-    return NULL;
+
+    result = interface_num;
+end:
+    // close socket
+    if (fd >= 0 && close(fd) != 0) {
+        lssdp_error("close fd %d failed, errno = %s (%d)\n", fd, strerror(errno), errno);
+    }
+    return result;
+}
+
+static long long udp_now(lssdp_ctx * lssdp) {
+    struct timeval time = {};
+    if (gettimeofday(&time, NULL) == -1) {
+        lssdp_error("gettimeofday failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    return (long long) time.tv_sec * 1000 + (long long) time.tv_usec / 1000;
 }
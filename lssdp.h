@@ -1,8 +1,24 @@
 #ifndef __LSSDP_H
 #define __LSSDP_H
 
+#include <stdio.h>    // FILE
 #include <stdbool.h>  // bool, true, false
 #include <stdint.h>   // uint32_t
+#include <sys/types.h>  // ssize_t
+#include <sys/uio.h>    // struct iovec
+#include <sys/select.h> // fd_set
+#include <poll.h>       // struct pollfd, POLLIN, POLLOUT
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// LSSDP_API: symbols exported by shared library, everything else is hidden (-fvisibility=hidden)
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define LSSDP_API __attribute__ ((visibility ("default")))
+#else
+#define LSSDP_API
+#endif
 
 // LSSDP Log Level
 enum LSSDP_LOG {
@@ -12,43 +28,334 @@ enum LSSDP_LOG {
     LSSDP_LOG_ERROR = 1 << 3
 };
 
+// LSSDP Neighbor Event
+enum LSSDP_NEIGHBOR_EVENT {
+    LSSDP_NEIGHBOR_ADDED   = 0,                             // new neighbor
+    LSSDP_NEIGHBOR_UPDATED = 1,                             // usn, location, path, st, sm_id, device_type or extra header is changed
+    LSSDP_NEIGHBOR_REMOVED = 2,                             // byebye, timeout, evicted or force clean up, nbr is freed after callback
+    LSSDP_NEIGHBOR_REBOOTED = 3,                            // BOOTID.UPNP.ORG is changed (not by ssdp:update NEXTBOOTID.UPNP.ORG)
+    LSSDP_NEIGHBOR_CONFIG_CHANGED = 4                       // CONFIGID.UPNP.ORG is changed, device description should be fetched again
+};
+
+// LSSDP Search Target Match Mode (NOTIFY / RESPONSE)
+enum LSSDP_ST_MATCH {
+    LSSDP_ST_MATCH_EXACT   = 0,                             // ST is equal to search_target
+    LSSDP_ST_MATCH_PREFIX  = 1,                             // ST starts with search_target
+    LSSDP_ST_MATCH_VERSION = 2                              // ST is same UPnP type, and version >= search_target version
+};
+
+/* Struct : lssdp_interface */
+#define LSSDP_INTERFACE_NAME_LEN    16                      // IFNAMSIZ
+#define LSSDP_INTERFACE_LIST_SIZE   16
+#define LSSDP_IP_LEN                16
+struct lssdp_interface {
+    char            name        [LSSDP_INTERFACE_NAME_LEN]; // name[16]
+    char            ip          [LSSDP_IP_LEN];             // ip[16] = "xxx.xxx.xxx.xxx"
+    uint32_t        addr;                                   // address in network byte order
+    uint32_t        netmask;                                // mask in network byte order
+};
+
+
 /* Struct : lssdp_nbr */
 #define LSSDP_FIELD_LEN         128
 #define LSSDP_LOCATION_LEN      256
+#define LSSDP_HEADER_INTEREST_NUM   8                       // max extra header number of interest set
+#define LSSDP_HEADER_NAME_LEN       32
+#define LSSDP_HEADER_ARENA_LEN      256                     // max extra header values of a neighbor, NUL terminated
+typedef struct lssdp_extra_header {
+    uint16_t        offset;                                 // offset of value in extra_arena (or packet)
+    uint16_t        len;                                    // value length, 0 is absent
+} lssdp_extra_header;
+
+#define LSSDP_NEIGHBOR_PATH_NUM     4                       // max paths of a neighbor_merge neighbor, the oldest path is replaced
+typedef struct lssdp_nbr_path {
+    char            interface   [LSSDP_INTERFACE_NAME_LEN]; // received interface, empty if not in LAN of any interface
+    char            location    [LSSDP_LOCATION_LEN];
+    uint32_t        addr;                                   // source address in network byte order
+    long long       update_time;
+} lssdp_nbr_path;
+
 typedef struct lssdp_nbr {
     char            usn         [LSSDP_FIELD_LEN];          // Unique Service Name (Device Name or MAC)
     char            location    [LSSDP_LOCATION_LEN];       // URL or IP(:Port)
+    char            st          [LSSDP_FIELD_LEN];          // Search Target (ST or NT)
 
     /* Additional SSDP Header Fields */
     char            sm_id       [LSSDP_FIELD_LEN];
     char            device_type [LSSDP_FIELD_LEN];
+    long            boot_id;                                // BOOTID.UPNP.ORG, -1 if absent
+    long            config_id;                              // CONFIGID.UPNP.ORG, -1 if absent
     long long       update_time;
+    long long       probe_time;                             // last unicast M-SEARCH probe time
+    uint32_t        addr;                                   // source address in network byte order
+
+    /* Paths of neighbor_merge: every (interface, location) which the neighbor is received from, location and addr are of path[0].
+     * allocated out of line, NULL if neighbor_merge is false and in search result
+     */
+    lssdp_nbr_path * path;
+    size_t          path_num;
+
+    /* Extra Header Fields: indexed by lssdp.header_interest, use lssdp_neighbor_header to get value */
+    lssdp_extra_header extra    [LSSDP_HEADER_INTEREST_NUM];
+    char *          extra_arena;                            // values, allocated out of line, NULL if no extra header
+    bool            extra_is_notify[LSSDP_HEADER_INTEREST_NUM]; // value is of NOTIFY (or RESPONSE), kept while absent in the other type
     struct lssdp_nbr * next;
+
+    /* Neighbor Index (internal) */
+    uint32_t        hash;
+    struct lssdp_nbr * prev;
+    struct lssdp_nbr * hash_next;
 } lssdp_nbr;
 
 
+/* Struct : lssdp_st_pattern (compiled Search Target) */
+typedef struct lssdp_st_pattern {
+    char            source      [LSSDP_FIELD_LEN];          // search_target which the pattern is compiled from
+    size_t          len;                                    // length of source
+    size_t          type_len;                               // length of "urn:domain:device:type:" without version
+    long            version;                                // UPnP version, -1 if ST is not versioned
+    bool            is_all;                                 // ST is "ssdp:all"
+} lssdp_st_pattern;
+
+
+/* Struct : lssdp_recv_info */
+typedef struct lssdp_recv_info {
+    uint32_t        addr;                                   // source address in network byte order
+    unsigned short  port;                                   // source port
+    uint32_t        drop_counter;                           // socket drop counter (SO_RXQ_OVFL), cumulative, 0 if not supported
+    long long       timestamp;                              // arrival time in microseconds on transport clock, 0 if not supported
+} lssdp_recv_info;
+
+
+/* Struct : lssdp_stats */
+#define LSSDP_LATENCY_BUCKET_NUM    20
+typedef struct lssdp_stats {
+    size_t          packet_received;                        // datagrams received
+    size_t          byte_received;                          // bytes received
+    size_t          packet_self;                            // ignored, from self address
+    size_t          packet_invalid;                         // ignored, parse failed
+    size_t          packet_dropped;                         // dropped by kernel receive queue (SO_RXQ_OVFL), not counted with socket_filter
+    size_t          rcvbuf_grow;                            // times of receive buffer growth
+    int             rcvbuf;                                 // current SO_RCVBUF reported by kernel
+    size_t          latency[LSSDP_LATENCY_BUCKET_NUM];      // arrival to parsed in microseconds: [0] < 1, [i] < 2^i, last is overflow
+    uint32_t        drop_counter;                           // last socket drop counter (internal)
+    int             rcvbuf_size;                            // SO_RCVBUF grown by adaptive receive buffer, rcvbuf.size is kept (internal)
+    size_t          drop_unreported;                        // dropped packets since the last warning (internal)
+    long long       drop_warn_time;                         // time of the last drop warning (internal)
+} lssdp_stats;
+
+
+/* Struct : lssdp_transport
+ *
+ * All network I/O of lssdp goes through the transport. lssdp_transport_udp is used if lssdp.transport is NULL.
+ * Each function returns < 0 on failure.
+ */
+struct lssdp_ctx;
+typedef struct lssdp_transport {
+    int       (* socket_open)    (struct lssdp_ctx * lssdp);                                     // return SSDP socket (> 0) bound to lssdp.port
+    int       (* socket_close)   (struct lssdp_ctx * lssdp, int sock);
+    ssize_t   (* recv)           (struct lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info);
+    ssize_t   (* send)           (struct lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port);
+    ssize_t   (* send_multicast) (struct lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num);
+    int       (* interface_list) (struct lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size);  // return interface number, the rest of list is zeroed
+    long long (* now)            (struct lssdp_ctx * lssdp);                                     // milliseconds
+} lssdp_transport;
+
+extern LSSDP_API const lssdp_transport lssdp_transport_udp;           // UDP socket and multicast
+
+
+/* Struct : lssdp_search_result (RESPONSE collected by search session, the latest one per USN and location) */
+typedef struct lssdp_search_result {
+    char            usn         [LSSDP_FIELD_LEN];
+    char            location    [LSSDP_LOCATION_LEN];
+    char            st          [LSSDP_FIELD_LEN];
+    char            sm_id       [LSSDP_FIELD_LEN];
+    char            device_type [LSSDP_FIELD_LEN];
+    long            boot_id;                                // BOOTID.UPNP.ORG, -1 if absent
+    long            config_id;                              // CONFIGID.UPNP.ORG, -1 if absent
+    long long       update_time;
+    uint32_t        addr;                                   // source address in network byte order
+
+    /* Extra Header Fields: indexed by lssdp.header_interest, use lssdp_search_result_header to get value */
+    lssdp_extra_header extra    [LSSDP_HEADER_INTEREST_NUM];
+    char *          extra_arena;                            // values, allocated out of line, NULL if no extra header
+
+    /* Result Index (internal) */
+    uint32_t        hash;                                   // hash of USN and location
+    size_t          hash_next;                              // index + 1 of the next result in the same bucket, 0 is end
+} lssdp_search_result;
+
+/* Struct : lssdp_search
+ *
+ * search session, started by lssdp_search_start, and freed after it is completed or cancelled.
+ */
+typedef struct lssdp_search {
+    int             id;                                     // session id (> 0)
+    char            st          [LSSDP_FIELD_LEN];          // Search Target of M-SEARCH, "ssdp:all" collects every RESPONSE
+    long long       start_time;                             // milliseconds
+    long long       deadline;                               // milliseconds
+    lssdp_search_result * result;                           // RESPONSE array, one per USN and location
+    size_t          result_num;
+    size_t          result_max;                             // allocated size of result and result_bucket (internal)
+    size_t *        result_bucket;                          // index + 1 of the first result, hashed by USN and location (internal)
+    void (* callback)(struct lssdp_ctx * lssdp, const struct lssdp_search * search, void * user_data);
+    void *          user_data;
+
+    /* Search Session Index (internal) */
+    uint32_t        hash;                                   // hash of st
+    struct lssdp_search * next;                             // session list, ordered by deadline
+    struct lssdp_search * hash_next;
+} lssdp_search;
+
+
+/* Struct : lssdp_description (device description fetched from neighbor LOCATION, see description_fetched_callback) */
+typedef struct lssdp_description {
+    char            usn         [LSSDP_FIELD_LEN];          // neighbor which the fetch is started by
+    char            location    [LSSDP_LOCATION_LEN];
+    long            config_id;                              // CONFIGID.UPNP.ORG of neighbor, -1 if absent
+    int             status;                                 // HTTP status: 200, 304 (body is cached), other is failed. < 0 is connect, timeout or invalid response
+    bool            is_cached;                              // body is from cache, by the same location and CONFIGID or by 304 Not Modified
+    const char *    body;                                   // NUL terminated description, NULL if failed, valid in callback only
+    size_t          body_len;
+} lssdp_description;
+
+
+/* Struct : lssdp_template
+ *
+ * static segments of M-SEARCH, NOTIFY and RESPONSE packet. Only HOST, LOCATION host and ST are filled at runtime:
+ *
+ *  M-SEARCH = MSEARCH_HEAD  + host (239.255.255.250 or unicast IP) + MSEARCH_MID  + ST + MSEARCH_TAIL
+ *  NOTIFY   = NOTIFY_HEAD   + interface IP (or location.domain)    + NOTIFY_TAIL
+ *  RESPONSE = RESPONSE_HEAD + interface IP (or location.domain)    + RESPONSE_MID + ST + RESPONSE_TAIL
+ */
+#define LSSDP_TEMPLATE_SEGMENT_NUM  8
+enum LSSDP_TEMPLATE_SEGMENT {
+    LSSDP_TEMPLATE_MSEARCH_HEAD,    // "M-SEARCH * HTTP/1.1" ... "HOST:"
+    LSSDP_TEMPLATE_MSEARCH_MID,     // ":port" ... "ST:"
+    LSSDP_TEMPLATE_MSEARCH_TAIL,    // "USER-AGENT:" ... end of packet
+    LSSDP_TEMPLATE_NOTIFY_HEAD,     // "NOTIFY * HTTP/1.1" ... "LOCATION:prefix"
+    LSSDP_TEMPLATE_NOTIFY_TAIL,     // "suffix" ... end of packet
+    LSSDP_TEMPLATE_RESPONSE_HEAD,   // "HTTP/1.1 200 OK" ... "LOCATION:prefix"
+    LSSDP_TEMPLATE_RESPONSE_MID,    // "suffix" ... "ST:"
+    LSSDP_TEMPLATE_RESPONSE_TAIL    // "USN:" ... end of packet
+};
+
+typedef struct lssdp_template {
+    struct {
+        const char * data;
+        size_t       len;
+    } segment[LSSDP_TEMPLATE_SEGMENT_NUM];                  // indexed by LSSDP_TEMPLATE_SEGMENT
+} lssdp_template;
+
+
 /* Struct : lssdp_ctx */
-#define LSSDP_INTERFACE_NAME_LEN    16                      // IFNAMSIZ
-#define LSSDP_INTERFACE_LIST_SIZE   16
-#define LSSDP_IP_LEN                16
+struct lssdp_hub;
+struct lssdp_fetch;
+struct lssdp_fetch_cache;
+struct lssdp_http_resource;
+struct lssdp_http_connection;
+#define LSSDP_SEARCH_BUCKET_NUM     32                      // hash bucket number of search session index, power of 2
+#define LSSDP_SELF_ADDRESS_SIZE     64                      // initial hash slot number of self address set, power of 2, doubled when half full
+typedef struct lssdp_self_address_slot {
+    uint8_t         addr        [16];                       // IPv4 is stored as IPv4-mapped IPv6 (::ffff:a.b.c.d), all zero is empty slot
+    bool            is_user;                                // added by lssdp_self_address_add, kept when the set is rebuilt
+} lssdp_self_address_slot;
+#define LSSDP_TEMPLATE_LEN          4096
 typedef struct lssdp_ctx {
     int             sock;                                   // SSDP socket
+    struct lssdp_hub * hub;                                 // SSDP hub which owns the socket (internal)
+    const lssdp_transport * transport;                      // network transport, NULL is lssdp_transport_udp
+    void *          transport_data;                         // transport private data
+    void *          user_data;                              // application data, passed to every callback with user_data
+    FILE *          capture;                                // pcap-ng capture of received packets, see lssdp_capture_open
     unsigned short  port;                                   // SSDP port (0x0000 ~ 0xFFFF)
-    lssdp_nbr *     neighbor_list;                          // SSDP neighbor list
+    lssdp_nbr *     neighbor_list;                          // SSDP neighbor list, ordered by update_time (oldest first)
+    size_t          neighbor_num;                           // SSDP neighbor number
+    size_t          neighbor_max;                           // 0 is unlimited, otherwise the oldest neighbor is evicted
     long            neighbor_timeout;                       // milliseconds
+    bool            neighbor_probe;                         // probe neighbor by unicast M-SEARCH before timeout
     bool            debug;                                  // show debug log
+    bool            socket_filter;                          // attach kernel socket filter (Linux): drop self and non-SSDP packets
+
+    /* Receive Buffer */
+    struct {
+        int         size;                                   // SO_RCVBUF bytes, 0 is system default
+        int         size_max;                               // double size up to size_max when kernel drops packets, 0 is disabled, not with socket_filter
+    } rcvbuf;
+
+    lssdp_stats     stats;                                  // receive statistics
+    bool            monitor;                                // keep every NOTIFY/RESPONSE device, keyed by ST and USN, can be changed at runtime
+    bool            neighbor_merge;                         // key neighbor by USN, the paths of every interface and location are merged, can be changed at runtime
+    int             st_match;                               // LSSDP_ST_MATCH_EXACT (default), LSSDP_ST_MATCH_PREFIX, LSSDP_ST_MATCH_VERSION
+    lssdp_st_pattern st_pattern;                            // compiled header.search_target (internal)
+
+    /* M-SEARCH Scheduler */
+    struct {
+        long        interval_min;                           // milliseconds, default 1000
+        long        interval_max;                           // milliseconds, default 60000
+        long        interval;                               // current interval (internal)
+        long long   next_time;                              // next M-SEARCH time (internal)
+        bool        is_changed;                             // neighbor set is changed since last M-SEARCH (internal)
+    } msearch;
+
+    /* Neighbor Index (internal) */
+    struct {
+        lssdp_nbr ** bucket;                                // hash bucket list
+        size_t      bucket_num;                             // power of 2
+        lssdp_nbr * tail;                                   // the latest updated neighbor
+        int         key;                                    // key of hash: location, ST and USN (monitor), or USN (neighbor_merge)
+    } neighbor_index;
+
+    /* Search Session (internal) */
+    struct {
+        lssdp_search * list;                                // ordered by deadline
+        lssdp_search * bucket[LSSDP_SEARCH_BUCKET_NUM];     // indexed by hash of st
+        size_t      num;
+        int         last_id;
+    } search;
+
+    /* Description Fetcher: enabled by description_fetched_callback, driven by lssdp_event_fdset and lssdp_event_process,
+     * or lssdp_event_pollfd and lssdp_event_ready */
+    struct {
+        size_t      connection_max;                         // concurrent connections, default 8
+        size_t      host_max;                               // concurrent connections per host, default 2
+        long        timeout;                                // milliseconds of each fetch, default 5000
+        size_t      body_max;                               // max description bytes, default 65536
+        size_t      cache_max;                              // cached descriptions, default 32
+        struct lssdp_fetch * queue;                         // waiting fetch, FIFO (internal)
+        struct lssdp_fetch * active;                        // connecting, transferring or completed fetch (internal)
+        size_t      active_num;                             // (internal)
+        struct lssdp_fetch_cache * cache;                   // keyed by location, the latest used first (internal)
+        size_t      cache_num;                              // (internal)
+    } fetch;
+
+    /* Description Responder: HTTP/1.1 server of registered documents, driven by lssdp_event_fdset and lssdp_event_process,
+     * or lssdp_event_pollfd and lssdp_event_ready */
+    struct {
+        int         sock;                                   // listen socket, opened by lssdp_http_open
+        unsigned short port;                                // listen port
+        size_t      connection_max;                         // concurrent connections, default 64
+        long        idle_timeout;                           // milliseconds of idle keep-alive connection, default 5000
+        struct lssdp_http_resource * resource;              // registered documents (internal)
+        struct lssdp_http_connection * connection;          // (internal)
+        size_t      connection_num;                         // (internal)
+    } http;
 
     /* Network Interface */
     size_t          interface_num;                          // interface number
-    struct lssdp_interface {
-        char        name        [LSSDP_INTERFACE_NAME_LEN]; // name[16]
-        char        ip          [LSSDP_IP_LEN];             // ip[16] = "xxx.xxx.xxx.xxx"
-        uint32_t    addr;                                   // address in network byte order
-        uint32_t    netmask;                                // mask in network byte order
-    } interface[LSSDP_INTERFACE_LIST_SIZE];                 // interface[16]
+    struct lssdp_interface interface[LSSDP_INTERFACE_LIST_SIZE];    // interface[16]
 
-    /* SSDP Header Fields */
+    /* Self Address Set (internal): open addressing, allocated by lssdp_network_interface_update and lssdp_self_address_add,
+     * freed by lssdp_self_address_clear. A context in SSDP hub uses the set of hub.ctx
+     */
     struct {
+        size_t      num;                                    // at most half of slot_num
+        size_t      slot_num;                               // 0 or power of 2
+        lssdp_self_address_slot * slot;
+    } self_address;
+
+    /* SSDP Header Fields */
+    struct lssdp_header {
         /* SSDP Standard Header Fields */
         char        search_target       [LSSDP_FIELD_LEN];  // Search Target
         char        unique_service_name [LSSDP_FIELD_LEN];  // Unique Service Name: MAC or User Name
@@ -63,14 +370,61 @@ typedef struct lssdp_ctx {
         char        device_type [LSSDP_FIELD_LEN];
     } header;
 
+    /* Extra Header Interest Set: captured by parser in the same pass, use lssdp_header_interest_add */
+    struct {
+        size_t      num;
+        char        name[LSSDP_HEADER_INTEREST_NUM][LSSDP_HEADER_NAME_LEN];     // case-insensitive, e.g. "SERVER", "BOOTID.UPNP.ORG"
+    } header_interest;
+
+    /* Packet Template (internal): preformatted static segments of M-SEARCH, NOTIFY and RESPONSE */
+    struct {
+        struct lssdp_header header;                         // header which the template is built from
+        unsigned short  port;                               // port which the template is built from
+        struct {
+            uint16_t    offset;
+            uint16_t    len;
+        } segment[LSSDP_TEMPLATE_SEGMENT_NUM];
+        char            buffer[LSSDP_TEMPLATE_LEN];
+    } packet_template;
+    const lssdp_template * static_template;                 // caller supplied static segments, NULL is built from header and port
+
     /* Callback Function */
     int (* network_interface_changed_callback) (struct lssdp_ctx * lssdp);
     int (* neighbor_list_changed_callback)     (struct lssdp_ctx * lssdp);
     int (* packet_received_callback)           (struct lssdp_ctx * lssdp, const char * packet, size_t packet_len);
+    void (* neighbor_event_callback)           (struct lssdp_ctx * lssdp, int event, const lssdp_nbr * nbr, void * user_data);
+    void (* description_fetched_callback)      (struct lssdp_ctx * lssdp, const lssdp_description * description, void * user_data);
+
+    /* Callback Function with user_data: invoked instead of the callback of the same name without _data */
+    int (* network_interface_changed_callback_data) (struct lssdp_ctx * lssdp, const struct lssdp_interface * interface, size_t interface_num, void * user_data);
+    int (* neighbor_list_changed_callback_data)     (struct lssdp_ctx * lssdp, const lssdp_nbr * neighbor_list, size_t neighbor_num, void * user_data);
+    // address is the source address, interface is the interface in the same LAN (NULL if none)
+    int (* packet_received_callback_data)           (struct lssdp_ctx * lssdp, const char * packet, size_t packet_len,
+                                                     uint32_t address, const struct lssdp_interface * interface, void * user_data);
 
 } lssdp_ctx;
 
 
+/* Struct : lssdp_hub */
+typedef struct lssdp_hub {
+    lssdp_ctx       ctx;                                    // shared SSDP socket, port and network interface
+
+    /* Registered Context (internal) */
+    size_t          ctx_num;
+    size_t          ctx_list_size;
+    lssdp_ctx **    ctx_list;
+
+    /* Search Target Index (internal) */
+    size_t          st_index_size;                          // power of 2
+    struct lssdp_hub_entry {
+        uint32_t    hash;                                   // hash of ST (without UPnP version)
+        lssdp_ctx * ctx;
+    } * st_index;                                           // open addressing hash table
+    size_t          wildcard_num;
+    lssdp_ctx **    wildcard_list;                          // monitor, "ssdp:all" or prefix match context
+} lssdp_hub;
+
+
 /*
  * 01. lssdp_network_interface_update
  *
@@ -83,7 +437,7 @@ typedef struct lssdp_ctx {
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_network_interface_update(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_network_interface_update(lssdp_ctx * lssdp);
 
 /*
  * 02. lssdp_socket_create
@@ -100,7 +454,7 @@ int lssdp_network_interface_update(lssdp_ctx * lssdp);
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_socket_create(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_socket_create(lssdp_ctx * lssdp);
 
 /*
  * 03. lssdp_socket_close
@@ -115,7 +469,7 @@ int lssdp_socket_create(lssdp_ctx * lssdp);
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_socket_close(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_socket_close(lssdp_ctx * lssdp);
 
 /*
  * 04. lssdp_socket_read
@@ -123,19 +477,26 @@ int lssdp_socket_close(lssdp_ctx * lssdp);
  * read SSDP socket.
  *
  * 1. if read success, packet_received_callback will be invoked.
- * 2. if received SSDP packet is match to Search Target (lssdp.header.search_target),
+ * 2. if lssdp.monitor is true, all NOTIFY/RESPONSE are added to SSDP neighbor list, and M-SEARCH is ignored.
+ *    otherwise, if received SSDP packet is match to Search Target (lssdp.header.search_target),
  *     - M-SEARCH: send RESPONSE back
+ *       (ST is "ssdp:all", equal to search_target, or a lower version of the same UPnP type)
  *     - NOTIFY/RESPONSE: add/update to SSDP neighbor list
+ *       (search_target is "ssdp:all", or ST is matched by lssdp.st_match mode)
  *
  * Note:
  *  - SSDP socket and port must be setup ready before call this function. (sock, port > 0)
+ *  - NOTIFY with "NTS: ssdp:byebye" removes the neighbor.
+ *  - neighbor is keyed by location, or by ST and USN in monitor mode, or by USN if lssdp.neighbor_merge is true.
+ *  - neighbor_merge: a new interface of the neighbor is added to nbr.path, a changed address on the same interface
+ *    replaces its path, the path which is not received within lssdp.neighbor_timeout is removed, all are LSSDP_NEIGHBOR_UPDATED.
  *  - if SSDP neighbor list has been changed, neighbor_list_changed_callback will be invoked.
  *
  * @param lssdp
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_socket_read(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_socket_read(lssdp_ctx * lssdp);
 
 /*
  * 05. lssdp_send_msearch
@@ -149,7 +510,7 @@ int lssdp_socket_read(lssdp_ctx * lssdp);
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_send_msearch(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_send_msearch(lssdp_ctx * lssdp);
 
 /*
  * 06. lssdp_send_notify
@@ -163,7 +524,7 @@ int lssdp_send_msearch(lssdp_ctx * lssdp);
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_send_notify(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_send_notify(lssdp_ctx * lssdp);
 
 /*
  * 07. lssdp_neighbor_check_timeout
@@ -171,14 +532,19 @@ int lssdp_send_notify(lssdp_ctx * lssdp);
  * check neighbor in list is timeout or not. (lssdp.neighbor_timeout)
  * the timeout neighbor will be remove from the list.
  *
+ * if lssdp.neighbor_probe is true, a unicast M-SEARCH of the neighbor ST is sent to the neighbor
+ * which has not been updated for 80% of lssdp.neighbor_timeout. The neighbor is
+ * removed only if it still does not reply until timeout.
+ *
  * Note:
  *  - if neighbor be removed, neighbor_list_changed_callback will be invoked.
+ *  - with neighbor_probe, call this function more often than 20% of neighbor_timeout.
  *
  * @param lssdp
  * @return = 0      success
  *         < 0      failed
  */
-int lssdp_neighbor_check_timeout(lssdp_ctx * lssdp);
+LSSDP_API int lssdp_neighbor_check_timeout(lssdp_ctx * lssdp);
 
 /*
  * 08. lssdp_set_log_callback
@@ -187,6 +553,455 @@ int lssdp_neighbor_check_timeout(lssdp_ctx * lssdp);
  *
  * @param callback
  */
-void lssdp_set_log_callback(void (* callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message));
+LSSDP_API void lssdp_set_log_callback(void (* callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message));
+
+/*
+ * 09. lssdp_msearch_schedule
+ *
+ * send SSDP M-SEARCH packet when the M-SEARCH scheduler is due.
+ *
+ * 1. the first M-SEARCH is sent immediately, with interval lssdp.msearch.interval_min
+ * 2. if the neighbor set has been changed since last M-SEARCH, interval is reset to interval_min
+ * 3. otherwise interval is doubled, up to lssdp.msearch.interval_max
+ *
+ * Note:
+ *  - call this function periodically from the main loop (e.g. every 500 ms), or when lssdp_next_timeout is due.
+ *  - the scheduler is restarted when network interface is changed.
+ *  - NOTIFY (lssdp_send_notify) keeps neighbor list fresh while M-SEARCH is backing off,
+ *    so lssdp.neighbor_timeout should be longer than the NOTIFY period.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_msearch_schedule(lssdp_ctx * lssdp);
+
+/*
+ * 10. lssdp_send_msearch_unicast
+ *
+ * send SSDP M-SEARCH packet to single address by SSDP socket.
+ *
+ * Note:
+ *  - SSDP socket and port must be setup ready before call this function. (sock, port > 0)
+ *  - the RESPONSE will be received by lssdp_socket_read.
+ *
+ * @param lssdp
+ * @param address   IPv4 address in network byte order
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_send_msearch_unicast(lssdp_ctx * lssdp, uint32_t address);
+
+/*
+ * 11. lssdp_hub_add
+ *
+ * register SSDP context to hub. The context shares SSDP socket, port and network interface of hub.ctx.
+ *
+ * Note:
+ *  - do not call lssdp_socket_create and lssdp_network_interface_update with the registered context,
+ *    use hub.ctx and lssdp_hub_network_interface_update instead.
+ *  - if the context search_target, st_match or monitor is changed, call lssdp_hub_add again to re-index.
+ *
+ * @param hub
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_hub_add(lssdp_hub * hub, lssdp_ctx * lssdp);
+
+/*
+ * 12. lssdp_hub_remove
+ *
+ * unregister SSDP context from hub. The context neighbor list will be force clean up.
+ *
+ * @param hub
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_hub_remove(lssdp_hub * hub, lssdp_ctx * lssdp);
+
+/*
+ * 13. lssdp_hub_network_interface_update
+ *
+ * update network interface of hub.ctx, and share it to all registered contexts.
+ *
+ * Note:
+ *  - hub.ctx.network_interface_changed_callback should re-create socket by lssdp_socket_create(&hub->ctx).
+ *  - if network interface is changed, neighbor list of all registered contexts will be force clean up.
+ *
+ * @param hub
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_hub_network_interface_update(lssdp_hub * hub);
+
+/*
+ * 14. lssdp_hub_socket_read
+ *
+ * read SSDP socket of hub.ctx, parse the packet once, and dispatch it to matched contexts.
+ *
+ * Note:
+ *  - hub.ctx.packet_received_callback will be invoked for every packet.
+ *  - M-SEARCH and NOTIFY/RESPONSE are handled by each matched context as lssdp_socket_read.
+ *
+ * @param hub
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_hub_socket_read(lssdp_hub * hub);
+
+/*
+ * 15. lssdp_hub_close
+ *
+ * unregister all contexts, close SSDP socket of hub.ctx, and free hub resources (with self address set of hub.ctx).
+ *
+ * @param hub
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_hub_close(lssdp_hub * hub);
+
+/*
+ * 16. lssdp_capture_open
+ *
+ * write every received datagram into pcap-ng file, with timestamp and source address.
+ *
+ * Note:
+ *  - link type is raw IPv4 (LINKTYPE_RAW), IPv4 and UDP headers are rebuilt from source address and lssdp.port.
+ *  - destination address is always 239.255.255.250, unicast or multicast is not recorded.
+ *  - timestamp is lssdp.transport->now.
+ *  - for SSDP hub, open capture on hub.ctx.
+ *  - capture which is already opened will be closed at first.
+ *
+ * @param lssdp
+ * @param path      capture file path, the file is truncated
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_capture_open(lssdp_ctx * lssdp, const char * path);
+
+/*
+ * 17. lssdp_capture_close
+ *
+ * flush and close the capture file.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_capture_close(lssdp_ctx * lssdp);
+
+/*
+ * 18. lssdp_self_address_add
+ *
+ * add local address to self address set, packets from self address are ignored by lssdp_socket_read.
+ *
+ * Note:
+ *  - the interface addresses are rebuilt from lssdp.interface when network interface is changed,
+ *    the added addresses are kept until lssdp_self_address_clear.
+ *  - the set is grown on demand, the socket filter is regenerated with the new address.
+ *  - for the context in SSDP hub, the address is added to hub.ctx.
+ *
+ * @param lssdp
+ * @param family    AF_INET or AF_INET6
+ * @param address   struct in_addr or struct in6_addr (network byte order)
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_self_address_add(lssdp_ctx * lssdp, int family, const void * address);
+
+/*
+ * 19. lssdp_is_self_address
+ *
+ * check address is one of local addresses.
+ *
+ * @param lssdp
+ * @param family    AF_INET or AF_INET6
+ * @param address   struct in_addr or struct in6_addr (network byte order)
+ * @return true     address is in self address set (of hub.ctx for the context in SSDP hub)
+ */
+LSSDP_API bool lssdp_is_self_address(lssdp_ctx * lssdp, int family, const void * address);
+
+/*
+ * 20. lssdp_set_log_callback_data
+ *
+ * setup SSDP log callback with application data. All logs will be passed to this callback.
+ *
+ * Note:
+ *  - replace the callback of lssdp_set_log_callback, and vice versa.
+ *
+ * @param callback
+ * @param user_data passed to callback
+ */
+LSSDP_API void lssdp_set_log_callback_data(void (* callback)(const char * file, const char * tag, int level, int line, const char * func, const char * message, void * user_data), void * user_data);
+
+/*
+ * 21. lssdp_next_timeout
+ *
+ * get milliseconds until the next deadline of lssdp_msearch_schedule, lssdp_neighbor_check_timeout or lssdp_search_check_timeout,
+ * so event loop can sleep on SSDP socket (poll, epoll, select) exactly until then.
+ *
+ * Note:
+ *  - M-SEARCH scheduler is counted after the first lssdp_msearch_schedule.
+ *  - neighbor timeout (and probe, if lssdp.neighbor_probe is true) is counted if lssdp.neighbor_timeout > 0.
+ *  - description fetch which can be started, and fetch timeout are counted, they are processed by lssdp_event_process.
+ *  - NOTIFY period is not counted, it is decided by application.
+ *
+ * @param lssdp
+ * @return > 0      milliseconds until the next deadline
+ *         = 0      deadline is due, call lssdp_msearch_schedule, lssdp_neighbor_check_timeout and lssdp_search_check_timeout
+ *         < 0      nothing is scheduled (wait for SSDP socket only), or failed
+ */
+LSSDP_API long lssdp_next_timeout(lssdp_ctx * lssdp);
+
+/*
+ * 22. lssdp_search_start
+ *
+ * start search session: send M-SEARCH of st, and collect RESPONSE of st until timeout.
+ * The session is completed by lssdp_search_check_timeout, callback is invoked with the collected RESPONSE.
+ *
+ * Note:
+ *  - many sessions of different (or the same) st can run at the same time, RESPONSE is dispatched by st index.
+ *  - RESPONSE is matched by ST exactly, or every RESPONSE if st is "ssdp:all".
+ *  - RESPONSE of the same USN and location is collected once (the latest one), use lssdp_search_result_header for extra header.
+ *  - search.result is valid in callback only, copy it if needed.
+ *  - for SSDP hub, start session on hub.ctx.
+ *
+ * @param lssdp
+ * @param st        Search Target, NULL is lssdp.header.search_target
+ * @param timeout   milliseconds
+ * @param callback  invoked once when session is completed
+ * @param user_data passed to callback
+ * @return > 0      session id
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_search_start(lssdp_ctx * lssdp, const char * st, long timeout, void (* callback)(lssdp_ctx * lssdp, const lssdp_search * search, void * user_data), void * user_data);
+
+/*
+ * 23. lssdp_search_cancel
+ *
+ * cancel search session, callback is not invoked.
+ *
+ * @param lssdp
+ * @param id        session id, 0 is all sessions
+ * @return = 0      success
+ *         < 0      session is not found
+ */
+LSSDP_API int lssdp_search_cancel(lssdp_ctx * lssdp, int id);
+
+/*
+ * 24. lssdp_search_check_timeout
+ *
+ * complete the search sessions which are timeout, invoke callback and free the session.
+ *
+ * Note:
+ *  - the deadline is counted by lssdp_next_timeout.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_search_check_timeout(lssdp_ctx * lssdp);
+
+/*
+ * 25. lssdp_header_interest_add
+ *
+ * add extra header name to interest set, the header is captured by parser in the same pass of standard headers,
+ * and stored in neighbor (and search result). The other unknown headers are skipped without copy.
+ *
+ * Note:
+ *  - name is case-insensitive, add the same name again returns the same index.
+ *  - for SSDP hub, add to hub.ctx, the index is valid for neighbors of every context.
+ *  - the values of a neighbor share LSSDP_HEADER_ARENA_LEN bytes, the value which is not fit is absent.
+ *
+ * @param lssdp
+ * @param name      header name without colon, e.g. "SERVER"
+ * @return >= 0     index of header, pass to lssdp_neighbor_header
+ *         <  0     failed, interest set is full or name is too long
+ */
+LSSDP_API int lssdp_header_interest_add(lssdp_ctx * lssdp, const char * name);
+
+/*
+ * 26. lssdp_neighbor_header
+ *
+ * get extra header value of neighbor.
+ *
+ * @param nbr
+ * @param index     returned by lssdp_header_interest_add
+ * @return value    NUL terminated string, valid until neighbor is updated or removed
+ *         NULL     header is absent
+ */
+LSSDP_API const char * lssdp_neighbor_header(const lssdp_nbr * nbr, int index);
+
+/*
+ * 27. lssdp_event_fdset
+ *
+ * add SSDP socket, description fetch connections, HTTP listen socket and HTTP connections to fd sets of select.
+ *
+ * Note:
+ *  - SSDP socket of the context registered to SSDP hub is not added, it is read by lssdp_hub_socket_read.
+ *  - use lssdp_next_timeout as select timeout.
+ *
+ * @param lssdp
+ * @param read_fds
+ * @param write_fds
+ * @return >= 0     the max fd which is added
+ *         <  0     nothing is added, or failed
+ */
+LSSDP_API int lssdp_event_fdset(lssdp_ctx * lssdp, fd_set * read_fds, fd_set * write_fds);
+
+/*
+ * 28. lssdp_event_process
+ *
+ * process the fd sets returned by select: read SSDP socket, accept and serve HTTP connections,
+ * transfer description fetch connections, complete the timeout fetch and start the waiting fetch.
+ *
+ * Description Fetcher:
+ *  1. when description_fetched_callback is set, LOCATION of LSSDP_NEIGHBOR_ADDED and LSSDP_NEIGHBOR_CONFIG_CHANGED
+ *     neighbor is fetched by HTTP/1.1 GET. Only "http://" (or no scheme) with IPv4 address is supported.
+ *  2. at most fetch.connection_max connections, and fetch.host_max connections per host.
+ *  3. the same location and CONFIGID is not requested again, the cached description is returned.
+ *     otherwise the request is conditional (If-None-Match, If-Modified-Since) by the cached location.
+ *  4. description_fetched_callback is invoked once for each fetch.
+ *
+ * @param lssdp
+ * @param read_fds  NULL is none
+ * @param write_fds NULL is none
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_event_process(lssdp_ctx * lssdp, const fd_set * read_fds, const fd_set * write_fds);
+
+/*
+ * 29. lssdp_fetch_close
+ *
+ * cancel the waiting and active fetch, and free description cache. description_fetched_callback is not invoked.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_fetch_close(lssdp_ctx * lssdp);
+
+/*
+ * 30. lssdp_http_open
+ *
+ * open HTTP/1.1 description responder, the registered documents are served by lssdp_event_process.
+ *
+ * Note:
+ *  - set header.location.suffix to ":port/path" of the document, so NOTIFY and RESPONSE point at it.
+ *  - GET and HEAD only, keep-alive and pipelined requests are supported, If-None-Match is answered by 304.
+ *  - in-memory document is sent by writev (sendmsg), file document is sent by sendfile.
+ *  - ignore SIGPIPE when file document is served, sendfile to a closed connection raises it.
+ *
+ * @param lssdp
+ * @param port      TCP port, 0 is chosen by system, the listen port is lssdp.http.port
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_http_open(lssdp_ctx * lssdp, unsigned short port);
+
+/*
+ * 31. lssdp_http_add
+ *
+ * register in-memory document, the same path is replaced.
+ *
+ * @param lssdp
+ * @param path          request path, e.g. "/description.xml"
+ * @param content_type  e.g. "text/xml", NULL is not sent
+ * @param data          not copied, it should be valid until replaced or lssdp_http_close
+ * @param data_len
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_http_add(lssdp_ctx * lssdp, const char * path, const char * content_type, const char * data, size_t data_len);
+
+/*
+ * 32. lssdp_http_add_file
+ *
+ * register file document, the file is opened once and sent by sendfile, the same path is replaced.
+ *
+ * @param lssdp
+ * @param path          request path, e.g. "/description.xml"
+ * @param content_type  e.g. "text/xml", NULL is not sent
+ * @param file_path
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_http_add_file(lssdp_ctx * lssdp, const char * path, const char * content_type, const char * file_path);
+
+/*
+ * 33. lssdp_http_close
+ *
+ * close HTTP listen socket and connections, and unregister every document.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_http_close(lssdp_ctx * lssdp);
+
+/*
+ * 34. lssdp_event_pollfd
+ *
+ * list the same sockets as lssdp_event_fdset as (fd, events) pairs, for poll, epoll, kqueue or io_uring.
+ *
+ * Note:
+ *  - the list is changed by lssdp_event_ready and lssdp_event_process (fetch is started or completed,
+ *    HTTP connection is accepted or closed), list it again before each wait.
+ *  - revents is cleared. At most fds_size entries are written, call again with larger array if the return value is larger.
+ *
+ * @param lssdp
+ * @param fds       NULL is allowed if fds_size is 0
+ * @param fds_size
+ * @return >= 0     the number of sockets of the context
+ *         <  0     failed
+ */
+LSSDP_API int lssdp_event_pollfd(lssdp_ctx * lssdp, struct pollfd * fds, size_t fds_size);
+
+/*
+ * 35. lssdp_event_ready
+ *
+ * process one ready socket which is listed by lssdp_event_pollfd, then the same timeout and fetch queue work as lssdp_event_process.
+ *
+ * Note:
+ *  - call it for each ready fd, and call lssdp_event_process(lssdp, NULL, NULL) when lssdp_next_timeout is due.
+ *  - POLLERR and POLLHUP are processed as readable and writable, so the failure is read by the socket owner.
+ *
+ * @param lssdp
+ * @param fd        < 0 is none
+ * @param revents   POLLIN, POLLOUT, POLLERR, POLLHUP
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_event_ready(lssdp_ctx * lssdp, int fd, short revents);
+
+/*
+ * 36. lssdp_self_address_clear
+ *
+ * remove every address of self address set and free it, the interface addresses are added again by lssdp_network_interface_update.
+ *
+ * @param lssdp
+ * @return = 0      success
+ *         < 0      failed
+ */
+LSSDP_API int lssdp_self_address_clear(lssdp_ctx * lssdp);
+
+/*
+ * 37. lssdp_search_result_header
+ *
+ * get extra header value of search result, the same as lssdp_neighbor_header.
+ *
+ * @param result
+ * @param index     returned by lssdp_header_interest_add
+ * @return value    NUL terminated string, valid in search callback only
+ *         NULL     header is absent
+ */
+LSSDP_API const char * lssdp_search_result_header(const lssdp_search_result * result, int index);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
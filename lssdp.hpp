@@ -0,0 +1,944 @@
+#ifndef __LSSDP_HPP
+#define __LSSDP_HPP
+
+#include <cstddef>      // size_t
+#include <cstring>      // std::memcpy
+#include <functional>   // std::function
+#include <iterator>     // std::forward_iterator_tag
+#include <string_view>  // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <utility>      // std::exchange, std::move
+#if __cplusplus >= 202002L
+#include <coroutine>    // std::coroutine_handle
+#include <deque>        // std::deque
+#include <optional>     // std::optional
+#include <vector>       // std::vector
+#endif
+#include "lssdp.h"
+
+/* lssdp.hpp
+ *
+ * header-only C++17 wrapper of lssdp.h
+ *
+ * 1. lssdp::Context owns a heap allocated lssdp_ctx, the address of lssdp_ctx never changes when Context is moved
+ *    - lssdp_ctx.user_data is the owner Context, do not change it
+ * 2. Context is move-only, SSDP socket, neighbor list and capture file are released by destructor
+ * 3. callbacks are std::function, any lambda can be registered
+ *    - callbacks are invoked from the frames of lssdp.c, an exception must not escape a callback:
+ *      the trampolines are noexcept, so an escaping exception (or bad_alloc of the wrapper) calls std::terminate
+ *      before it unwinds through C code, catch it in the callback
+ * 4. neighbor and interface are read by string_view and range accessors, nothing is copied
+ *
+ * Every member function is an inline call of the C API with the same return value (= 0 success, < 0 failed).
+ * A moved-from Context can only be destroyed or assigned.
+ *
+ * Static packet template of a fixed service profile is built at compile time, see StaticTemplate.
+ *
+ * C++20: Context::next_change, Context::search and Context::search_stream are awaitables, see "Coroutine" below.
+ */
+namespace lssdp {
+
+// contiguous read-only range, the C++17 subset of std::span
+template <class T>
+class Span {
+public:
+    constexpr Span(T * data, size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr T *    begin() const noexcept { return data_; }
+    constexpr T *    end()   const noexcept { return data_ + size_; }
+    constexpr size_t size()  const noexcept { return size_; }
+    constexpr bool   empty() const noexcept { return size_ == 0; }
+    constexpr T &    operator[](size_t i) const noexcept { return data_[i]; }
+
+private:
+    T *     data_;
+    size_t  size_;
+};
+
+// read-only view of lssdp_nbr
+class Neighbor {
+public:
+    explicit Neighbor(const lssdp_nbr * nbr) noexcept : nbr_(nbr) {}
+
+    std::string_view usn()          const noexcept { return nbr_->usn; }
+    std::string_view location()     const noexcept { return nbr_->location; }
+    std::string_view st()           const noexcept { return nbr_->st; }
+    std::string_view sm_id()        const noexcept { return nbr_->sm_id; }
+    std::string_view device_type()  const noexcept { return nbr_->device_type; }
+    long             boot_id()      const noexcept { return nbr_->boot_id; }
+    long             config_id()    const noexcept { return nbr_->config_id; }
+    long long        update_time()  const noexcept { return nbr_->update_time; }
+    uint32_t         address()      const noexcept { return nbr_->addr; }
+    const lssdp_nbr * get()         const noexcept { return nbr_; }
+
+    /* (interface, location) paths, location() and address() are of the first path */
+    Span<const lssdp_nbr_path> paths() const noexcept { return Span<const lssdp_nbr_path>(nbr_->path, nbr_->path_num); }
+
+    /* extra header of Context::header_interest index, empty if absent */
+    std::string_view header(int index) const noexcept {
+        const char * value = lssdp_neighbor_header(nbr_, index);
+        return value != nullptr ? std::string_view(value, nbr_->extra[index].len) : std::string_view();
+    }
+
+private:
+    const lssdp_nbr * nbr_;
+};
+
+#if __cplusplus >= 202002L
+// owned copy of lssdp_nbr, it is still valid after the neighbor is removed from neighbor list
+class NeighborValue {
+public:
+    // paths and extra header values are allocated out of line, they are copied too
+    explicit NeighborValue(const lssdp_nbr * nbr) : nbr_(*nbr), path_(nbr->path, nbr->path + nbr->path_num) {
+        arena_ = copy_arena(nbr->extra, nbr->extra_arena);
+        nbr_.next      = nullptr;
+        nbr_.prev      = nullptr;
+        nbr_.hash_next = nullptr;
+        rebind();
+    }
+
+    // search result is a neighbor without paths
+    explicit NeighborValue(const lssdp_search_result * result) : nbr_{} {
+        std::memcpy(nbr_.usn,         result->usn,         sizeof(nbr_.usn));
+        std::memcpy(nbr_.location,    result->location,    sizeof(nbr_.location));
+        std::memcpy(nbr_.st,          result->st,          sizeof(nbr_.st));
+        std::memcpy(nbr_.sm_id,       result->sm_id,       sizeof(nbr_.sm_id));
+        std::memcpy(nbr_.device_type, result->device_type, sizeof(nbr_.device_type));
+        std::memcpy(nbr_.extra,       result->extra,       sizeof(nbr_.extra));
+        nbr_.boot_id     = result->boot_id;
+        nbr_.config_id   = result->config_id;
+        nbr_.update_time = result->update_time;
+        nbr_.addr        = result->addr;
+        arena_ = copy_arena(result->extra, result->extra_arena);
+        rebind();
+    }
+
+    NeighborValue(const NeighborValue & other) : nbr_(other.nbr_), path_(other.path_), arena_(other.arena_) { rebind(); }
+    NeighborValue(NeighborValue && other) noexcept : nbr_(other.nbr_), path_(std::move(other.path_)), arena_(std::move(other.arena_)) { rebind(); }
+    NeighborValue & operator=(NeighborValue other) noexcept {
+        nbr_   = other.nbr_;
+        path_  = std::move(other.path_);
+        arena_ = std::move(other.arena_);
+        rebind();
+        return *this;
+    }
+
+    Neighbor          view() const noexcept { return Neighbor(&nbr_); }
+    const lssdp_nbr * get()  const noexcept { return &nbr_; }
+
+private:
+    static std::vector<char> copy_arena(const lssdp_extra_header * extra, const char * extra_arena) {
+        size_t arena_len = 0;
+        for (size_t i = 0; i < LSSDP_HEADER_INTEREST_NUM; i++) {
+            if (extra[i].len > 0 && extra[i].offset + extra[i].len + 1u > arena_len) {
+                arena_len = extra[i].offset + extra[i].len + 1u;
+            }
+        }
+        return arena_len > 0 ? std::vector<char>(extra_arena, extra_arena + arena_len) : std::vector<char>();
+    }
+
+    void rebind() noexcept {
+        nbr_.path        = path_.empty()  ? nullptr : path_.data();
+        nbr_.extra_arena = arena_.empty() ? nullptr : arena_.data();
+    }
+
+    lssdp_nbr                   nbr_;
+    std::vector<lssdp_nbr_path> path_;
+    std::vector<char>           arena_;
+};
+
+// neighbor delta of Context::next_change
+struct NeighborChange {
+    int             event;      // LSSDP_NEIGHBOR_EVENT
+    NeighborValue   nbr;
+};
+#endif
+
+// neighbor list range, ordered by update_time (oldest first)
+class NeighborList {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Neighbor;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = Neighbor;
+
+        explicit iterator(const lssdp_nbr * nbr) noexcept : nbr_(nbr) {}
+        Neighbor   operator*()  const noexcept { return Neighbor(nbr_); }
+        iterator & operator++() noexcept { nbr_ = nbr_->next; return *this; }
+        iterator   operator++(int) noexcept { iterator it = *this; nbr_ = nbr_->next; return it; }
+        bool operator==(const iterator & other) const noexcept { return nbr_ == other.nbr_; }
+        bool operator!=(const iterator & other) const noexcept { return nbr_ != other.nbr_; }
+
+    private:
+        const lssdp_nbr * nbr_;
+    };
+
+    NeighborList(const lssdp_nbr * head, size_t size) noexcept : head_(head), size_(size) {}
+
+    iterator begin() const noexcept { return iterator(head_); }
+    iterator end()   const noexcept { return iterator(nullptr); }
+    size_t   size()  const noexcept { return size_; }
+    bool     empty() const noexcept { return size_ == 0; }
+
+private:
+    const lssdp_nbr * head_;
+    size_t            size_;
+};
+
+// fixed size string built at compile time
+template <size_t N>
+struct StaticString {
+    char data[N + 1] = {};
+    static constexpr size_t size() noexcept { return N; }
+};
+
+namespace detail {
+
+template <class T> struct StringSize;
+template <size_t N> struct StringSize<char[N]>            { static constexpr size_t value = N - 1; };
+template <size_t N> struct StringSize<StaticString<N>>    { static constexpr size_t value = N; };
+
+template <size_t N>
+constexpr void append(char * data, size_t & offset, const char (& part)[N]) noexcept {
+    for (size_t i = 0; i + 1 < N; i++) {
+        data[offset++] = part[i];
+    }
+}
+
+template <size_t N>
+constexpr void append(char * data, size_t & offset, const StaticString<N> & part) noexcept {
+    for (size_t i = 0; i < N; i++) {
+        data[offset++] = part.data[i];
+    }
+}
+
+constexpr size_t digit_num(unsigned long value) noexcept {
+    size_t num = 1;
+    for (; value >= 10; value /= 10) {
+        num++;
+    }
+    return num;
+}
+
+}   // namespace detail
+
+// concatenate string literals and StaticString at compile time
+template <class... T>
+constexpr StaticString<(detail::StringSize<T>::value + ... + 0)> concat(const T & ... part) noexcept {
+    StaticString<(detail::StringSize<T>::value + ... + 0)> result{};
+    size_t offset = 0;
+    (detail::append(result.data, offset, part), ...);
+    return result;
+}
+
+// decimal string of number at compile time
+template <unsigned long Value>
+constexpr StaticString<detail::digit_num(Value)> number_string() noexcept {
+    StaticString<detail::digit_num(Value)> result{};
+    unsigned long value = Value;
+    for (size_t i = result.size(); i > 0; i--) {
+        result.data[i - 1] = (char) ('0' + value % 10);
+        value /= 10;
+    }
+    return result;
+}
+
+/* StaticTemplate
+ *
+ * lssdp_template of a fixed service profile, every static segment is a constexpr string,
+ * so send M-SEARCH, NOTIFY and RESPONSE neither format nor compare header at runtime.
+ *
+ *  struct Profile {
+ *      static constexpr unsigned short port    = 1900;
+ *      static constexpr char search_target[]       = "ST_P2P";
+ *      static constexpr char unique_service_name[] = "f835dd000001";
+ *      static constexpr char location_prefix[]     = "";
+ *      static constexpr char location_suffix[]     = ":5678";
+ *      static constexpr char sm_id[]               = "700000123";
+ *      static constexpr char device_type[]         = "DEV_TYPE";
+ *  };
+ *
+ *  context.profile<Profile>();     // or lssdp_ctx.static_template = &lssdp::StaticTemplate<Profile>::value
+ *
+ * The segments are the same as lssdp builds from header at runtime.
+ */
+template <class Profile>
+struct StaticTemplate {
+    static constexpr auto port          = number_string<Profile::port>();
+
+    static constexpr auto msearch_head  = concat("M-SEARCH * HTTP/1.1\r\nHOST:");
+    static constexpr auto msearch_mid   = concat(":", port, "\r\n"
+                                                 "MAN:\"ssdp:discover\"\r\n"
+                                                 "MX:1\r\n"
+                                                 "ST:");
+    static constexpr auto msearch_tail  = concat("\r\nUSER-AGENT:OS/version product/version\r\n\r\n");
+
+    static constexpr auto notify_head   = concat("NOTIFY * HTTP/1.1\r\n"
+                                                 "HOST:239.255.255.250:", port, "\r\n"
+                                                 "CACHE-CONTROL:max-age=120\r\n"
+                                                 "LOCATION:", Profile::location_prefix);
+    static constexpr auto notify_tail   = concat(Profile::location_suffix, "\r\n"
+                                                 "SERVER:OS/version product/version\r\n"
+                                                 "NT:", Profile::search_target, "\r\n"
+                                                 "NTS:ssdp:alive\r\n"
+                                                 "USN:", Profile::unique_service_name, "\r\n"
+                                                 "SM_ID:", Profile::sm_id, "\r\n"
+                                                 "DEV_TYPE:", Profile::device_type, "\r\n"
+                                                 "\r\n");
+
+    static constexpr auto response_head = concat("HTTP/1.1 200 OK\r\n"
+                                                 "CACHE-CONTROL:max-age=120\r\n"
+                                                 "DATE:\r\n"
+                                                 "EXT:\r\n"
+                                                 "LOCATION:", Profile::location_prefix);
+    static constexpr auto response_mid  = concat(Profile::location_suffix, "\r\n"
+                                                 "SERVER:OS/version product/version\r\n"
+                                                 "ST:");
+    static constexpr auto response_tail = concat("\r\n"
+                                                 "USN:", Profile::unique_service_name, "\r\n"
+                                                 "SM_ID:", Profile::sm_id, "\r\n"
+                                                 "DEV_TYPE:", Profile::device_type, "\r\n"
+                                                 "\r\n");
+
+    static inline const lssdp_template value = {{
+        {msearch_head.data,  msearch_head.size()},      // LSSDP_TEMPLATE_MSEARCH_HEAD
+        {msearch_mid.data,   msearch_mid.size()},       // LSSDP_TEMPLATE_MSEARCH_MID
+        {msearch_tail.data,  msearch_tail.size()},      // LSSDP_TEMPLATE_MSEARCH_TAIL
+        {notify_head.data,   notify_head.size()},       // LSSDP_TEMPLATE_NOTIFY_HEAD
+        {notify_tail.data,   notify_tail.size()},       // LSSDP_TEMPLATE_NOTIFY_TAIL
+        {response_head.data, response_head.size()},     // LSSDP_TEMPLATE_RESPONSE_HEAD
+        {response_mid.data,  response_mid.size()},      // LSSDP_TEMPLATE_RESPONSE_MID
+        {response_tail.data, response_tail.size()}      // LSSDP_TEMPLATE_RESPONSE_TAIL
+    }};
+};
+
+class Context {
+public:
+    using Callback              = std::function<void (Context & context)>;
+    using PacketReceivedCallback = std::function<void (Context & context, std::string_view packet)>;
+    using NeighborEventCallback  = std::function<void (Context & context, int event, Neighbor nbr)>;
+    using SearchCallback         = std::function<void (Context & context, int id, Span<const lssdp_search_result> result)>;
+    using DescriptionCallback    = std::function<void (Context & context, const lssdp_description & description)>;
+
+    Context() : ctx_(new lssdp_ctx{}) {
+        ctx_->user_data = this;
+    }
+
+    explicit Context(unsigned short port) : Context() {
+        ctx_->port = port;
+    }
+
+    ~Context() {
+        release();
+    }
+
+    Context(const Context &) = delete;
+    Context & operator=(const Context &) = delete;
+
+    Context(Context && other) noexcept
+        : ctx_(std::exchange(other.ctx_, nullptr)),
+          neighbor_list_changed_(std::move(other.neighbor_list_changed_)),
+          network_interface_changed_(std::move(other.network_interface_changed_)),
+          packet_received_(std::move(other.packet_received_)),
+          neighbor_event_(std::move(other.neighbor_event_)),
+          description_fetched_(std::move(other.description_fetched_)),
+          search_callbacks_(std::move(other.search_callbacks_))
+#if __cplusplus >= 202002L
+        , change_waiters_(std::move(other.change_waiters_)),
+          search_waiters_(std::move(other.search_waiters_)),
+          search_streams_(std::move(other.search_streams_)),
+          ready_(std::move(other.ready_))
+#endif
+    {
+        if (ctx_ != nullptr) {
+            ctx_->user_data = this;
+        }
+    }
+
+    Context & operator=(Context && other) noexcept {
+        if (this != &other) {
+            release();
+            ctx_                       = std::exchange(other.ctx_, nullptr);
+            neighbor_list_changed_     = std::move(other.neighbor_list_changed_);
+            network_interface_changed_ = std::move(other.network_interface_changed_);
+            packet_received_           = std::move(other.packet_received_);
+            neighbor_event_            = std::move(other.neighbor_event_);
+            description_fetched_       = std::move(other.description_fetched_);
+            search_callbacks_          = std::move(other.search_callbacks_);
+#if __cplusplus >= 202002L
+            change_waiters_            = std::move(other.change_waiters_);
+            search_waiters_            = std::move(other.search_waiters_);
+            search_streams_            = std::move(other.search_streams_);
+            ready_                     = std::move(other.ready_);
+#endif
+            if (ctx_ != nullptr) {
+                ctx_->user_data = this;
+            }
+        }
+        return *this;
+    }
+
+    /* C API access, e.g. transport, rcvbuf, hub */
+    lssdp_ctx *       get()        noexcept { return ctx_; }
+    const lssdp_ctx * get()  const noexcept { return ctx_; }
+    lssdp_ctx *       operator->()       noexcept { return ctx_; }
+    const lssdp_ctx * operator->() const noexcept { return ctx_; }
+
+    /* Configuration */
+    Context & port(unsigned short port)                     noexcept { ctx_->port = port; return *this; }
+    Context & neighbor_timeout(long timeout)                noexcept { ctx_->neighbor_timeout = timeout; return *this; }
+    Context & neighbor_merge(bool merge)                    noexcept { ctx_->neighbor_merge = merge; return *this; }
+    Context & debug(bool debug)                             noexcept { ctx_->debug = debug; return *this; }
+    Context & search_target(std::string_view st)            noexcept { copy(ctx_->header.search_target, st); return *this; }
+    Context & unique_service_name(std::string_view usn)     noexcept { copy(ctx_->header.unique_service_name, usn); return *this; }
+    Context & location_prefix(std::string_view prefix)      noexcept { copy(ctx_->header.location.prefix, prefix); return *this; }
+    Context & location_domain(std::string_view domain)      noexcept { copy(ctx_->header.location.domain, domain); return *this; }
+    Context & location_suffix(std::string_view suffix)      noexcept { copy(ctx_->header.location.suffix, suffix); return *this; }
+    Context & sm_id(std::string_view sm_id)                 noexcept { copy(ctx_->header.sm_id, sm_id); return *this; }
+    Context & device_type(std::string_view device_type)     noexcept { copy(ctx_->header.device_type, device_type); return *this; }
+
+    /* add extra header to interest set, return index of Neighbor::header (< 0 is failed), see lssdp_header_interest_add */
+    int header_interest(std::string_view name) noexcept {
+        char header_name[LSSDP_HEADER_NAME_LEN];
+        if (name.size() >= sizeof(header_name)) {
+            return -1;
+        }
+        copy(header_name, name);
+        return lssdp_header_interest_add(ctx_, header_name);
+    }
+
+    /* port and header of fixed service profile, packets are sent by StaticTemplate<Profile> */
+    template <class Profile>
+    Context & profile() noexcept {
+        ctx_->port = Profile::port;
+        copy(ctx_->header.search_target,        Profile::search_target);
+        copy(ctx_->header.unique_service_name,  Profile::unique_service_name);
+        copy(ctx_->header.location.prefix,      Profile::location_prefix);
+        copy(ctx_->header.location.suffix,      Profile::location_suffix);
+        copy(ctx_->header.sm_id,                Profile::sm_id);
+        copy(ctx_->header.device_type,          Profile::device_type);
+        ctx_->static_template = &StaticTemplate<Profile>::value;
+        return *this;
+    }
+
+    /* Callback */
+    template <class F>
+    Context & on_neighbor_list_changed(F && callback) {
+        neighbor_list_changed_ = std::forward<F>(callback);
+        ctx_->neighbor_list_changed_callback_data = neighbor_list_changed_ ? &Context::neighbor_list_changed : nullptr;
+        return *this;
+    }
+
+    template <class F>
+    Context & on_network_interface_changed(F && callback) {
+        network_interface_changed_ = std::forward<F>(callback);
+        ctx_->network_interface_changed_callback_data = network_interface_changed_ ? &Context::network_interface_changed : nullptr;
+        return *this;
+    }
+
+    template <class F>
+    Context & on_packet_received(F && callback) {
+        packet_received_ = std::forward<F>(callback);
+        ctx_->packet_received_callback_data = packet_received_ ? &Context::packet_received : nullptr;
+        return *this;
+    }
+
+    template <class F>
+    Context & on_neighbor_event(F && callback) {
+        neighbor_event_ = std::forward<F>(callback);
+        update_neighbor_event();
+        return *this;
+    }
+
+    /* fetch LOCATION of added and reconfigured neighbors, driven by event_fdset and event_process, or event_pollfd and event_ready */
+    template <class F>
+    Context & on_description_fetched(F && callback) {
+        description_fetched_ = std::forward<F>(callback);
+        ctx_->description_fetched_callback = description_fetched_ ? &Context::description_fetched : nullptr;
+        return *this;
+    }
+
+    /* Function API */
+    int network_interface_update()          noexcept { return resume(lssdp_network_interface_update(ctx_)); }
+    int socket_create()                     noexcept { return resume(lssdp_socket_create(ctx_)); }
+    int socket_close()                      noexcept { return resume(lssdp_socket_close(ctx_)); }
+    int socket_read()                       noexcept { return resume(lssdp_socket_read(ctx_)); }
+    int send_msearch()                      noexcept { return lssdp_send_msearch(ctx_); }
+    int send_msearch(uint32_t address)      noexcept { return lssdp_send_msearch_unicast(ctx_, address); }
+    int send_notify()                       noexcept { return lssdp_send_notify(ctx_); }
+    int neighbor_check_timeout()            noexcept { return resume(lssdp_neighbor_check_timeout(ctx_)); }
+    int msearch_schedule()                  noexcept { return lssdp_msearch_schedule(ctx_); }
+    int capture_open(const char * path)     noexcept { return lssdp_capture_open(ctx_, path); }
+    int capture_close()                     noexcept { return lssdp_capture_close(ctx_); }
+    int http_open(unsigned short port = 0)  noexcept { return lssdp_http_open(ctx_, port); }
+    int http_close()                        noexcept { return lssdp_http_close(ctx_); }
+
+    /* serve description document by event_fdset and event_process, or event_pollfd and event_ready, data is not copied, see lssdp_http_add */
+    int http_add(const char * path, const char * content_type, std::string_view data) noexcept {
+        return lssdp_http_add(ctx_, path, content_type, data.data(), data.size());
+    }
+    int http_add_file(const char * path, const char * content_type, const char * file_path) noexcept {
+        return lssdp_http_add_file(ctx_, path, content_type, file_path);
+    }
+
+    /* start search session, callback is invoked by process_timeout, return session id (> 0), see lssdp_search_start */
+    template <class F>
+    int search(std::string_view st, long timeout, F && callback) {
+        char search_target[LSSDP_FIELD_LEN];
+        copy(search_target, st);
+        int id = lssdp_search_start(ctx_, search_target, timeout, &Context::search_completed, nullptr);
+        if (id > 0) {
+            search_callbacks_[id] = SearchCallback(std::forward<F>(callback));
+        }
+        return id;
+    }
+
+    int search_cancel(int id) {
+        search_callbacks_.erase(id);
+        return lssdp_search_cancel(ctx_, id);
+    }
+
+    /* milliseconds until process_timeout should be called (0 is due, -1 is nothing scheduled), see lssdp_next_timeout */
+    long next_timeout() noexcept { return lssdp_next_timeout(ctx_); }
+
+    /* run M-SEARCH scheduler (once started by msearch_schedule), neighbor timeout check, search session timeout check,
+     * and fetch and HTTP deadlines. Fetch and HTTP sockets are transferred only by event_process or event_ready. */
+    int process_timeout() noexcept {
+        int ret = 0;
+        if (ctx_->msearch.interval > 0 && lssdp_msearch_schedule(ctx_) != 0) {
+            ret = -1;
+        }
+        if (ctx_->neighbor_timeout > 0 && lssdp_neighbor_check_timeout(ctx_) != 0) {
+            ret = -1;
+        }
+        if (ctx_->search.num > 0 && lssdp_search_check_timeout(ctx_) != 0) {
+            ret = -1;
+        }
+        bool has_event = ctx_->fetch.queue != nullptr || ctx_->fetch.active != nullptr || ctx_->http.connection != nullptr;
+        if (has_event && lssdp_event_process(ctx_, nullptr, nullptr) != 0) {
+            ret = -1;
+        }
+        return resume(ret);
+    }
+
+    /* select: add SSDP socket, fetch and HTTP connections, then process them, see lssdp_event_fdset and lssdp_event_process */
+    int event_fdset(fd_set & read_fds, fd_set & write_fds) noexcept { return lssdp_event_fdset(ctx_, &read_fds, &write_fds); }
+    int event_process(const fd_set & read_fds, const fd_set & write_fds) noexcept { return resume(lssdp_event_process(ctx_, &read_fds, &write_fds)); }
+
+    /* poll, epoll or io_uring: list (fd, events), then process each ready fd, see lssdp_event_pollfd and lssdp_event_ready */
+    int event_pollfd(pollfd * fds, size_t size) noexcept { return lssdp_event_pollfd(ctx_, fds, size); }
+    int event_ready(int fd, short revents) noexcept { return resume(lssdp_event_ready(ctx_, fd, revents)); }
+
+#if __cplusplus >= 202002L
+    /* Coroutine
+     *
+     * The awaitables do not depend on any executor. The thread which drives this Context resumes them
+     * at the end of socket_read, process_timeout (and the other calls which change neighbor list):
+     *  - wait sock() readable, then call socket_read()
+     *  - wait next_timeout() milliseconds, then call process_timeout()
+     * so epoll, io_uring or asio can drive thousands of awaiting coroutines with one thread.
+     * With description fetcher or responder, wait every fd of event_pollfd() instead of sock(), then call event_ready(fd, revents).
+     *
+     * A pending awaitable is never resumed after Context is destroyed.
+     */
+    class ChangeAwaiter {
+    public:
+        explicit ChangeAwaiter(lssdp_ctx * lssdp) noexcept : lssdp_(lssdp) {}
+        ChangeAwaiter(const ChangeAwaiter &) = delete;
+        ChangeAwaiter & operator=(const ChangeAwaiter &) = delete;
+        ~ChangeAwaiter() { cancel(); }
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            Context & context = owner(lssdp_);
+            context.change_waiters_.push_back(this);
+            context.update_neighbor_event();
+        }
+        std::vector<NeighborChange> await_resume() noexcept { return std::move(changes_); }
+
+    private:
+        friend class Context;
+
+        void cancel() noexcept {
+            if (lssdp_ != nullptr && handle_) {
+                Context & context = owner(lssdp_);
+                context.detach(context.change_waiters_, this);
+            }
+            lssdp_ = nullptr;
+        }
+
+        lssdp_ctx *                 lssdp_;
+        std::coroutine_handle<>     handle_;
+        std::vector<NeighborChange> changes_;
+    };
+
+    class SearchAwaiter {
+    public:
+        SearchAwaiter(lssdp_ctx * lssdp, std::string_view st, long timeout) noexcept : lssdp_(lssdp), timeout_(timeout) {
+            copy(st_, st);
+        }
+        SearchAwaiter(const SearchAwaiter &) = delete;
+        SearchAwaiter & operator=(const SearchAwaiter &) = delete;
+        ~SearchAwaiter() { cancel(); }
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            Context & context = owner(lssdp_);
+            id_ = context.search(st_, timeout_, [this](Context & context, int, Span<const lssdp_search_result> result) {
+                for (const lssdp_search_result & response : result) {
+                    neighbors_.emplace_back(&response);
+                }
+                id_ = 0;
+                context.detach(context.search_waiters_, this);
+                context.ready_.push_back(handle_);
+            });
+
+            // search session is not started, resume now with empty result
+            if (id_ <= 0) {
+                return false;
+            }
+            context.search_waiters_.push_back(this);
+            return true;
+        }
+        std::vector<NeighborValue> await_resume() noexcept { return std::move(neighbors_); }
+
+    private:
+        friend class Context;
+
+        void cancel() {
+            if (lssdp_ != nullptr && id_ > 0) {
+                Context & context = owner(lssdp_);
+                context.detach(context.search_waiters_, this);
+                context.search_cancel(id_);
+            }
+            lssdp_ = nullptr;
+        }
+
+        lssdp_ctx *                 lssdp_;
+        char                        st_[LSSDP_FIELD_LEN];
+        long                        timeout_;
+        int                         id_ = 0;
+        std::coroutine_handle<>     handle_;
+        std::vector<NeighborValue>  neighbors_;
+    };
+
+    /* stream of search session: co_await next() resumes per new neighbor (USN and location) of RESPONSE,
+     * as soon as the call which receives it returns, and std::nullopt after the session is completed.
+     * A RESPONSE of a neighbor which is already streamed is not streamed again.
+     *
+     *     lssdp::Context::SearchStream stream = context.search_stream("ST_P2P", 2000);
+     *     while (std::optional<lssdp::NeighborValue> nbr = co_await stream.next()) { ... }
+     *
+     * The session is started by the first next(), and cancelled when the stream is destroyed.
+     */
+    class SearchStream {
+    public:
+        class NextAwaiter {
+        public:
+            explicit NextAwaiter(SearchStream & stream) noexcept : stream_(stream) {}
+
+            bool await_ready() const noexcept { return !stream_.pending_.empty() || stream_.id_ <= 0; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { stream_.handle_ = handle; }
+            std::optional<NeighborValue> await_resume() {
+                if (stream_.pending_.empty()) {
+                    return std::nullopt;
+                }
+                NeighborValue nbr = std::move(stream_.pending_.front());
+                stream_.pending_.pop_front();
+                return nbr;
+            }
+
+        private:
+            SearchStream & stream_;
+        };
+
+        SearchStream(lssdp_ctx * lssdp, std::string_view st, long timeout) noexcept : lssdp_(lssdp), timeout_(timeout) {
+            copy(st_, st);
+        }
+        SearchStream(const SearchStream &) = delete;
+        SearchStream & operator=(const SearchStream &) = delete;
+        ~SearchStream() { cancel(); }
+
+        NextAwaiter next() {
+            if (!is_started_ && lssdp_ != nullptr) {
+                start();
+            }
+            return NextAwaiter(*this);
+        }
+
+    private:
+        friend class Context;
+
+        void start() {
+            is_started_ = true;
+            Context & context = owner(lssdp_);
+            id_ = context.search(st_, timeout_, [this](Context & context, int, Span<const lssdp_search_result> result) {
+                for (size_t i = streamed_; i < result.size(); i++) {
+                    pending_.emplace_back(&result[i]);
+                }
+                streamed_ = result.size();
+                id_ = 0;
+                context.detach(context.search_streams_, this);
+                if (handle_) {
+                    context.ready_.push_back(std::exchange(handle_, nullptr));
+                }
+            });
+            if (id_ > 0) {
+                context.search_streams_.push_back(this);
+            }
+        }
+
+        // queue the results which are added since the last collect
+        void collect(const lssdp_ctx * lssdp) {
+            for (const lssdp_search * search = lssdp->search.list; search != nullptr; search = search->next) {
+                if (search->id != id_) {
+                    continue;
+                }
+                for (size_t i = streamed_; i < search->result_num; i++) {
+                    pending_.emplace_back(&search->result[i]);
+                }
+                streamed_ = search->result_num;
+                break;
+            }
+        }
+
+        void cancel() {
+            if (lssdp_ != nullptr && id_ > 0) {
+                Context & context = owner(lssdp_);
+                context.detach(context.search_streams_, this);
+                context.search_cancel(id_);
+            }
+            lssdp_  = nullptr;
+            id_     = 0;
+            handle_ = nullptr;
+        }
+
+        lssdp_ctx *                 lssdp_;
+        char                        st_[LSSDP_FIELD_LEN];
+        long                        timeout_;
+        int                         id_ = 0;
+        bool                        is_started_ = false;
+        size_t                      streamed_ = 0;          // results which are queued
+        std::coroutine_handle<>     handle_;
+        std::deque<NeighborValue>   pending_;
+    };
+
+    /* co_await: neighbor deltas of the next call which changes neighbor list */
+    ChangeAwaiter next_change() noexcept { return ChangeAwaiter(ctx_); }
+
+    /* stream of search session of st within timeout (milliseconds), see SearchStream */
+    SearchStream search_stream(std::string_view st, long timeout) noexcept { return SearchStream(ctx_, st, timeout); }
+
+    /* co_await: search session of st, every RESPONSE collected within timeout (milliseconds) at once at the deadline,
+     * use search_stream to handle each neighbor as soon as it responds */
+    SearchAwaiter search(std::string_view st, long timeout) noexcept { return SearchAwaiter(ctx_, st, timeout); }
+    SearchAwaiter search(long timeout) noexcept { return SearchAwaiter(ctx_, ctx_->header.search_target, timeout); }
+#endif
+
+    /* Accessor */
+    int                sock()       const noexcept { return ctx_->sock; }
+    const lssdp_stats & stats()     const noexcept { return ctx_->stats; }
+    NeighborList       neighbors()  const noexcept { return NeighborList(ctx_->neighbor_list, ctx_->neighbor_num); }
+    Span<const lssdp_interface> interfaces() const noexcept {
+        return Span<const lssdp_interface>(ctx_->interface, ctx_->interface_num);
+    }
+
+private:
+    static Context & owner(lssdp_ctx * lssdp) noexcept {
+        return *static_cast<Context *>(lssdp->user_data);
+    }
+
+    static int neighbor_list_changed(lssdp_ctx *, const lssdp_nbr *, size_t, void * user_data) noexcept {
+        Context & context = *static_cast<Context *>(user_data);
+        context.neighbor_list_changed_(context);
+        return 0;
+    }
+
+    static int network_interface_changed(lssdp_ctx *, const struct lssdp_interface *, size_t, void * user_data) noexcept {
+        Context & context = *static_cast<Context *>(user_data);
+        context.network_interface_changed_(context);
+        return 0;
+    }
+
+    static int packet_received(lssdp_ctx *, const char * packet, size_t packet_len, uint32_t, const struct lssdp_interface *, void * user_data) noexcept {
+        Context & context = *static_cast<Context *>(user_data);
+        context.packet_received_(context, std::string_view(packet, packet_len));
+        return 0;
+    }
+
+    static void neighbor_event(lssdp_ctx *, int event, const lssdp_nbr * nbr, void * user_data) noexcept {
+        Context & context = *static_cast<Context *>(user_data);
+#if __cplusplus >= 202002L
+        // resumed after the C API returns, neighbor list may be changing now
+        for (ChangeAwaiter * waiter : context.change_waiters_) {
+            waiter->changes_.push_back(NeighborChange{event, NeighborValue(nbr)});
+        }
+#endif
+        if (context.neighbor_event_) {
+            context.neighbor_event_(context, event, Neighbor(nbr));
+        }
+    }
+
+    void update_neighbor_event() noexcept {
+        bool enable = static_cast<bool>(neighbor_event_);
+#if __cplusplus >= 202002L
+        enable = enable || !change_waiters_.empty();
+#endif
+        ctx_->neighbor_event_callback = enable ? &Context::neighbor_event : nullptr;
+    }
+
+    static void description_fetched(lssdp_ctx *, const lssdp_description * description, void * user_data) noexcept {
+        Context & context = *static_cast<Context *>(user_data);
+        context.description_fetched_(context, *description);
+    }
+
+    static void search_completed(lssdp_ctx * lssdp, const lssdp_search * search, void *) noexcept {
+        Context & context = owner(lssdp);
+        auto it = context.search_callbacks_.find(search->id);
+        if (it == context.search_callbacks_.end()) {
+            return;
+        }
+
+        SearchCallback callback = std::move(it->second);
+        context.search_callbacks_.erase(it);
+        callback(context, search->id, Span<const lssdp_search_result>(search->result, search->result_num));
+    }
+
+#if __cplusplus >= 202002L
+    template <class T>
+    static void detach(std::vector<T *> & waiters, T * waiter) noexcept {
+        for (size_t i = 0; i < waiters.size(); i++) {
+            if (waiters[i] == waiter) {
+                waiters.erase(waiters.begin() + i);
+                break;
+            }
+        }
+    }
+
+    // resume the awaiting coroutines whose result is ready, and return ret
+    int resume(int ret) {
+        if (ctx_ == nullptr) {
+            return ret;
+        }
+
+        // 1. detach ready awaiters first, the resumed coroutine may await again
+        std::vector<std::coroutine_handle<>> ready = std::move(ready_);
+        ready_.clear();
+        for (SearchStream * stream : search_streams_) {
+            stream->collect(ctx_);
+            if (stream->handle_ && !stream->pending_.empty()) {
+                ready.push_back(std::exchange(stream->handle_, nullptr));
+            }
+        }
+        for (size_t i = 0; i < change_waiters_.size();) {
+            ChangeAwaiter * waiter = change_waiters_[i];
+            if (waiter->changes_.empty()) {
+                i++;
+                continue;
+            }
+            waiter->lssdp_ = nullptr;
+            ready.push_back(waiter->handle_);
+            change_waiters_.erase(change_waiters_.begin() + i);
+        }
+        update_neighbor_event();
+
+        // 2. resume
+        for (std::coroutine_handle<> handle : ready) {
+            handle.resume();
+        }
+        return ret;
+    }
+#else
+    int resume(int ret) noexcept { return ret; }
+#endif
+
+    template <size_t N>
+    static void copy(char (& field)[N], std::string_view value) noexcept {
+        size_t len = value.size() < N - 1 ? value.size() : N - 1;
+        value.copy(field, len);
+        field[len] = '\0';
+    }
+
+    void release() noexcept {
+        if (ctx_ == nullptr) {
+            return;
+        }
+
+#if __cplusplus >= 202002L
+        // pending awaitables are never resumed
+        for (ChangeAwaiter * waiter : change_waiters_) {
+            waiter->lssdp_ = nullptr;
+        }
+        for (SearchAwaiter * waiter : search_waiters_) {
+            waiter->lssdp_ = nullptr;
+        }
+        for (SearchStream * stream : search_streams_) {
+            stream->lssdp_ = nullptr;
+            stream->id_    = 0;
+        }
+        change_waiters_.clear();
+        search_waiters_.clear();
+        search_streams_.clear();
+        ready_.clear();
+        ctx_->neighbor_event_callback = neighbor_event_ ? &Context::neighbor_event : nullptr;
+#endif
+
+        // neighbor list is cleaned up with socket, the hub keeps a pointer of lssdp_ctx until it is removed
+        if (ctx_->hub != nullptr) {
+            lssdp_hub_remove(ctx_->hub, ctx_);
+        } else if (ctx_->sock > 0) {
+            lssdp_socket_close(ctx_);
+        }
+        lssdp_capture_close(ctx_);
+        lssdp_search_cancel(ctx_, 0);
+        lssdp_fetch_close(ctx_);
+        lssdp_http_close(ctx_);
+        lssdp_self_address_clear(ctx_);
+        search_callbacks_.clear();
+        delete ctx_;
+        ctx_ = nullptr;
+    }
+
+    lssdp_ctx *             ctx_;
+    Callback                neighbor_list_changed_;
+    Callback                network_interface_changed_;
+    PacketReceivedCallback  packet_received_;
+    NeighborEventCallback   neighbor_event_;
+    DescriptionCallback     description_fetched_;
+    std::unordered_map<int, SearchCallback> search_callbacks_;
+#if __cplusplus >= 202002L
+    std::vector<ChangeAwaiter *>            change_waiters_;
+    std::vector<SearchAwaiter *>            search_waiters_;
+    std::vector<SearchStream *>             search_streams_;
+    std::vector<std::coroutine_handle<>>    ready_;             // completed search awaiters
+#endif
+};
+
+/* log callback of all contexts, see lssdp_set_log_callback, it must not throw as the callbacks of Context */
+using LogCallback = std::function<void (int level, std::string_view func, std::string_view message)>;
+
+inline LogCallback & log_callback() {
+    static LogCallback callback;
+    return callback;
+}
+
+inline void set_log_callback(LogCallback callback) {
+    log_callback() = std::move(callback);
+    if (!log_callback()) {
+        lssdp_set_log_callback(nullptr);
+        return;
+    }
+
+    lssdp_set_log_callback_data([](const char *, const char *, int level, int, const char * func, const char * message, void * user_data) noexcept {
+        (*static_cast<LogCallback *>(user_data))(level, func, message);
+    }, &log_callback());
+}
+
+}   // namespace lssdp
+
+#endif
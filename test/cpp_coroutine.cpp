@@ -0,0 +1,142 @@
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>    // std::terminate
+#include "lssdp.hpp"
+extern "C" {
+#include "fabric.h"
+}
+
+/* cpp_coroutine.cpp
+ *
+ * C++20 awaitables of lssdp.hpp on in-memory fabric
+ *
+ * 1. attach 3 lssdp::Context to the fabric with 20 ms latency
+ * 2. coroutine watch: co_await next_change() of node-1, show neighbor deltas
+ * 3. coroutine discover: co_await search(2000) of node-1 periodically, show search result
+ *    coroutine stream: co_await search_stream(2000).next() of node-1, each neighbor is resumed before the deadline
+ * 4. node-1 runs M-SEARCH scheduler, node-3 leaves at 3 seconds
+ * 5. event loop is the only driver: read readable node, call process_timeout when next_timeout is due
+ */
+
+#define NODE_NUM    3
+
+// fire-and-forget coroutine, started immediately and destroyed when it returns
+struct Task {
+    struct promise_type {
+        Task                get_return_object() noexcept { return {}; }
+        std::suspend_never  initial_suspend() noexcept { return {}; }
+        std::suspend_never  final_suspend() noexcept { return {}; }
+        void                return_void() noexcept {}
+        void                unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+static const char * event_name(int event) {
+    switch (event) {
+        case LSSDP_NEIGHBOR_ADDED:          return "added";
+        case LSSDP_NEIGHBOR_UPDATED:        return "updated";
+        case LSSDP_NEIGHBOR_REMOVED:        return "removed";
+        case LSSDP_NEIGHBOR_REBOOTED:       return "rebooted";
+        case LSSDP_NEIGHBOR_CONFIG_CHANGED: return "config";
+    }
+    return "unknown";
+}
+
+static Task watch(lssdp::Context & context, fabric * fab) {
+    // neighbor list is cleaned up by socket_close, it is the last change
+    while (context.sock() > 0) {
+        for (const lssdp::NeighborChange & change : co_await context.next_change()) {
+            lssdp::Neighbor nbr = change.nbr.view();
+            std::printf("[%5lld ms] %-7s usn = %.*s, location = %.*s\n",
+                fabric_now(fab), event_name(change.event),
+                (int) nbr.usn().size(), nbr.usn().data(),
+                (int) nbr.location().size(), nbr.location().data()
+            );
+        }
+    }
+}
+
+static Task discover(lssdp::Context & context, fabric * fab, int round) {
+    for (int i = 0; i < round; i++) {
+        std::vector<lssdp::NeighborValue> result = co_await context.search("ST_P2P", 2000);
+        std::printf("[%5lld ms] search %d found %zu neighbors\n", fabric_now(fab), i + 1, result.size());
+    }
+}
+
+static Task stream(lssdp::Context & context, fabric * fab, size_t * found) {
+    lssdp::Context::SearchStream search = context.search_stream("ST_P2P", 2000);
+    long long start_time = fabric_now(fab);
+    while (std::optional<lssdp::NeighborValue> nbr = co_await search.next()) {
+        std::string_view usn = nbr->view().usn();
+        std::printf("[%5lld ms] stream found usn = %.*s\n", fabric_now(fab), (int) usn.size(), usn.data());
+        if (fabric_now(fab) - start_time < 2000) {
+            (*found)++;
+        }
+    }
+    std::printf("[%5lld ms] stream completed\n", fabric_now(fab));
+}
+
+int main() {
+    fabric * fab = fabric_create(NODE_NUM, 20, 0.0, 1);
+    if (fab == NULL) {
+        std::puts("fabric create failed");
+        return EXIT_FAILURE;
+    }
+
+    lssdp::Context node[NODE_NUM];
+    for (int i = 0; i < NODE_NUM; i++) {
+        char usn[LSSDP_FIELD_LEN];
+        std::snprintf(usn, sizeof(usn), "node-%d", i + 1);
+
+        node[i].port(1900)
+               .neighbor_timeout(5000)
+               .search_target("ST_P2P")
+               .unique_service_name(usn)
+               .location_suffix(":5678");
+        node[i].on_network_interface_changed([](lssdp::Context & context) {
+            context.socket_create();
+        });
+
+        if (fabric_node_add(fab, node[i].get()) < 0) {
+            std::puts("fabric add node failed");
+            return EXIT_FAILURE;
+        }
+        node[i].network_interface_update();
+    }
+
+    watch(node[0], fab);
+    discover(node[0], fab, 3);
+    size_t found = 0;
+    stream(node[0], fab, &found);
+    node[0].msearch_schedule();     // start M-SEARCH scheduler, then it is run by process_timeout
+
+    int node_num = NODE_NUM;
+    while (fabric_now(fab) < 12000) {
+        if (node_num == NODE_NUM && fabric_now(fab) >= 3000) {
+            node[--node_num].socket_close();
+        }
+
+        for (int i = 0; i < node_num; i++) {
+            while (fabric_node_readable(node[i].get())) {
+                node[i].socket_read();
+            }
+            if (node[i].next_timeout() == 0) {
+                node[i].process_timeout();
+            }
+        }
+        fabric_advance(fab, 10);
+    }
+
+    for (int i = 0; i < node_num; i++) {
+        node[i].socket_close();
+    }
+    fabric_destroy(fab);
+
+    // the other nodes respond within the latency, each one is streamed before the deadline
+    if (found != NODE_NUM - 1) {
+        std::printf("stream found %zu neighbors before the deadline, expected %d\n", found, NODE_NUM - 1);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sys/select.h> // select
+#include <sys/time.h>   // gettimeofday
+#include "lssdp.hpp"
+
+/* cpp_daemon.cpp
+ *
+ * daemon.c with C++ wrapper lssdp.hpp
+ *
+ * 1. lssdp::Context owns SSDP socket and neighbor list, callbacks are lambdas
+ * 2. select SSDP socket with timeout 0.5 seconds, read when readable
+ * 3. send M-SEARCH by scheduler
+ * 4. per 5 seconds: update network interface, send NOTIFY, check neighbor timeout
+ */
+
+static long long get_current_time() {
+    struct timeval time = {};
+    gettimeofday(&time, NULL);
+    return (long long) time.tv_sec * 1000 + (long long) time.tv_usec / 1000;
+}
+
+int main() {
+    lssdp::set_log_callback([](int level, std::string_view func, std::string_view message) {
+        if (level >= LSSDP_LOG_WARN) {
+            std::printf("[%.*s] %.*s", (int) func.size(), func.data(), (int) message.size(), message.data());
+        }
+    });
+
+    lssdp::Context lssdp(1900);
+    lssdp.neighbor_timeout(15000)
+         .search_target("ST_P2P")
+         .unique_service_name("f835dd000001")
+         .sm_id("700000123")
+         .device_type("DEV_TYPE")
+         .location_suffix(":5678");
+
+    lssdp.on_neighbor_list_changed([](lssdp::Context & context) {
+        std::printf("\nSSDP List (%zu):\n", context.neighbors().size());
+        int i = 0;
+        for (lssdp::Neighbor nbr : context.neighbors()) {
+            std::printf("%d. usn = %-20.*s, location = %.*s\n",
+                ++i,
+                (int) nbr.usn().size(), nbr.usn().data(),
+                (int) nbr.location().size(), nbr.location().data()
+            );
+        }
+    });
+
+    lssdp.on_network_interface_changed([](lssdp::Context & context) {
+        std::printf("\nNetwork Interface List (%zu):\n", context.interfaces().size());
+        for (const lssdp_interface & interface : context.interfaces()) {
+            std::printf("%-6s: %s\n", interface.name, interface.ip);
+        }
+
+        // re-bind SSDP socket
+        if (context.socket_create() != 0) {
+            std::puts("SSDP create socket failed");
+        }
+    });
+
+    // SSDP socket will be created in network interface changed callback
+    lssdp.network_interface_update();
+
+    long long last_time = get_current_time();
+    for (;;) {
+        fd_set fs;
+        FD_ZERO(&fs);
+        FD_SET(lssdp.sock(), &fs);
+        struct timeval tv = {0, 500 * 1000};   // 500 ms
+
+        int ret = select(lssdp.sock() + 1, &fs, NULL, NULL, &tv);
+        if (ret < 0) {
+            std::printf("select error, ret = %d\n", ret);
+            break;
+        }
+
+        if (ret > 0) {
+            lssdp.socket_read();
+        }
+
+        lssdp.msearch_schedule();
+
+        long long current_time = get_current_time();
+        if (current_time - last_time >= 5000) {
+            lssdp.network_interface_update();
+            lssdp.send_notify();
+            lssdp.neighbor_check_timeout();
+            last_time = current_time;
+        }
+    }
+
+    // socket and neighbor list are released by lssdp::Context
+    return EXIT_SUCCESS;
+}
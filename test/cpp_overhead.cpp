@@ -0,0 +1,186 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "lssdp.hpp"
+extern "C" {
+#include "loopback.h"
+}
+
+/* cpp_overhead.cpp
+ *
+ * compare lssdp::Context with the same calls of C API, the wrapper should cost nothing
+ *
+ * 1. loopback transport: sent packets are not delivered, the received packets are selected by the benchmark,
+ *    each context has its own loopback, so NOTIFY of each context is alternated
+ * 2. the same configuration for C lssdp_ctx and lssdp::Context
+ * 3. benchmark, the best of 10 rounds:
+ *    - send NOTIFY
+ *    - read M-SEARCH (send RESPONSE)
+ *    - read NOTIFY, SM_ID is changed every packet, so neighbor event callback is invoked every packet
+ *    - iterate neighbor list
+ *
+ * Usage: cpp_overhead.exe [count]
+ */
+
+static const char MSEARCH[] =
+    "M-SEARCH * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "MAN:\"ssdp:discover\"\r\n"
+    "MX:1\r\n"
+    "ST:ST_P2P\r\n"
+    "\r\n";
+
+static const char * NOTIFY[2] = {
+    "NOTIFY * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "NT:ST_P2P\r\n"
+    "NTS:ssdp:alive\r\n"
+    "USN:f835dd000002\r\n"
+    "LOCATION:http://192.168.1.100:5678/description.xml\r\n"
+    "SM_ID:700000001\r\n"
+    "\r\n",
+    "NOTIFY * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "NT:ST_P2P\r\n"
+    "NTS:ssdp:alive\r\n"
+    "USN:f835dd000002\r\n"
+    "LOCATION:http://192.168.1.100:5678/description.xml\r\n"
+    "SM_ID:700000002\r\n"
+    "\r\n"
+};
+
+#define ROUND_NUM   10
+
+static size_t event_count = 0;
+
+static void setup(lssdp_ctx * lssdp, loopback * lb) {
+    lssdp->port           = 1900;
+    lssdp->transport      = &loopback_transport;
+    lssdp->transport_data = lb;
+    std::snprintf(lssdp->header.search_target,       LSSDP_FIELD_LEN, "ST_P2P");
+    std::snprintf(lssdp->header.unique_service_name, LSSDP_FIELD_LEN, "f835dd000001");
+    std::snprintf(lssdp->header.location.suffix,     LSSDP_FIELD_LEN, ":5678/description.xml");
+    std::snprintf(lssdp->header.sm_id,               LSSDP_FIELD_LEN, "700000123");
+}
+
+/* received packets of both loopback: M-SEARCH, or NOTIFY alternated */
+static void receive(loopback * lb, bool is_notify) {
+    for (int i = 0; i < 2; i++) {
+        lb[i].datagram[0]     = is_notify ? NOTIFY[0] : MSEARCH;
+        lb[i].datagram[1]     = NOTIFY[1];
+        lb[i].datagram_len[0] = std::strlen(lb[i].datagram[0]);
+        lb[i].datagram_len[1] = std::strlen(lb[i].datagram[1]);
+        lb[i].datagram_num    = is_notify ? 2 : 1;
+    }
+}
+
+/* C API */
+static int c_interface_changed(lssdp_ctx * lssdp) {
+    return lssdp_socket_create(lssdp);
+}
+
+static void c_neighbor_event(lssdp_ctx *, int, const lssdp_nbr *, void *) {
+    event_count++;
+}
+
+template <class F>
+static double benchmark(long count, F && run) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++) {
+        run();
+    }
+    std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+    return time.count() / count;
+}
+
+/* the best of rounds, C and C++ are alternated so both see the same cache and frequency state */
+template <class C, class CPP>
+static void compare(const char * name, long count, C && c_run, CPP && cpp_run) {
+    double c   = 0;
+    double cpp = 0;
+    for (int i = 0; i < ROUND_NUM; i++) {
+        double c_time   = benchmark(count / ROUND_NUM, c_run);
+        double cpp_time = benchmark(count / ROUND_NUM, cpp_run);
+        c   = i == 0 || c_time < c ? c_time : c;
+        cpp = i == 0 || cpp_time < cpp ? cpp_time : cpp;
+    }
+    std::printf("%-16s %10.1f %10.1f %+9.1f%%\n", name, c, cpp, (cpp - c) / c * 100);
+}
+
+int main(int argc, char * argv[]) {
+    long count = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+    loopback lb[2] = {};
+    lssdp_ctx ctx = {};
+    setup(&ctx, &lb[0]);
+    ctx.network_interface_changed_callback = c_interface_changed;
+    ctx.neighbor_event_callback            = c_neighbor_event;
+    lssdp_network_interface_update(&ctx);
+
+    lssdp::Context context;
+    setup(context.get(), &lb[1]);
+    context.on_network_interface_changed([](lssdp::Context & context) {
+        context.socket_create();
+    });
+    context.on_neighbor_event([](lssdp::Context &, int, lssdp::Neighbor) {
+        event_count++;
+    });
+    context.network_interface_update();
+
+    if (ctx.sock <= 0 || context.sock() <= 0) {
+        std::puts("create context failed");
+        return EXIT_FAILURE;
+    }
+
+    // check: the neighbor event callback is invoked for every NOTIFY of both
+    receive(lb, true);
+    lssdp_socket_read(&ctx);
+    context.socket_read();
+    event_count = 0;
+    for (int i = 0; i < 10; i++) {
+        lssdp_socket_read(&ctx);
+        context.socket_read();
+    }
+    if (event_count != 20) {
+        std::printf("neighbor event is not invoked for every NOTIFY (%zu)\n", event_count);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("%-16s %10s %10s %10s\n", "ns/call", "C", "C++", "overhead");
+
+    // 1. send NOTIFY
+    compare("send NOTIFY", count,
+        [&] { lssdp_send_notify(&ctx); },
+        [&] { context.send_notify(); });
+
+    // 2. read M-SEARCH, send RESPONSE
+    receive(lb, false);
+    compare("read M-SEARCH", count,
+        [&] { lssdp_socket_read(&ctx); },
+        [&] { context.socket_read(); });
+
+    // 3. read NOTIFY, neighbor is updated
+    receive(lb, true);
+    compare("read NOTIFY", count,
+        [&] { lssdp_socket_read(&ctx); },
+        [&] { context.socket_read(); });
+
+    // 4. iterate neighbor list
+    volatile size_t len = 0;
+    compare("neighbor list", count,
+        [&] {
+            for (const lssdp_nbr * nbr = ctx.neighbor_list; nbr != NULL; nbr = nbr->next) {
+                len = len + std::strlen(nbr->usn);
+            }
+        },
+        [&] {
+            for (lssdp::Neighbor nbr : context.neighbors()) {
+                len = len + nbr.usn().size();
+            }
+        });
+
+    lssdp_socket_close(&ctx);
+    lssdp_self_address_clear(&ctx);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "lssdp.hpp"
+extern "C" {
+#include "loopback.h"
+}
+
+/* cpp_template.cpp
+ *
+ * compare lssdp::StaticTemplate with the packet template built from header at runtime
+ *
+ * 1. loopback transport: every sent packet is copied to the sent buffer, M-SEARCH is received from 192.168.1.100
+ * 2. check NOTIFY, M-SEARCH and RESPONSE of both templates are the same
+ * 3. benchmark send NOTIFY, send M-SEARCH and read M-SEARCH (send RESPONSE) of both templates, the best of 10 rounds,
+ *    read M-SEARCH is dominated by parsing the M-SEARCH, the template is a small part of it
+ *
+ * Usage: cpp_template.exe [count]
+ */
+
+struct Profile {
+    static constexpr unsigned short port = 1900;
+    static constexpr char search_target[]       = "ST_P2P";
+    static constexpr char unique_service_name[] = "f835dd000001";
+    static constexpr char location_prefix[]     = "http://";
+    static constexpr char location_suffix[]     = ":5678/description.xml";
+    static constexpr char sm_id[]               = "700000123";
+    static constexpr char device_type[]         = "DEV_TYPE";
+};
+
+// compile time check
+static_assert(lssdp::number_string<1900>().size() == 4);
+static_assert(lssdp::StaticTemplate<Profile>::msearch_mid.data[0] == ':');
+static_assert(lssdp::StaticTemplate<Profile>::msearch_mid.data[1] == '1');
+
+static const char MSEARCH[] =
+    "M-SEARCH * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "MAN:\"ssdp:discover\"\r\n"
+    "MX:1\r\n"
+    "ST:ST_P2P\r\n"
+    "USER-AGENT:OS/version product/version\r\n"
+    "\r\n";
+
+static int create_context(lssdp::Context & context, loopback * lb, bool is_static) {
+    lb->datagram[0]     = MSEARCH;
+    lb->datagram_len[0] = sizeof(MSEARCH) - 1;
+    lb->datagram_num    = 1;
+    context.get()->transport      = &loopback_transport;
+    context.get()->transport_data = lb;
+    if (is_static) {
+        context.profile<Profile>();
+    } else {
+        context.port(Profile::port)
+               .search_target(Profile::search_target)
+               .unique_service_name(Profile::unique_service_name)
+               .location_prefix(Profile::location_prefix)
+               .location_suffix(Profile::location_suffix)
+               .sm_id(Profile::sm_id)
+               .device_type(Profile::device_type);
+    }
+
+    context.on_network_interface_changed([](lssdp::Context & context) {
+        context.socket_create();
+    });
+    context.network_interface_update();
+    return context.sock() > 0 ? 0 : -1;
+}
+
+#define ROUND_NUM   10
+
+template <class F>
+static double benchmark(long count, F && send) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; i++) {
+        send();
+    }
+    std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+    return time.count() / count;
+}
+
+/* the best of rounds, runtime and static are alternated so both see the same cache and frequency state */
+template <class R, class S>
+static void compare(const char * name, long count, R && runtime_send, S && static_send) {
+    double runtime = 0;
+    double constant = 0;
+    for (int i = 0; i < ROUND_NUM; i++) {
+        double runtime_time  = benchmark(count / ROUND_NUM, runtime_send);
+        double constant_time = benchmark(count / ROUND_NUM, static_send);
+        runtime  = i == 0 || runtime_time < runtime ? runtime_time : runtime;
+        constant = i == 0 || constant_time < constant ? constant_time : constant;
+    }
+    std::printf("%-22s %12.1f %12.1f\n", name, runtime, constant);
+}
+
+int main(int argc, char * argv[]) {
+    long count = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+    loopback lb[2] = {};
+    lssdp::Context runtime, constant;
+    if (create_context(runtime, &lb[0], false) != 0 || create_context(constant, &lb[1], true) != 0) {
+        std::puts("create context failed");
+        return EXIT_FAILURE;
+    }
+
+    // 1. check packets
+    const char * name[3] = {"NOTIFY", "M-SEARCH", "RESPONSE"};
+    for (int i = 0; i < 3; i++) {
+        std::string packet[2];
+        lssdp::Context * context[2] = {&runtime, &constant};
+        for (int j = 0; j < 2; j++) {
+            if (i == 0) context[j]->send_notify();
+            if (i == 1) context[j]->send_msearch();
+            if (i == 2) context[j]->socket_read();
+            packet[j].assign(lb[j].sent, lb[j].sent_len);
+        }
+
+        if (packet[0].empty() || packet[0] != packet[1]) {
+            std::printf("%s of static template is different:\n%s\n---\n%s\n", name[i], packet[0].c_str(), packet[1].c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    std::puts("static template packets are the same as runtime template");
+
+    // 2. benchmark
+    std::printf("\n%-22s %12s %12s\n", "ns/packet", "runtime", "static");
+    compare("NOTIFY", count,
+        [&] { runtime.send_notify(); },
+        [&] { constant.send_notify(); });
+    compare("M-SEARCH", count,
+        [&] { runtime.send_msearch(); },
+        [&] { constant.send_msearch(); });
+    compare("RESPONSE (parse bound)", count,
+        [&] { runtime.socket_read(); },
+        [&] { constant.socket_read(); });
+    return EXIT_SUCCESS;
+}
@@ -11,15 +11,19 @@
  * 1. create SSDP socket with port 1900
  * 2. select SSDP socket with timeout 0.5 seconds
  *    - when select return value > 0, invoke lssdp_socket_read
- * 3. per 5 seconds do:
+ * 3. send M-SEARCH by scheduler (back off while neighbor list is stable)
+ * 4. per 5 seconds do:
  *    - update network interface
- *    - send M-SEARCH and NOTIFY
+ *    - send NOTIFY
  *    - check neighbor timeout
- * 4. when neighbor list is changed
+ * 5. when neighbor list is changed
  *    - show neighbor list
- * 5. when network interface is changed
+ * 6. when network interface is changed
  *    - show interface list
  *    - re-bind the socket
+ * 7. with argument, received packets are captured into pcap-ng file
+ *
+ * usage: daemon.exe [capture.pcapng]
  */
 
 void log_callback(const char * file, const char * tag, int level, int line, const char * func, const char * message) {
@@ -81,7 +85,7 @@ int show_interface_list_and_rebind_socket(lssdp_ctx * lssdp) {
 }
 
 
-int main() {
+int main(int argc, char * argv[]) {
     lssdp_set_log_callback(log_callback);
 
     lssdp_ctx lssdp = {
@@ -106,6 +110,12 @@ int main() {
      */
     lssdp_network_interface_update(&lssdp);
 
+    // capture received packets
+    if (argc > 1 && lssdp_capture_open(&lssdp, argv[1]) != 0) {
+        printf("open capture file %s failed\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
     long long last_time = get_current_time();
     if (last_time < 0) {
         printf("got invalid timestamp %lld\n", last_time);
@@ -138,12 +148,14 @@ int main() {
             break;
         }
 
+        // send M-SEARCH when scheduler is due
+        lssdp_msearch_schedule(&lssdp);
+
         // doing task per 5 seconds
         if (current_time - last_time >= 5000) {
             lssdp_network_interface_update(&lssdp); // 1. update network interface
-            lssdp_send_msearch(&lssdp);             // 2. send M-SEARCH
-            lssdp_send_notify(&lssdp);              // 3. send NOTIFY
-            lssdp_neighbor_check_timeout(&lssdp);   // 4. check neighbor timeout
+            lssdp_send_notify(&lssdp);              // 2. send NOTIFY
+            lssdp_neighbor_check_timeout(&lssdp);   // 3. check neighbor timeout
 
             last_time = current_time;               // update last_time
         }
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>  // htonl, ntohl, inet_ntop
+#include "fabric.h"
+
+/* fabric.c
+ *
+ * every node has a FIFO queue of datagrams, the payload is shared by all receivers of a multicast.
+ */
+
+#define FABRIC_INTERFACE_NUM    2
+
+static const uint32_t FABRIC_ADDR_BASE[FABRIC_INTERFACE_NUM] = {
+    0x0A000001,                             // vnet0 10.0.0.1
+    0xC0A80001                              // vnet1 192.168.0.1
+};
+
+static const uint32_t FABRIC_NETMASK[FABRIC_INTERFACE_NUM] = {
+    0xFF000000,                             // 255.0.0.0
+    0xFFFF0000                              // 255.255.0.0
+};
+
+typedef struct payload {
+    size_t          refcount;
+    size_t          len;
+    char            data[];
+} payload;
+
+typedef struct datagram {
+    struct datagram * next;
+    long long       deliver_time;
+    uint32_t        addr;                   // source address in network byte order
+    unsigned short  port;                   // source port
+    payload *       payload;
+} datagram;
+
+typedef struct node {
+    fabric *        fab;
+    lssdp_ctx *     lssdp;
+    uint32_t        addr[FABRIC_INTERFACE_NUM]; // network byte order
+    size_t          interface_num;
+    unsigned short  port;                   // 0 if socket is not opened
+    datagram *      head;
+    datagram *      tail;
+} node;
+
+struct fabric {
+    size_t          node_num;
+    size_t          node_max;
+    node *          nodes;
+    long long       now;
+    long            latency;
+    double          loss_rate;
+    unsigned int    seed;
+    fabric_stats    stats;
+};
+
+static int fabric_socket_open(lssdp_ctx * lssdp);
+static int fabric_socket_close(lssdp_ctx * lssdp, int sock);
+static ssize_t fabric_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info);
+static ssize_t fabric_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port);
+static ssize_t fabric_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num);
+static int fabric_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size);
+static long long fabric_transport_now(lssdp_ctx * lssdp);
+
+static const lssdp_transport fabric_transport = {
+    .socket_open    = fabric_socket_open,
+    .socket_close   = fabric_socket_close,
+    .recv           = fabric_recv,
+    .send           = fabric_send,
+    .send_multicast = fabric_send_multicast,
+    .interface_list = fabric_interface_list,
+    .now            = fabric_transport_now
+};
+
+
+fabric * fabric_create(size_t node_max, long latency, double loss_rate, unsigned int seed) {
+    fabric * fab = calloc(1, sizeof(fabric));
+    if (fab == NULL) {
+        return NULL;
+    }
+
+    fab->nodes = calloc(node_max, sizeof(node));
+    if (fab->nodes == NULL) {
+        free(fab);
+        return NULL;
+    }
+
+    fab->node_max  = node_max;
+    fab->latency   = latency;
+    fab->loss_rate = loss_rate;
+    fab->seed      = seed;
+    return fab;
+}
+
+static void node_queue_clear(node * n) {
+    while (n->head != NULL) {
+        datagram * d = n->head;
+        n->head = d->next;
+        if (--d->payload->refcount == 0) {
+            free(d->payload);
+        }
+        free(d);
+    }
+    n->tail = NULL;
+}
+
+void fabric_destroy(fabric * fab) {
+    if (fab == NULL) {
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < fab->node_num; i++) {
+        node_queue_clear(&fab->nodes[i]);
+    }
+    free(fab->nodes);
+    free(fab);
+}
+
+int fabric_node_add(fabric * fab, lssdp_ctx * lssdp) {
+    if (fab == NULL || lssdp == NULL || fab->node_num >= fab->node_max) {
+        return -1;
+    }
+
+    int index = fab->node_num++;
+    node * n = &fab->nodes[index];
+    n->fab   = fab;
+    n->lssdp = lssdp;
+    n->addr[0] = htonl(FABRIC_ADDR_BASE[0] + index);
+    n->interface_num = 1;
+
+    lssdp->transport      = &fabric_transport;
+    lssdp->transport_data = n;
+    return index;
+}
+
+bool fabric_node_readable(lssdp_ctx * lssdp) {
+    node * n = lssdp->transport_data;
+    return n->head != NULL && n->head->deliver_time <= n->fab->now;
+}
+
+int fabric_node_interface_add(lssdp_ctx * lssdp) {
+    node * n = lssdp->transport_data;
+    if (n->interface_num >= FABRIC_INTERFACE_NUM) {
+        return -1;
+    }
+
+    n->addr[n->interface_num] = htonl(FABRIC_ADDR_BASE[n->interface_num] + (n - n->fab->nodes));
+    n->interface_num++;
+    return 0;
+}
+
+int fabric_node_address_set(lssdp_ctx * lssdp, size_t interface, uint32_t addr) {
+    node * n = lssdp->transport_data;
+    if (interface >= n->interface_num || (ntohl(addr) & FABRIC_NETMASK[interface]) != (FABRIC_ADDR_BASE[interface] & FABRIC_NETMASK[interface])) {
+        return -1;
+    }
+
+    n->addr[interface] = addr;
+    return 0;
+}
+
+long long fabric_now(fabric * fab) {
+    return fab->now;
+}
+
+void fabric_advance(fabric * fab, long ms) {
+    fab->now += ms;
+}
+
+fabric_stats fabric_get_stats(fabric * fab) {
+    return fab->stats;
+}
+
+
+/** Internal Function **/
+
+static payload * payload_create(const struct iovec * iov, size_t iov_num) {
+    size_t len = 0;
+    size_t i;
+    for (i = 0; i < iov_num; i++) {
+        len += iov[i].iov_len;
+    }
+
+    payload * p = malloc(sizeof(payload) + len);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->refcount = 0;
+    p->len = 0;
+    for (i = 0; i < iov_num; i++) {
+        memcpy(p->data + p->len, iov[i].iov_base, iov[i].iov_len);
+        p->len += iov[i].iov_len;
+    }
+    return p;
+}
+
+static int deliver(node * from, size_t interface, node * to, payload * p) {
+    fabric * fab = from->fab;
+    if (to->port == 0 || to->port != from->port || interface >= to->interface_num) {
+        return 0;
+    }
+
+    if (fab->loss_rate > 0 && (double) rand_r(&fab->seed) / RAND_MAX < fab->loss_rate) {
+        fab->stats.dropped++;
+        return 0;
+    }
+
+    datagram * d = malloc(sizeof(datagram));
+    if (d == NULL) {
+        return -1;
+    }
+
+    d->next         = NULL;
+    d->deliver_time = fab->now + fab->latency;
+    d->addr         = from->addr[interface];
+    d->port         = from->port;
+    d->payload      = p;
+    p->refcount++;
+
+    if (to->tail != NULL) {
+        to->tail->next = d;
+    } else {
+        to->head = d;
+    }
+    to->tail = d;
+
+    fab->stats.delivered++;
+    fab->stats.bytes += p->len;
+    return 0;
+}
+
+static int fabric_socket_open(lssdp_ctx * lssdp) {
+    node * n = lssdp->transport_data;
+    n->port = lssdp->port;
+    return (int) (n - n->fab->nodes) + 1;
+}
+
+static int fabric_socket_close(lssdp_ctx * lssdp, int sock) {
+    node * n = lssdp->transport_data;
+    n->port = 0;
+    node_queue_clear(n);
+    return 0;
+}
+
+static ssize_t fabric_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info) {
+    node * n = lssdp->transport_data;
+    if (fabric_node_readable(lssdp) == false) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    datagram * d = n->head;
+    n->head = d->next;
+    if (n->head == NULL) {
+        n->tail = NULL;
+    }
+
+    size_t len = d->payload->len < buffer_len ? d->payload->len : buffer_len;
+    memcpy(buffer, d->payload->data, len);
+    info->addr      = d->addr;
+    info->port      = d->port;
+    info->timestamp = d->deliver_time * 1000;
+
+    if (--d->payload->refcount == 0) {
+        free(d->payload);
+    }
+    free(d);
+    return len;
+}
+
+static ssize_t fabric_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port) {
+    node * n = lssdp->transport_data;
+    fabric * fab = n->fab;
+
+    payload * p = payload_create(iov, iov_num);
+    if (p == NULL) {
+        return -1;
+    }
+    fab->stats.sent++;
+
+    // the receiver is found by address, the sender uses its address in the same LAN
+    size_t i, k;
+    for (i = 0; i < fab->node_num; i++) {
+        node * to = &fab->nodes[i];
+        for (k = 0; k < to->interface_num && k < n->interface_num; k++) {
+            if (to->addr[k] == address && to->port == port) {
+                deliver(n, k, to, p);
+            }
+        }
+    }
+
+    ssize_t len = p->len;
+    if (p->refcount == 0) {
+        free(p);
+    }
+    return len;
+}
+
+static ssize_t fabric_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num) {
+    node * n = lssdp->transport_data;
+    fabric * fab = n->fab;
+
+    payload * p = payload_create(iov, iov_num);
+    if (p == NULL) {
+        return -1;
+    }
+    fab->stats.sent++;
+
+    // the sending interface, multicast is delivered in its LAN only
+    size_t k = 0;
+    size_t i;
+    for (i = 0; i < n->interface_num; i++) {
+        if (n->addr[i] == interface->addr) {
+            k = i;
+        }
+    }
+
+    // multicast loop is disabled, skip the sender
+    for (i = 0; i < fab->node_num; i++) {
+        if (&fab->nodes[i] != n) {
+            deliver(n, k, &fab->nodes[i], p);
+        }
+    }
+
+    ssize_t len = p->len;
+    if (p->refcount == 0) {
+        free(p);
+    }
+    return len;
+}
+
+static int fabric_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size) {
+    node * n = lssdp->transport_data;
+    memset(list, 0, sizeof(struct lssdp_interface) * list_size);
+    if (list_size == 0) {
+        return 0;
+    }
+
+    size_t i;
+    for (i = 0; i < n->interface_num && i < list_size; i++) {
+        snprintf(list[i].name, sizeof(list[i].name), "vnet%zu", i);
+        inet_ntop(AF_INET, &n->addr[i], list[i].ip, sizeof(list[i].ip));
+        list[i].addr    = n->addr[i];
+        list[i].netmask = htonl(FABRIC_NETMASK[i]);
+    }
+    return i;
+}
+
+static long long fabric_transport_now(lssdp_ctx * lssdp) {
+    node * n = lssdp->transport_data;
+    return n->fab->now;
+}
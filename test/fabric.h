@@ -0,0 +1,57 @@
+#ifndef __FABRIC_H
+#define __FABRIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lssdp.h"
+
+/* fabric.h
+ *
+ * in-memory multicast fabric, an lssdp_transport without real network.
+ *
+ * 1. every node is a lssdp_ctx with one interface "vnet0" in LAN 10.0.0.0/8,
+ *    a multi-homed node has the second interface "vnet1" in LAN 192.168.0.0/16
+ * 2. multicast is delivered to every other node which has opened SSDP socket on the same port and is in the same LAN
+ * 3. time is virtual, the clock only moves by fabric_advance
+ * 4. each delivery is delayed by latency, and dropped by loss_rate
+ */
+typedef struct fabric fabric;
+
+typedef struct fabric_stats {
+    size_t      sent;                       // datagrams sent (multicast counts once)
+    size_t      delivered;                  // datagrams queued to receivers
+    size_t      dropped;                    // datagrams dropped by loss_rate
+    size_t      bytes;                      // bytes queued to receivers
+} fabric_stats;
+
+fabric *    fabric_create(size_t node_max, long latency, double loss_rate, unsigned int seed);
+void        fabric_destroy(fabric * fab);
+
+/* attach lssdp_ctx to fabric, lssdp.transport and lssdp.transport_data will be set
+ *
+ * @return >= 0     node index
+ *         <  0     failed
+ */
+int         fabric_node_add(fabric * fab, lssdp_ctx * lssdp);
+bool        fabric_node_readable(lssdp_ctx * lssdp);
+
+/* add interface "vnet1" to node, lssdp_network_interface_update should be called after
+ *
+ * @return = 0      success
+ *         < 0      failed
+ */
+int         fabric_node_interface_add(lssdp_ctx * lssdp);
+
+/* change address of node interface (e.g. DHCP renew), lssdp_network_interface_update should be called after
+ *
+ * @param addr      network byte order
+ * @return = 0      success
+ *         < 0      failed
+ */
+int         fabric_node_address_set(lssdp_ctx * lssdp, size_t interface, uint32_t addr);
+
+long long   fabric_now(fabric * fab);
+void        fabric_advance(fabric * fab, long ms);
+fabric_stats fabric_get_stats(fabric * fab);
+
+#endif
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>     // close
+#include <fcntl.h>      // fcntl, O_NONBLOCK
+#include <sys/time.h>   // gettimeofday
+#include <sys/select.h> // select
+#include <poll.h>       // poll
+#include <sys/socket.h> // socket, socketpair, accept, recv, send
+#include <netinet/in.h> // struct sockaddr_in
+#include <arpa/inet.h>  // inet_addr
+#include "lssdp.h"
+#include "loopback.h"
+
+/* fetcher.c
+ *
+ * description fetcher against a local stand-in HTTP server, without SSDP network
+ *
+ * 1. stand-in HTTP server on 127.0.0.1 (ephemeral port):
+ *    - /dev-N.xml with ETag, 304 if If-None-Match is matched
+ *    - /chunked.xml by chunked transfer encoding
+ *    - 404 for the others
+ *    - every response is delayed 50 ms, so the concurrent connections are visible
+ * 2. SSDP socket is a socketpair, NOTIFY packets are written to the other side
+ * 3. event loop: select on lssdp_event_fdset and server sockets, then lssdp_event_process,
+ *    or poll on lssdp_event_pollfd and server sockets, then lssdp_event_ready for each ready fd
+ * 4. check:
+ *    - 10 new neighbors: 10 requests, at most fetch.host_max connections to the same host
+ *    - the same CONFIGID (byebye, then alive): cached, no request
+ *    - CONFIGID is changed: conditional request, 304, at most fetch.connection_max connections
+ *    - chunked body, 404 and connection refused
+ *    - the same fetch driven by poll
+ *
+ * usage: fetcher.exe
+ */
+
+#define CLIENT_MAX      32
+#define POLLFD_MAX      64
+#define SERVER_DELAY    50      // milliseconds
+
+typedef struct server {
+    int         sock;
+    unsigned short port;
+    int         client[CLIENT_MAX];
+    char        request[CLIENT_MAX][1024];
+    size_t      request_len[CLIENT_MAX];
+    long long   accept_time[CLIENT_MAX];
+    size_t      client_num;
+    size_t      peak;           // max concurrent connections
+    size_t      requests;
+    size_t      not_modified;
+} server;
+
+static int pair[2] = {-1, -1};
+static loopback lb;
+static size_t result[4];        // 200, 304, 404, failed
+
+long long get_current_time() {
+    struct timeval time = {};
+    if (gettimeofday(&time, NULL) == -1) {
+        printf("gettimeofday failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    return (long long) time.tv_sec * 1000 + (long long) time.tv_usec / 1000;
+}
+
+/* SSDP transport: loopback of socketpair, packets are from 192.168.1.100 */
+static int pair_socket_open(lssdp_ctx * lssdp) {
+    return pair[0];
+}
+
+static ssize_t pair_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info) {
+    ssize_t len = recv(pair[0], buffer, buffer_len, 0);
+    info->addr = inet_addr("192.168.1.100");
+    info->port = htons(1900);
+    return len;
+}
+
+static long long pair_now(lssdp_ctx * lssdp) {
+    return get_current_time();
+}
+
+static const lssdp_transport pair_transport = {
+    .socket_open    = pair_socket_open,
+    .socket_close   = loopback_socket_close,
+    .recv           = pair_recv,
+    .send           = loopback_send,
+    .send_multicast = loopback_send_multicast,
+    .interface_list = loopback_interface_list,
+    .now            = pair_now
+};
+
+/* stand-in HTTP server */
+static int server_open(server * srv) {
+    memset(srv, 0, sizeof(server));
+    srv->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = inet_addr("127.0.0.1")
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(srv->sock, (struct sockaddr *) &addr, sizeof(addr)) != 0
+            || listen(srv->sock, CLIENT_MAX) != 0
+            || getsockname(srv->sock, (struct sockaddr *) &addr, &addr_len) != 0) {
+        close(srv->sock);
+        return -1;
+    }
+    fcntl(srv->sock, F_SETFL, fcntl(srv->sock, F_GETFL) | O_NONBLOCK);
+    srv->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static int server_fdset(server * srv, fd_set * read_fds, int max_fd) {
+    FD_SET(srv->sock, read_fds);
+    max_fd = srv->sock > max_fd ? srv->sock : max_fd;
+
+    size_t i;
+    for (i = 0; i < srv->client_num; i++) {
+        FD_SET(srv->client[i], read_fds);
+        max_fd = srv->client[i] > max_fd ? srv->client[i] : max_fd;
+    }
+    return max_fd;
+}
+
+static void server_respond(server * srv, size_t i) {
+    char path[256] = {};
+    sscanf(srv->request[i], "GET %255s", path);
+    srv->requests++;
+
+    char response[1024];
+    const char * body_format = "<root><device><UDN>uuid:%s</UDN></device></root>";
+    if (strcmp(path, "/chunked.xml") == 0) {
+        snprintf(response, sizeof(response),
+            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "6\r\n<root>\r\n" "7\r\n</root>\r\n" "0\r\n\r\n");
+    } else if (strncmp(path, "/dev-", 5) == 0) {
+        char etag[64];
+        char body[256];
+        snprintf(etag, sizeof(etag), "\"%s-v1\"", path + 1);
+        snprintf(body, sizeof(body), body_format, path + 1);
+        if (strstr(srv->request[i], etag) != NULL) {
+            srv->not_modified++;
+            snprintf(response, sizeof(response), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", etag);
+        } else {
+            snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nETag: %s\r\nContent-Length: %zu\r\n\r\n%s", etag, strlen(body), body);
+        }
+    } else {
+        snprintf(response, sizeof(response), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+
+    if (send(srv->client[i], response, strlen(response), 0) < 0) {
+        printf("server send failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+    close(srv->client[i]);
+
+    // move the last client to i
+    srv->client_num--;
+    srv->client[i]      = srv->client[srv->client_num];
+    srv->accept_time[i] = srv->accept_time[srv->client_num];
+    srv->request_len[i] = srv->request_len[srv->client_num];
+    memcpy(srv->request[i], srv->request[srv->client_num], sizeof(srv->request[i]));
+}
+
+static void server_process(server * srv, fd_set * read_fds) {
+    long long now = get_current_time();
+
+    // 1. accept
+    if (FD_ISSET(srv->sock, read_fds)) {
+        int client;
+        while (srv->client_num < CLIENT_MAX && (client = accept(srv->sock, NULL, NULL)) >= 0) {
+            fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+            srv->client[srv->client_num]      = client;
+            srv->accept_time[srv->client_num] = now;
+            srv->request_len[srv->client_num] = 0;
+            srv->client_num++;
+        }
+        if (srv->client_num > srv->peak) {
+            srv->peak = srv->client_num;
+        }
+    }
+
+    // 2. read request, respond after delay
+    size_t i = 0;
+    while (i < srv->client_num) {
+        if (FD_ISSET(srv->client[i], read_fds)) {
+            size_t len = srv->request_len[i];
+            ssize_t n = recv(srv->client[i], &srv->request[i][len], sizeof(srv->request[i]) - len - 1, 0);
+            if (n > 0) {
+                srv->request_len[i] += n;
+                srv->request[i][srv->request_len[i]] = '\0';
+            }
+        }
+
+        if (strstr(srv->request[i], "\r\n\r\n") != NULL && now - srv->accept_time[i] >= SERVER_DELAY) {
+            server_respond(srv, i);
+            continue;
+        }
+        i++;
+    }
+}
+
+static void server_close(server * srv) {
+    size_t i;
+    for (i = 0; i < srv->client_num; i++) {
+        close(srv->client[i]);
+    }
+    close(srv->sock);
+}
+
+/* SSDP packet */
+static void send_notify(const char * nts, const char * location, long config_id) {
+    char packet[512];
+    snprintf(packet, sizeof(packet),
+        "NOTIFY * HTTP/1.1\r\n"
+        "HOST:239.255.255.250:1900\r\n"
+        "NT:ST_P2P\r\n"
+        "NTS:%s\r\n"
+        "USN:%s\r\n"
+        "LOCATION:%s\r\n"
+        "CONFIGID.UPNP.ORG:%ld\r\n"
+        "\r\n",
+        nts, strrchr(location, '/') + 1, location, config_id
+    );
+    if (send(pair[1], packet, strlen(packet), 0) < 0) {
+        printf("send packet failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+}
+
+static void send_device(server * srv, const char * nts, const char * name, long config_id) {
+    char location[LSSDP_LOCATION_LEN];
+    snprintf(location, sizeof(location), "http://127.0.0.1:%u/%s", srv->port, name);
+    send_notify(nts, location, config_id);
+}
+
+/* select lssdp and server sockets, then process them */
+static int wait_select(lssdp_ctx * lssdp, server * srv, long timeout) {
+    fd_set read_fds, write_fds;
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    int max_fd = lssdp_event_fdset(lssdp, &read_fds, &write_fds);
+    max_fd = server_fdset(srv, &read_fds, max_fd);
+
+    struct timeval tv = {
+        .tv_sec  = 0,
+        .tv_usec = timeout * 1000
+    };
+    int ret = select(max_fd + 1, &read_fds, &write_fds, NULL, &tv);
+    if (ret < 0) {
+        printf("select error, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    if (ret == 0) {
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+    }
+
+    server_process(srv, &read_fds);
+    lssdp_event_process(lssdp, &read_fds, &write_fds);
+    return 0;
+}
+
+/* poll lssdp and server sockets, then process each ready socket of lssdp and timeout */
+static int wait_poll(lssdp_ctx * lssdp, server * srv, long timeout) {
+    struct pollfd fds[POLLFD_MAX];
+    int lssdp_num = lssdp_event_pollfd(lssdp, fds, POLLFD_MAX);
+    if (lssdp_num < 0 || lssdp_num + 1 + srv->client_num > POLLFD_MAX) {
+        printf("too many sockets (%d)\n", lssdp_num);
+        return -1;
+    }
+
+    size_t n = lssdp_num;
+    fds[n].fd     = srv->sock;
+    fds[n].events = POLLIN;
+    n++;
+    size_t i;
+    for (i = 0; i < srv->client_num; i++, n++) {
+        fds[n].fd     = srv->client[i];
+        fds[n].events = POLLIN;
+    }
+
+    if (poll(fds, n, timeout) < 0) {
+        printf("poll error, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    fd_set server_fds;
+    FD_ZERO(&server_fds);
+    for (i = lssdp_num; i < n; i++) {
+        if (fds[i].revents != 0) {
+            FD_SET(fds[i].fd, &server_fds);
+        }
+    }
+    server_process(srv, &server_fds);
+
+    for (i = 0; i < (size_t) lssdp_num; i++) {
+        if (fds[i].revents != 0) {
+            lssdp_event_ready(lssdp, fds[i].fd, fds[i].revents);
+        }
+    }
+    lssdp_event_process(lssdp, NULL, NULL);
+    return 0;
+}
+
+/* run event loop until every packet is read and every fetch is completed */
+static void run(lssdp_ctx * lssdp, server * srv, bool is_poll) {
+    long long deadline = get_current_time() + 10000;
+    while (get_current_time() < deadline) {
+        // server delay is polled per 10 ms
+        long timeout = lssdp_next_timeout(lssdp);
+        if (timeout < 0 || timeout > 10) {
+            timeout = 10;
+        }
+        int ret = is_poll ? wait_poll(lssdp, srv, timeout) : wait_select(lssdp, srv, timeout);
+        if (ret != 0) {
+            break;
+        }
+
+        // SSDP packets are not read yet
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(pair[0], &fds);
+        struct timeval zero = {};
+        bool is_readable = select(pair[0] + 1, &fds, NULL, NULL, &zero) > 0;
+        if (!is_readable && lssdp->fetch.queue == NULL && lssdp->fetch.active == NULL && srv->client_num == 0) {
+            break;
+        }
+    }
+}
+
+void description_fetched(lssdp_ctx * lssdp, const lssdp_description * description, void * user_data) {
+    printf("  %-40s config %ld, status %d, %zu bytes%s\n",
+        description->location,
+        description->config_id,
+        description->status,
+        description->body_len,
+        description->is_cached ? " (cached)" : ""
+    );
+
+    switch (description->status) {
+        case 200: result[0]++; break;
+        case 304: result[1]++; break;
+        case 404: result[2]++; break;
+        default:  result[3]++; break;
+    }
+
+    if (strstr(description->location, "chunked") != NULL && description->status == 200
+            && strcmp(description->body, "<root></root>") != 0) {
+        printf("  chunked body is not decoded: %s\n", description->body);
+        result[3]++;
+    }
+}
+
+static int check(const char * name, bool is_passed) {
+    printf("%s: %s\n\n", is_passed ? "PASS" : "FAIL", name);
+    return is_passed ? 0 : -1;
+}
+
+int main() {
+    server srv;
+    if (server_open(&srv) != 0) {
+        printf("server open failed, errno = %s (%d)\n", strerror(errno), errno);
+        return EXIT_FAILURE;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) != 0) {
+        printf("socketpair failed, errno = %s (%d)\n", strerror(errno), errno);
+        return EXIT_FAILURE;
+    }
+    fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL) | O_NONBLOCK);
+
+    lssdp_ctx lssdp = {
+        .port           = 1900,
+        .transport      = &pair_transport,
+        .transport_data = &lb,
+        .fetch = {
+            .connection_max = 8,
+            .host_max       = 2
+        },
+        .header = {
+            .search_target = "ST_P2P"
+        },
+        .network_interface_changed_callback = lssdp_socket_create,
+        .description_fetched_callback       = description_fetched
+    };
+    lssdp_network_interface_update(&lssdp);
+
+    int ret = 0;
+    int i;
+    char name[32];
+
+    // 1. 10 new neighbors of the same host
+    printf("stand-in HTTP server 127.0.0.1:%u\n", srv.port);
+    for (i = 1; i <= 10; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:alive", name, 1);
+    }
+    run(&lssdp, &srv, false);
+    printf("requests = %zu, peak connections = %zu\n", srv.requests, srv.peak);
+    ret |= check("new neighbors are fetched, per host limit", result[0] == 10 && srv.requests == 10 && srv.peak <= 2);
+
+    // 2. the same CONFIGID: alive is ignored, byebye then alive is cached
+    for (i = 1; i <= 10; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:alive", name, 1);
+    }
+    for (i = 1; i <= 3; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:byebye", name, 1);
+        send_device(&srv, "ssdp:alive", name, 1);
+    }
+    run(&lssdp, &srv, false);
+    printf("requests = %zu\n", srv.requests);
+    ret |= check("the same CONFIGID is cached", result[1] == 3 && srv.requests == 10);
+
+    // 3. CONFIGID is changed: conditional request
+    lssdp.fetch.connection_max = 3;
+    lssdp.fetch.host_max       = 8;
+    srv.peak = 0;
+    for (i = 1; i <= 6; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:alive", name, 2);
+    }
+    run(&lssdp, &srv, false);
+    printf("requests = %zu, 304 = %zu, peak connections = %zu\n", srv.requests, srv.not_modified, srv.peak);
+    ret |= check("changed CONFIGID is requested conditionally, global limit", result[1] == 9 && srv.not_modified == 6 && srv.peak <= 3);
+
+    // 4. chunked, 404 and connection refused
+    send_device(&srv, "ssdp:alive", "chunked.xml", 1);
+    send_device(&srv, "ssdp:alive", "missing.xml", 1);
+    send_notify("ssdp:alive", "http://127.0.0.1:1/refused.xml", 1);
+    run(&lssdp, &srv, false);
+    ret |= check("chunked, 404 and connection refused", result[0] == 11 && result[2] == 1 && result[3] == 1);
+
+    // 5. poll: changed CONFIGID and new neighbors
+    size_t requests = srv.requests;
+    for (i = 1; i <= 6; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:alive", name, 3);
+    }
+    for (i = 11; i <= 14; i++) {
+        snprintf(name, sizeof(name), "dev-%d.xml", i);
+        send_device(&srv, "ssdp:alive", name, 1);
+    }
+    run(&lssdp, &srv, true);
+    printf("requests = %zu, peak connections = %zu\n", srv.requests - requests, srv.peak);
+    ret |= check("fetch is driven by poll", srv.requests - requests == 10 && result[0] == 15 && result[1] == 15 && srv.peak <= 3);
+
+    lssdp_fetch_close(&lssdp);
+    lssdp_socket_close(&lssdp);
+    lssdp_self_address_clear(&lssdp);
+    server_close(&srv);
+    close(pair[0]);
+    close(pair[1]);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* fuzz_main.c
+ *
+ * standalone driver of LLVMFuzzerTestOneInput, for the build without libFuzzer (gcc, AFL with @@)
+ *
+ * 1. run every file of the arguments, a directory is run file by file (the checked-in corpus),
+ *    stdin is run if no argument
+ * 2. time per byte check of the worst case inputs (file name worst_*, a single datagram),
+ *    input is timed with its half, the first and the last quarters,
+ *    so the packet keeps its method line and terminator,
+ *    fail if the cost of full input is more than 3 times of the half (quadratic parser would be 4 times)
+ *
+ * Usage: fuzz_xxx.exe [file | directory] ...
+ */
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+#define TIME_CHECK_PREFIX       "worst_"
+#define TIME_CHECK_RATIO        3.0
+#define TIME_CHECK_ROUND        7
+#define TIME_CHECK_MIN_NS       10000000    // each measurement loops at least 10 ms
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* ns per run, looped at least TIME_CHECK_MIN_NS */
+static double measure(const uint8_t * data, size_t size) {
+    long count = 0;
+    double start = now_ns();
+    double time;
+    do {
+        LLVMFuzzerTestOneInput(data, size);
+        count++;
+    } while ((time = now_ns() - start) < TIME_CHECK_MIN_NS);
+    return time / count;
+}
+
+static int run_input(const char * name, const uint8_t * data, size_t size) {
+    LLVMFuzzerTestOneInput(data, size);
+
+    const char * base = strrchr(name, '/');
+    base = base != NULL ? base + 1 : name;
+    if (strncmp(base, TIME_CHECK_PREFIX, strlen(TIME_CHECK_PREFIX)) != 0 || size < 4) {
+        printf("PASS %s (%zu bytes)\n", name, size);
+        return 0;
+    }
+
+    uint8_t * half_data = malloc(size / 2);
+    if (half_data == NULL) {
+        return -1;
+    }
+    size_t head = size / 4;
+    size_t tail = size / 2 - head;
+    memcpy(half_data, data, head);
+    memcpy(&half_data[head], &data[size - tail], tail);
+
+    // the best of rounds, half and full are alternated so both see the same cache and frequency state
+    double half = 0;
+    double full = 0;
+    int i;
+    for (i = 0; i < TIME_CHECK_ROUND; i++) {
+        double half_time = measure(half_data, size / 2);
+        double full_time = measure(data, size);
+        half = i == 0 || half_time < half ? half_time : half;
+        full = i == 0 || full_time < full ? full_time : full;
+    }
+    free(half_data);
+    double ratio = full / (half > 0 ? half : 1);
+    printf("%s %s (%zu bytes, %.1f ns/byte, full/half %.2f)\n", ratio > TIME_CHECK_RATIO ? "FAIL" : "PASS", name, size, full / size, ratio);
+    return ratio > TIME_CHECK_RATIO ? -1 : 0;
+}
+
+static int run_file(const char * path) {
+    FILE * fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (fp == NULL) {
+        printf("open %s failed\n", path);
+        return -1;
+    }
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    uint8_t * data = malloc(capacity);
+    size_t len;
+    while (data != NULL && (len = fread(&data[size], 1, capacity - size, fp)) > 0) {
+        size += len;
+        if (size == capacity) {
+            capacity *= 2;
+            uint8_t * grown = realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+            }
+            data = grown;
+        }
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    if (data == NULL) {
+        printf("read %s failed\n", path);
+        return -1;
+    }
+
+    int result = run_input(path, data, size);
+    free(data);
+    return result;
+}
+
+static int run_path(const char * path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return run_file(path);
+    }
+
+    struct dirent ** list;
+    int num = scandir(path, &list, NULL, alphasort);
+    if (num < 0) {
+        printf("scan %s failed\n", path);
+        return -1;
+    }
+
+    int result = 0;
+    int i;
+    for (i = 0; i < num; i++) {
+        if (list[i]->d_name[0] != '.') {
+            char file[1024];
+            snprintf(file, sizeof(file), "%s/%s", path, list[i]->d_name);
+            result |= run_file(file);
+        }
+        free(list[i]);
+    }
+    free(list);
+    return result;
+}
+
+int main(int argc, char * argv[]) {
+    int result = 0;
+    int i;
+    for (i = 1; i < argc; i++) {
+        result |= run_path(argv[i]);
+    }
+    if (argc < 2) {
+        result |= run_file("-");
+    }
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
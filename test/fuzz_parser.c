@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../lssdp.c"   // lssdp_packet_parser is internal
+
+/* fuzz_parser.c
+ *
+ * fuzz harness of lssdp_packet_parser (libFuzzer / AFL, or fuzz_main.c standalone driver)
+ *
+ * 1. input is one datagram, copied to a NUL terminated buffer as lssdp_socket_read does
+ * 2. extra header interest set is registered, so the extra header offsets are checked too
+ * 3. invariant: every string field of the parsed packet is NUL terminated,
+ *    every extra header value is inside the datagram
+ *
+ * libFuzzer: make -C test fuzz && ./fuzz_parser_libfuzzer.exe corpus/parser
+ * regression: ./fuzz_parser.exe corpus/parser
+ */
+
+static void silent_log(const char * file, const char * tag, int level, int line, const char * func, const char * message) {
+}
+
+static void check_string(const char * string, size_t size) {
+    if (strnlen(string, size) >= size) {
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    static lssdp_ctx lssdp;
+    static bool is_initialized = false;
+    if (is_initialized == false) {
+        lssdp_set_log_callback(silent_log);
+        lssdp_header_interest_add(&lssdp, "SEARCHPORT.UPNP.ORG");
+        lssdp_header_interest_add(&lssdp, "SERVER");
+        lssdp_header_interest_add(&lssdp, "CACHE-CONTROL");
+        lssdp_header_interest_add(&lssdp, "X-USER-AGENT");
+        is_initialized = true;
+    }
+
+    char * buffer = (char *) malloc(size + 1);
+    if (buffer == NULL) {
+        return 0;
+    }
+    memcpy(buffer, data, size);
+    buffer[size] = '\0';
+
+    lssdp_packet packet = {};
+    if (lssdp_packet_parser(&lssdp, buffer, size, &packet) == 0) {
+        check_string(packet.method,      sizeof(packet.method));
+        check_string(packet.st,          sizeof(packet.st));
+        check_string(packet.usn,         sizeof(packet.usn));
+        check_string(packet.location,    sizeof(packet.location));
+        check_string(packet.sm_id,       sizeof(packet.sm_id));
+        check_string(packet.device_type, sizeof(packet.device_type));
+
+        size_t i;
+        for (i = 0; i < LSSDP_HEADER_INTEREST_NUM; i++) {
+            if (packet.extra[i].len > 0 && (size_t) packet.extra[i].offset + packet.extra[i].len > size) {
+                abort();
+            }
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>  // inet_addr, htons
+#include "lssdp.h"
+#include "loopback.h"
+
+/* fuzz_socket_read.c
+ *
+ * fuzz harness of the whole receive path (lssdp_socket_read / lssdp_hub_socket_read) over a fake transport
+ *
+ * 1. input format:
+ *      [config] ([flags] [len_hi] [len_lo] [datagram]) ...
+ *    - config bit 0: monitor, bit 1: neighbor_merge, bit 2: search session, bit 3: neighbor_max = 4,
+ *      bit 4: header interest set, bit 5: SSDP hub with two contexts
+ *    - flags bit 0-1: source address (two hosts on eth0, two on eth1), bit 2-5: advance clock (x 1000 ms),
+ *      bit 6: check neighbor timeout, bit 7: check search timeout
+ *    - datagram is truncated to the rest of input
+ * 2. loopback transport of two interfaces: recv returns the current datagram, sent packets are not delivered
+ * 3. invariant: neighbor list and neighbor_num are consistent, every neighbor has paths only if neighbor_merge
+ *
+ * libFuzzer: make -C test fuzz && ./fuzz_socket_read_libfuzzer.exe corpus/socket_read
+ * regression: ./fuzz_socket_read.exe corpus/socket_read
+ */
+
+static const char * SOURCE[4] = {"192.168.1.100", "192.168.1.101", "10.0.0.100", "10.0.0.101"};
+
+static loopback lb = {.interface_num = 2};
+
+static void silent_log(const char * file, const char * tag, int level, int line, const char * func, const char * message) {
+}
+
+static void search_completed(lssdp_ctx * lssdp, const lssdp_search * search, void * user_data) {
+}
+
+static void setup(lssdp_ctx * lssdp, uint8_t config, const char * st) {
+    lssdp->port           = 1900;
+    lssdp->transport      = &loopback_transport;
+    lssdp->transport_data = &lb;
+    lssdp->monitor        = config & 0x01;
+    lssdp->neighbor_merge = config & 0x02;
+    lssdp->neighbor_max   = config & 0x08 ? 4 : 0;
+    lssdp->neighbor_timeout = 5000;
+    snprintf(lssdp->header.search_target, LSSDP_FIELD_LEN, "%s", st);
+    if (config & 0x10) {
+        lssdp_header_interest_add(lssdp, "SEARCHPORT.UPNP.ORG");
+        lssdp_header_interest_add(lssdp, "SERVER");
+    }
+}
+
+static void check_neighbor_list(const lssdp_ctx * lssdp) {
+    size_t num = 0;
+    const lssdp_nbr * prev = NULL;
+    const lssdp_nbr * nbr;
+    for (nbr = lssdp->neighbor_list; nbr != NULL; nbr = nbr->next) {
+        if (nbr->prev != prev || nbr->path_num > LSSDP_NEIGHBOR_PATH_NUM) {
+            abort();
+        }
+        if (lssdp->neighbor_merge ? nbr->path_num == 0 : nbr->path != NULL) {
+            abort();
+        }
+        if (strnlen(nbr->usn, LSSDP_FIELD_LEN) >= LSSDP_FIELD_LEN || strnlen(nbr->location, LSSDP_LOCATION_LEN) >= LSSDP_LOCATION_LEN) {
+            abort();
+        }
+        prev = nbr;
+        num++;
+    }
+    if (num != lssdp->neighbor_num || (lssdp->neighbor_max > 0 && num > lssdp->neighbor_max)) {
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    lssdp_set_log_callback(silent_log);
+    if (size < 1) {
+        return 0;
+    }
+
+    uint8_t config = data[0];
+    bool is_hub = config & 0x20;
+    lb.now = 1000;
+
+    // 1. single context, or hub with an exact match context and a wildcard context
+    static lssdp_hub hub;
+    static lssdp_ctx lssdp[2];
+    memset(&hub, 0, sizeof(hub));
+    memset(lssdp, 0, sizeof(lssdp));
+    setup(&lssdp[0], config, "ST_P2P");
+    setup(&lssdp[1], config, "ssdp:all");
+
+    if (is_hub) {
+        hub.ctx.port      = 1900;
+        hub.ctx.transport      = &loopback_transport;
+        hub.ctx.transport_data = &lb;
+        hub.ctx.network_interface_changed_callback = lssdp_socket_create;
+        lssdp_hub_network_interface_update(&hub);
+        lssdp_hub_add(&hub, &lssdp[0]);
+        lssdp_hub_add(&hub, &lssdp[1]);
+    } else {
+        lssdp[0].network_interface_changed_callback = lssdp_socket_create;
+        lssdp_network_interface_update(&lssdp[0]);
+    }
+
+    int ctx_num = is_hub ? 2 : 1;
+    int i;
+    for (i = 0; i < ctx_num && (config & 0x04); i++) {
+        lssdp_search_start(&lssdp[i], NULL, 3000, search_completed, NULL);
+    }
+
+    // 2. datagrams
+    size_t offset = 1;
+    while (offset + 3 <= size) {
+        uint8_t flags = data[offset];
+        size_t len = (size_t) data[offset + 1] << 8 | data[offset + 2];
+        offset += 3;
+        if (len > size - offset) {
+            len = size - offset;
+        }
+
+        lb.datagram[0]     = (const char *) &data[offset];
+        lb.datagram_len[0] = len;
+        lb.datagram_num    = 1;
+        lb.source          = inet_addr(SOURCE[flags & 0x03]);
+        lb.now            += ((flags >> 2) & 0x0f) * 1000;
+        offset            += len;
+
+        if (is_hub) {
+            lssdp_hub_socket_read(&hub);
+        } else {
+            lssdp_socket_read(&lssdp[0]);
+        }
+
+        for (i = 0; i < ctx_num; i++) {
+            if (flags & 0x40) {
+                lssdp_neighbor_check_timeout(&lssdp[i]);
+            }
+            if (flags & 0x80) {
+                lssdp_search_check_timeout(&lssdp[i]);
+            }
+            check_neighbor_list(&lssdp[i]);
+        }
+    }
+
+    // 3. clean up
+    for (i = 0; i < ctx_num; i++) {
+        lssdp_search_cancel(&lssdp[i], 0);
+    }
+    if (is_hub) {
+        lssdp_hub_close(&hub);
+    } else {
+        lssdp_socket_close(&lssdp[0]);
+        lssdp_self_address_clear(&lssdp[0]);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>    // struct iovec
+#include <arpa/inet.h>  // inet_addr, htons
+#include "loopback.h"
+
+/* loopback.c
+ *
+ * fake lssdp_transport without network, see loopback.h
+ */
+
+const lssdp_transport loopback_transport = {
+    .socket_open    = loopback_socket_open,
+    .socket_close   = loopback_socket_close,
+    .recv           = loopback_recv,
+    .send           = loopback_send,
+    .send_multicast = loopback_send_multicast,
+    .interface_list = loopback_interface_list,
+    .now            = loopback_now
+};
+
+static ssize_t loopback_copy(loopback * lb, const struct iovec * iov, size_t iov_num) {
+    size_t len = 0;
+    size_t i;
+    for (i = 0; i < iov_num; i++) {
+        if (len + iov[i].iov_len < sizeof(lb->sent)) {
+            memcpy(&lb->sent[len], iov[i].iov_base, iov[i].iov_len);
+            len += iov[i].iov_len;
+        }
+    }
+    lb->sent[len] = '\0';
+    lb->sent_len  = len;
+    return len;
+}
+
+int loopback_socket_open(lssdp_ctx * lssdp) {
+    return 1;
+}
+
+int loopback_socket_close(lssdp_ctx * lssdp, int sock) {
+    return 0;
+}
+
+ssize_t loopback_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info) {
+    loopback * lb = lssdp->transport_data;
+    if (lb->datagram_num == 0) {
+        return 0;
+    }
+
+    size_t index = lb->recv_count++ % lb->datagram_num;
+    size_t len = lb->datagram_len[index] < buffer_len ? lb->datagram_len[index] : buffer_len;
+    memcpy(buffer, lb->datagram[index], len);
+    info->addr = lb->source != 0 ? lb->source : inet_addr("192.168.1.100");
+    info->port = htons(1900);
+    return len;
+}
+
+ssize_t loopback_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port) {
+    return loopback_copy(lssdp->transport_data, iov, iov_num);
+}
+
+ssize_t loopback_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num) {
+    return loopback_copy(lssdp->transport_data, iov, iov_num);
+}
+
+int loopback_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size) {
+    const loopback * lb = lssdp->transport_data;
+    static const char * NAME[2] = {"eth0", "eth1"};
+    static const char * IP[2]   = {"192.168.1.10", "10.0.0.10"};
+
+    memset(list, 0, sizeof(struct lssdp_interface) * list_size);
+
+    size_t num = lb->interface_num > 1 ? 2 : 1;
+    size_t i;
+    for (i = 0; i < num && i < list_size; i++) {
+        snprintf(list[i].name, LSSDP_INTERFACE_NAME_LEN, "%s", NAME[i]);
+        snprintf(list[i].ip, LSSDP_IP_LEN, "%s", IP[i]);
+        list[i].addr    = inet_addr(IP[i]);
+        list[i].netmask = inet_addr("255.255.255.0");
+    }
+    return i;
+}
+
+long long loopback_now(lssdp_ctx * lssdp) {
+    const loopback * lb = lssdp->transport_data;
+    return lb->now;
+}
@@ -0,0 +1,46 @@
+#ifndef __LOOPBACK_H
+#define __LOOPBACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lssdp.h"
+
+/* loopback.h
+ *
+ * fake lssdp_transport without network, for benchmarks and fuzz harnesses.
+ *
+ * 1. lssdp.transport_data is a loopback, each context may have its own
+ * 2. interface "eth0" in LAN 192.168.1.10/24, the second interface "eth1" in LAN 10.0.0.10/24 if interface_num is 2
+ * 3. recv returns the datagrams in turn, from source address port 1900
+ * 4. send and send_multicast copy the packet to the sent buffer, nothing is delivered
+ * 5. the clock is the now field, it only moves by the caller
+ *
+ * the functions are exported, so a test can replace some of them (e.g. recv of a real socket).
+ */
+#define LOOPBACK_DATAGRAM_NUM   2
+#define LOOPBACK_SENT_LEN       2048
+
+typedef struct loopback {
+    const char *    datagram    [LOOPBACK_DATAGRAM_NUM];    // received datagrams, returned in turn
+    size_t          datagram_len[LOOPBACK_DATAGRAM_NUM];
+    size_t          datagram_num;
+    size_t          recv_count;
+    uint32_t        source;                                 // source address in network byte order, 0 is 192.168.1.100
+    size_t          interface_num;                          // 0 is 1
+    long long       now;
+
+    char            sent        [LOOPBACK_SENT_LEN];        // the last sent packet, NUL terminated
+    size_t          sent_len;
+} loopback;
+
+extern const lssdp_transport loopback_transport;
+
+int         loopback_socket_open(lssdp_ctx * lssdp);
+int         loopback_socket_close(lssdp_ctx * lssdp, int sock);
+ssize_t     loopback_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info);
+ssize_t     loopback_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port);
+ssize_t     loopback_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num);
+int         loopback_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size);
+long long   loopback_now(lssdp_ctx * lssdp);
+
+#endif
@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>     // getopt, usleep
+#include <time.h>       // clock_gettime
+#include <arpa/inet.h>  // ntohs, htons
+#include "lssdp.h"
+
+/* replay.c
+ *
+ * replay captured SSDP traffic through the parser and neighbor engine
+ *
+ * 1. load pcap-ng (lssdp_capture_open, Wireshark) or classic pcap (tcpdump) file
+ *    - link type: Ethernet, raw IP, Linux cooked (SLL, SLL2), BSD loopback
+ *    - only IPv4 UDP datagrams to the SSDP port are replayed
+ * 2. feed datagrams into lssdp_socket_read by a replay transport
+ *    - transport clock is the capture timestamp, so neighbor timeout follows the capture
+ *    - packets sent by lssdp (RESPONSE) are counted and dropped
+ * 3. at maximum speed (default) or original speed (-o)
+ * 4. report throughput and neighbor number, repeat the capture by -r as a benchmark
+ *
+ * usage: replay.exe [-o] [-r repeat] [-s search_target] [-P port] [-T timeout] file
+ */
+
+#define LINKTYPE_NULL       0
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+#define LINKTYPE_LINUX_SLL2 276
+#define IDB_MAX             64
+
+typedef struct record {
+    long long       time;                   // microseconds
+    uint32_t        addr;                   // source address in network byte order
+    unsigned short  port;                   // source port
+    const char *    data;                   // UDP payload
+    size_t          len;
+} record;
+
+static struct {
+    record *        list;
+    size_t          num;
+    size_t          size;
+    unsigned short  port;                   // SSDP port filter, 0 is any port
+    const record *  current;                // record returned by next recv
+    long long       time;                   // arrival time of current record in microseconds
+    long long       now;                    // transport clock in milliseconds
+    size_t          sent;                   // packets sent by lssdp
+} Replay = {
+    .port = 1900
+};
+
+
+/** Capture File **/
+
+static uint32_t read32(const uint8_t * p, bool swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t read16(const uint8_t * p, bool swap) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+static int record_add(long long time, int link_type, const uint8_t * data, size_t len) {
+    // 1. link layer to IPv4
+    size_t offset;
+    switch (link_type) {
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV4:
+            offset = 0;
+            break;
+        case LINKTYPE_NULL:
+            offset = 4;
+            break;
+        case LINKTYPE_ETHERNET:
+            if (len < 14) return 0;
+            offset = 12;
+            if (data[offset] == 0x81 && data[offset + 1] == 0x00) {     // 802.1Q VLAN tag
+                offset += 4;
+            }
+            if (len < offset + 2 || data[offset] != 0x08 || data[offset + 1] != 0x00) return 0;
+            offset += 2;
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (len < 16 || data[14] != 0x08 || data[15] != 0x00) return 0;
+            offset = 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if (len < 20 || data[0] != 0x08 || data[1] != 0x00) return 0;
+            offset = 20;
+            break;
+        default:
+            return 0;
+    }
+
+    // 2. IPv4 header: not fragmented UDP
+    if (len < offset + 20 || (data[offset] >> 4) != 4) return 0;
+    size_t ip_len = (data[offset] & 0x0F) * 4;
+    if (ip_len < 20 || data[offset + 9] != 17 || (read16(data + offset + 6, false) & ntohs(0x3FFF)) != 0) return 0;
+    const uint8_t * ip = data + offset;
+    offset += ip_len;
+
+    // 3. UDP header
+    if (len < offset + 8) return 0;
+    const uint8_t * udp = data + offset;
+    unsigned short dst_port = ntohs(read16(udp + 2, false));
+    size_t udp_len = ntohs(read16(udp + 4, false));
+    if (Replay.port != 0 && dst_port != Replay.port) return 0;
+    if (udp_len < 8) return 0;
+    offset += 8;
+    size_t payload_len = udp_len - 8;
+    if (payload_len > len - offset) {
+        payload_len = len - offset;         // truncated by snap length
+    }
+
+    if (Replay.num == Replay.size) {
+        size_t size = Replay.size == 0 ? 1024 : Replay.size * 2;
+        record * list = realloc(Replay.list, size * sizeof(record));
+        if (list == NULL) {
+            return -1;
+        }
+        Replay.list = list;
+        Replay.size = size;
+    }
+
+    record * r = &Replay.list[Replay.num++];
+    r->time = time;
+    memcpy(&r->addr, ip + 12, 4);
+    r->port = ntohs(read16(udp, false));
+    r->data = (const char *) data + offset;
+    r->len  = payload_len;
+    return 0;
+}
+
+static int load_pcapng(const uint8_t * data, size_t len) {
+    bool swap = false;
+    int link_type[IDB_MAX] = {};
+    long long resolution[IDB_MAX] = {};     // timestamp units per second
+    size_t idb_num = 0;
+
+    size_t offset = 0;
+    while (offset + 12 <= len) {
+        const uint8_t * block = data + offset;
+        uint32_t type = read32(block, false);
+        if (type == 0x0A0D0D0A) {
+            // Section Header Block: byte order of this section
+            swap = read32(block + 8, false) != 0x1A2B3C4D;
+            idb_num = 0;
+        }
+
+        uint32_t block_len = read32(block + 4, swap);
+        if (block_len < 12 || block_len % 4 != 0 || block_len > len - offset) {
+            printf("broken pcap-ng block at offset %zu\n", offset);
+            return -1;
+        }
+
+        if (type == 1 && block_len >= 20 && idb_num < IDB_MAX) {
+            // Interface Description Block, option if_tsresol (9)
+            link_type[idb_num]  = read16(block + 8, swap);
+            resolution[idb_num] = 1000000;
+            size_t option = 16;
+            while (option + 4 <= block_len - 4) {
+                uint16_t code = read16(block + option, swap);
+                uint16_t option_len = read16(block + option + 2, swap);
+                if (code == 0) break;
+                if (code == 9 && option_len == 1 && (block[option + 4] & 0x80) == 0) {
+                    long long r = 1;
+                    int i;
+                    for (i = 0; i < block[option + 4]; i++) r *= 10;
+                    resolution[idb_num] = r;
+                }
+                option += 4 + (option_len + 3) / 4 * 4;
+            }
+            idb_num++;
+        }
+
+        if (type == 6 && block_len >= 32) {
+            // Enhanced Packet Block
+            uint32_t interface = read32(block + 8, swap);
+            unsigned long long ts = ((unsigned long long) read32(block + 12, swap) << 32) | read32(block + 16, swap);
+            uint32_t cap_len = read32(block + 20, swap);
+            if (interface < idb_num && cap_len <= block_len - 32) {
+                long long time = (long long) (ts / resolution[interface] * 1000000
+                               + ts % resolution[interface] * 1000000 / resolution[interface]);
+                if (record_add(time, link_type[interface], block + 28, cap_len) != 0) {
+                    return -1;
+                }
+            }
+        }
+
+        offset += block_len;
+    }
+    return 0;
+}
+
+static int load_pcap(const uint8_t * data, size_t len) {
+    uint32_t magic = read32(data, false);
+    bool swap = magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1;
+    bool nano = magic == 0xA1B23C4D || magic == 0x4D3CB2A1;
+    int link_type = read32(data + 20, swap) & 0xFFFF;
+
+    size_t offset = 24;
+    while (offset + 16 <= len) {
+        const uint8_t * header = data + offset;
+        long long sec  = read32(header, swap);
+        long long frac = read32(header + 4, swap);
+        uint32_t cap_len = read32(header + 8, swap);
+        if (cap_len > len - offset - 16) {
+            printf("broken pcap record at offset %zu\n", offset);
+            return -1;
+        }
+
+        long long time = sec * 1000000 + (nano ? frac / 1000 : frac);
+        if (record_add(time, link_type, header + 16, cap_len) != 0) {
+            return -1;
+        }
+        offset += 16 + cap_len;
+    }
+    return 0;
+}
+
+static uint8_t * load_file(const char * path) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("open %s failed, errno = %s (%d)\n", path, strerror(errno), errno);
+        return NULL;
+    }
+
+    uint8_t * data = NULL;
+    size_t len = 0, size = 0;
+    for (;;) {
+        if (len == size) {
+            size = size == 0 ? 65536 : size * 2;
+            uint8_t * buffer = realloc(data, size);
+            if (buffer == NULL) {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = buffer;
+        }
+        size_t n = fread(data + len, 1, size - len, file);
+        if (n == 0) break;
+        len += n;
+    }
+    fclose(file);
+
+    int ret = -1;
+    uint32_t magic = len >= 24 ? read32(data, false) : 0;
+    if (magic == 0x0A0D0D0A) {
+        ret = load_pcapng(data, len);
+    } else if (magic == 0xA1B2C3D4 || magic == 0xD4C3B2A1 || magic == 0xA1B23C4D || magic == 0x4D3CB2A1) {
+        ret = load_pcap(data, len);
+    } else {
+        printf("%s is not pcap or pcap-ng file\n", path);
+    }
+
+    if (ret != 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+
+/** Replay Transport **/
+
+static int replay_socket_open(lssdp_ctx * lssdp) {
+    return 1;
+}
+
+static int replay_socket_close(lssdp_ctx * lssdp, int sock) {
+    return 0;
+}
+
+static ssize_t replay_recv(lssdp_ctx * lssdp, char * buffer, size_t buffer_len, lssdp_recv_info * info) {
+    const record * r = Replay.current;
+    if (r == NULL) {
+        errno = EAGAIN;
+        return -1;
+    }
+    Replay.current = NULL;
+
+    size_t len = r->len < buffer_len ? r->len : buffer_len;
+    memcpy(buffer, r->data, len);
+    info->addr      = r->addr;
+    info->port      = r->port;
+    info->timestamp = Replay.time;
+    return len;
+}
+
+static ssize_t replay_send(lssdp_ctx * lssdp, const struct iovec * iov, size_t iov_num, uint32_t address, unsigned short port) {
+    Replay.sent++;
+    return 0;
+}
+
+static ssize_t replay_send_multicast(lssdp_ctx * lssdp, const struct lssdp_interface * interface, const struct iovec * iov, size_t iov_num) {
+    Replay.sent++;
+    return 0;
+}
+
+static int replay_interface_list(lssdp_ctx * lssdp, struct lssdp_interface * list, size_t list_size) {
+    return 0;
+}
+
+static long long replay_now(lssdp_ctx * lssdp) {
+    return Replay.now;
+}
+
+static const lssdp_transport replay_transport = {
+    .socket_open    = replay_socket_open,
+    .socket_close   = replay_socket_close,
+    .recv           = replay_recv,
+    .send           = replay_send,
+    .send_multicast = replay_send_multicast,
+    .interface_list = replay_interface_list,
+    .now            = replay_now
+};
+
+
+/** Main **/
+
+static long long monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void usage(const char * name) {
+    printf("usage: %s [options] file\n", name);
+    puts("  -o           replay at original speed (default maximum speed)");
+    puts("  -r repeat    replay the capture repeatedly (default 1)");
+    puts("  -s st        search target, default is monitor mode (keep every device)");
+    puts("  -P port      SSDP port filter, 0 is any port (default 1900)");
+    puts("  -T timeout   neighbor timeout in ms, checked per second of capture time (default 15000)");
+}
+
+int main(int argc, char * argv[]) {
+    bool original = false;
+    long repeat = 1;
+    long timeout = 15000;
+    const char * st = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "or:s:P:T:h")) != -1) {
+        switch (opt) {
+            case 'o': original    = true;           break;
+            case 'r': repeat      = atol(optarg);   break;
+            case 's': st          = optarg;         break;
+            case 'P': Replay.port = atoi(optarg);   break;
+            case 'T': timeout     = atol(optarg);   break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1 || repeat <= 0 || timeout <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t * data = load_file(argv[optind]);
+    if (data == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    if (Replay.num == 0) {
+        puts("no SSDP packet in capture");
+        free(data);
+        return EXIT_FAILURE;
+    }
+
+    long long first_time = Replay.list[0].time;
+    long long duration   = Replay.list[Replay.num - 1].time - first_time;
+    size_t bytes = 0;
+    size_t i;
+    for (i = 0; i < Replay.num; i++) {
+        bytes += Replay.list[i].len;
+    }
+    printf("%zu packets, %zu bytes, %.3f seconds\n", Replay.num, bytes, duration / 1e6);
+
+    lssdp_ctx lssdp = {
+        .transport        = &replay_transport,
+        .port             = Replay.port != 0 ? Replay.port : 1900,
+        .neighbor_timeout = timeout,
+        .monitor          = st == NULL
+    };
+    if (st != NULL) {
+        snprintf(lssdp.header.search_target, LSSDP_FIELD_LEN, "%s", st);
+    }
+
+    if (lssdp_socket_create(&lssdp) != 0) {
+        puts("create replay socket failed");
+        free(data);
+        return EXIT_FAILURE;
+    }
+
+    long long last_check = 0;
+    long long start = monotonic_us();
+    long r;
+    for (r = 0; r < repeat; r++) {
+        long long round_time = r * (duration + 1000000);   // 1 second gap between rounds
+        long long round_start = monotonic_us();
+
+        for (i = 0; i < Replay.num; i++) {
+            const record * rec = &Replay.list[i];
+            long long offset = rec->time - first_time;
+
+            if (original) {
+                long long wait = offset - (monotonic_us() - round_start);
+                if (wait > 0) {
+                    usleep(wait);
+                }
+            }
+
+            Replay.current = rec;
+            Replay.time = round_time + offset;
+            Replay.now  = Replay.time / 1000;
+            lssdp_socket_read(&lssdp);
+
+            if (Replay.now - last_check >= 1000) {
+                lssdp_neighbor_check_timeout(&lssdp);
+                last_check = Replay.now;
+            }
+        }
+    }
+    long long elapsed = monotonic_us() - start;
+    if (elapsed <= 0) {
+        elapsed = 1;
+    }
+
+    size_t total = Replay.num * repeat;
+    printf("replayed %zu packets in %.3f ms: %.0f packets/s, %.2f MB/s, %.0f ns/packet\n",
+        total,
+        elapsed / 1e3,
+        total * 1e6 / elapsed,
+        bytes * repeat / (double) elapsed,
+        elapsed * 1e3 / total
+    );
+    printf("neighbors = %zu, packets sent by lssdp = %zu\n", lssdp.neighbor_num, Replay.sent);
+
+    lssdp_socket_close(&lssdp);
+    lssdp_self_address_clear(&lssdp);
+    free(Replay.list);
+    free(data);
+    return EXIT_SUCCESS;
+}
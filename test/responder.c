@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>     // signal, SIGPIPE
+#include <unistd.h>     // close, write, unlink
+#include <fcntl.h>      // fcntl, O_NONBLOCK
+#include <sys/time.h>   // gettimeofday
+#include <sys/select.h> // select
+#include <sys/socket.h> // socket, connect, recv, send
+#include <netinet/in.h> // struct sockaddr_in
+#include <arpa/inet.h>  // inet_addr
+#include "lssdp.h"
+
+/* responder.c
+ *
+ * description responder against local clients, without SSDP network
+ *
+ * 1. responder on ephemeral port: /description.xml (in-memory) and /large.bin (file, 1 MB)
+ * 2. clients on 127.0.0.1 send every request at once (pipelined), then read responses
+ * 3. event loop: select on lssdp_event_fdset and client sockets, then lssdp_event_process
+ * 4. check:
+ *    - 8 concurrent keep-alive clients: GET, HEAD, file GET, 404, then Connection: close
+ *    - If-None-Match of the ETag is 304 without Content-Length, HTTP/1.0 is closed after response
+ *    - POST is 501, idle connection is closed by http.idle_timeout
+ *
+ * usage: responder.exe
+ */
+
+#define CLIENT_MAX      8
+#define RESPONSE_MAX    8
+#define FILE_LEN        (1024 * 1024)
+#define BUFFER_LEN      (FILE_LEN + 65536)
+
+static const char DESCRIPTION[] =
+    "<?xml version=\"1.0\"?>\r\n"
+    "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">\r\n"
+    "<device><UDN>uuid:f835dd000001</UDN></device>\r\n"
+    "</root>\r\n";
+
+typedef struct client {
+    int         sock;
+    char *      buffer;
+    size_t      len;
+    bool        is_closed;
+} client;
+
+typedef struct response {
+    int         status;
+    char        etag[64];
+    const char * body;
+    size_t      body_len;
+    bool        has_length;     // Content-Length is present
+} response;
+
+static char * file_data;
+
+long long get_current_time() {
+    struct timeval time = {};
+    if (gettimeofday(&time, NULL) == -1) {
+        printf("gettimeofday failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+    return (long long) time.tv_sec * 1000 + (long long) time.tv_usec / 1000;
+}
+
+static int client_open(client * c, unsigned short port, const char * requests) {
+    memset(c, 0, sizeof(client));
+    c->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->sock < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = inet_addr("127.0.0.1")
+    };
+    if (connect(c->sock, (struct sockaddr *) &addr, sizeof(addr)) != 0
+            || send(c->sock, requests, strlen(requests), 0) != (ssize_t) strlen(requests)) {
+        printf("client connect failed, errno = %s (%d)\n", strerror(errno), errno);
+        close(c->sock);
+        return -1;
+    }
+    fcntl(c->sock, F_SETFL, fcntl(c->sock, F_GETFL) | O_NONBLOCK);
+    c->buffer = (char *) malloc(BUFFER_LEN);
+    return c->buffer != NULL ? 0 : -1;
+}
+
+static void client_read(client * c) {
+    for (;;) {
+        ssize_t len = recv(c->sock, &c->buffer[c->len], BUFFER_LEN - c->len, 0);
+        if (len > 0) {
+            c->len += len;
+            continue;
+        }
+        if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            c->is_closed = true;
+        }
+        return;
+    }
+}
+
+static void client_close(client * c) {
+    close(c->sock);
+    free(c->buffer);
+}
+
+/* run event loop until every client is closed by responder, or timeout */
+static void run(lssdp_ctx * lssdp, client * clients, size_t client_num, long timeout) {
+    long long deadline = get_current_time() + timeout;
+    while (get_current_time() < deadline) {
+        fd_set read_fds, write_fds;
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        int max_fd = lssdp_event_fdset(lssdp, &read_fds, &write_fds);
+
+        size_t i;
+        size_t open_num = 0;
+        for (i = 0; i < client_num; i++) {
+            if (clients[i].is_closed == false) {
+                FD_SET(clients[i].sock, &read_fds);
+                max_fd = clients[i].sock > max_fd ? clients[i].sock : max_fd;
+                open_num++;
+            }
+        }
+        if (open_num == 0) {
+            return;
+        }
+
+        long wait = lssdp_next_timeout(lssdp);
+        if (wait < 0 || wait > 100) {
+            wait = 100;
+        }
+        struct timeval tv = {
+            .tv_sec  = 0,
+            .tv_usec = wait * 1000
+        };
+        int ret = select(max_fd + 1, &read_fds, &write_fds, NULL, &tv);
+        if (ret < 0) {
+            printf("select error, errno = %s (%d)\n", strerror(errno), errno);
+            return;
+        }
+        if (ret == 0) {
+            FD_ZERO(&read_fds);
+            FD_ZERO(&write_fds);
+        }
+
+        lssdp_event_process(lssdp, &read_fds, &write_fds);
+        for (i = 0; i < client_num; i++) {
+            if (clients[i].is_closed == false && FD_ISSET(clients[i].sock, &read_fds)) {
+                client_read(&clients[i]);
+            }
+        }
+    }
+}
+
+/* split responses, is_head[i] is true if request i is HEAD (Content-Length without body) */
+static size_t parse_responses(const client * c, const bool * is_head, response * list) {
+    size_t num = 0;
+    size_t start = 0;
+    while (num < RESPONSE_MAX && start < c->len) {
+        char header[1024] = {};
+        const char * end = NULL;
+        size_t j;
+        for (j = start; j + 4 <= c->len && j - start < sizeof(header); j++) {
+            if (memcmp(&c->buffer[j], "\r\n\r\n", 4) == 0) {
+                end = &c->buffer[j];
+                break;
+            }
+        }
+        if (end == NULL) {
+            break;
+        }
+        memcpy(header, &c->buffer[start], end - &c->buffer[start]);
+
+        response * r = &list[num];
+        memset(r, 0, sizeof(response));
+        sscanf(header, "HTTP/1.1 %d", &r->status);
+        const char * field = strstr(header, "Content-Length: ");
+        if (field != NULL) {
+            r->body_len   = strtoul(field + strlen("Content-Length: "), NULL, 10);
+            r->has_length = true;
+        }
+        field = strstr(header, "ETag: ");
+        if (field != NULL) {
+            sscanf(field, "ETag: %63s", r->etag);
+        }
+        if (is_head[num]) {
+            r->body_len = 0;
+        }
+
+        start = end - c->buffer + 4;
+        r->body = &c->buffer[start];
+        if (start + r->body_len > c->len) {
+            break;
+        }
+        start += r->body_len;
+        num++;
+    }
+    return num;
+}
+
+static bool is_body(const response * r, const char * data, size_t data_len) {
+    return r->body_len == data_len && memcmp(r->body, data, data_len) == 0;
+}
+
+static int check(const char * name, bool is_passed) {
+    printf("%s: %s\n\n", is_passed ? "PASS" : "FAIL", name);
+    return is_passed ? 0 : -1;
+}
+
+int main() {
+    // sendfile to a closed connection raises SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    // 1. file document
+    char file_path[] = "/tmp/responder-XXXXXX";
+    int fd = mkstemp(file_path);
+    file_data = (char *) malloc(FILE_LEN);
+    if (fd < 0 || file_data == NULL) {
+        printf("create file failed, errno = %s (%d)\n", strerror(errno), errno);
+        return EXIT_FAILURE;
+    }
+    size_t i;
+    for (i = 0; i < FILE_LEN; i++) {
+        file_data[i] = (char) (i * 7 + i / 4096);
+    }
+    bool is_written = write(fd, file_data, FILE_LEN) == FILE_LEN;
+    close(fd);
+
+    lssdp_ctx lssdp = {
+        .http = {
+            .connection_max = CLIENT_MAX,
+            .idle_timeout   = 2000
+        }
+    };
+    if (is_written == false
+            || lssdp_http_open(&lssdp, 0) != 0
+            || lssdp_http_add(&lssdp, "/description.xml", "text/xml", DESCRIPTION, strlen(DESCRIPTION)) != 0
+            || lssdp_http_add_file(&lssdp, "/large.bin", "application/octet-stream", file_path) != 0) {
+        printf("responder open failed\n");
+        unlink(file_path);
+        return EXIT_FAILURE;
+    }
+    unlink(file_path);
+    printf("responder port %u\n", lssdp.http.port);
+
+    int ret = 0;
+    client clients[CLIENT_MAX];
+    response list[RESPONSE_MAX];
+
+    // 2. concurrent keep-alive clients, pipelined requests
+    const char * requests =
+        "GET /description.xml HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        "HEAD /description.xml HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        "GET /large.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        "GET /missing.xml HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        "GET /description.xml?v=1 HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+    const bool is_head[RESPONSE_MAX] = {false, true};
+    for (i = 0; i < CLIENT_MAX; i++) {
+        if (client_open(&clients[i], lssdp.http.port, requests) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    long long start = get_current_time();
+    run(&lssdp, clients, CLIENT_MAX, 10000);
+    printf("%d clients are served in %lld ms\n", CLIENT_MAX, get_current_time() - start);
+
+    bool is_passed = true;
+    char etag[64] = {};
+    for (i = 0; i < CLIENT_MAX; i++) {
+        size_t num = parse_responses(&clients[i], is_head, list);
+        bool is_matched = clients[i].is_closed && num == 5
+            && list[0].status == 200 && is_body(&list[0], DESCRIPTION, strlen(DESCRIPTION))
+            && list[1].status == 200 && list[1].body_len == 0
+            && list[2].status == 200 && is_body(&list[2], file_data, FILE_LEN)
+            && list[3].status == 404
+            && list[4].status == 200 && is_body(&list[4], DESCRIPTION, strlen(DESCRIPTION));
+        if (is_matched == false) {
+            printf("  client %zu: closed %d, %zu responses, %zu bytes\n", i, clients[i].is_closed, num, clients[i].len);
+            is_passed = false;
+        }
+        snprintf(etag, sizeof(etag), "%s", list[0].etag);
+        client_close(&clients[i]);
+    }
+    ret |= check("keep-alive, pipelined GET, HEAD, file, 404 and Connection: close", is_passed && lssdp.http.connection_num == 0);
+
+    // 3. If-None-Match, then HTTP/1.0
+    char conditional[256];
+    snprintf(conditional, sizeof(conditional),
+        "GET /description.xml HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n"
+        "GET /description.xml HTTP/1.0\r\n\r\n",
+        etag
+    );
+    if (client_open(&clients[0], lssdp.http.port, conditional) != 0) {
+        return EXIT_FAILURE;
+    }
+    run(&lssdp, clients, 1, 5000);
+    size_t num = parse_responses(&clients[0], is_head + 2, list);
+    printf("ETag %s: %d, HTTP/1.0: %d\n", etag, num > 0 ? list[0].status : 0, num > 1 ? list[1].status : 0);
+    ret |= check("If-None-Match is 304, HTTP/1.0 is closed", clients[0].is_closed && num == 2
+        && list[0].status == 304 && list[0].has_length == false
+        && list[1].status == 200 && is_body(&list[1], DESCRIPTION, strlen(DESCRIPTION)));
+    client_close(&clients[0]);
+
+    // 4. POST, idle connection
+    lssdp.http.idle_timeout = 200;
+    if (client_open(&clients[0], lssdp.http.port, "POST /description.xml HTTP/1.1\r\nContent-Length: 0\r\n\r\n") != 0
+            || client_open(&clients[1], lssdp.http.port, "") != 0) {
+        return EXIT_FAILURE;
+    }
+    start = get_current_time();
+    run(&lssdp, clients, 2, 5000);
+    long long elapsed = get_current_time() - start;
+    num = parse_responses(&clients[0], is_head + 2, list);
+    printf("POST: %d, idle connection is closed in %lld ms\n", num > 0 ? list[0].status : 0, elapsed);
+    ret |= check("POST is 501, idle connection is closed", clients[0].is_closed && num == 1 && list[0].status == 501
+        && clients[1].is_closed && elapsed >= 150 && elapsed < 2000);
+    client_close(&clients[0]);
+    client_close(&clients[1]);
+
+    lssdp_http_close(&lssdp);
+    free(file_data);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // close, usleep
+#include <sys/socket.h> // socket, bind, sendto, recv, getsockopt
+#include <netinet/in.h> // struct sockaddr_in
+#include <arpa/inet.h>  // inet_addr, htonl
+#include "../lssdp.c"   // udp_socket_filter and self_address are internal
+#include "loopback.h"
+
+/* self_address.c
+ *
+ * 1. self address set, interfaces of loopback transport (eth0 192.168.1.10, eth1 10.0.0.10):
+ *    - growth: 1000 addresses of lssdp_self_address_add, the set is doubled while the load is under 0.5
+ *    - rebuild: eth1 is removed by lssdp_network_interface_update, the added addresses are kept
+ *    - IPv6: IPv6 address and IPv4-mapped IPv6 address keys, :: and unknown family
+ * 2. socket filter built from self address set, on a real UDP socket of 127.0.0.1 (ephemeral port)
+ *    - the filter is attached to the socket, datagrams are sent from another socket of 127.0.0.1
+ *    - program length: one jeq + ret per IPv4 self address, one ld + jeq per 4/2/1 bytes of each header line
+ *    - M-SEARCH, NOTIFY and RESPONSE header lines pass, other payloads are dropped
+ *    - the program is regenerated by lssdp_self_address_add, 127.0.0.1 as self address is dropped
+ *
+ * usage: self_address.exe
+ */
+
+#define USER_ADDRESS_NUM    1000    // 172.16.x.y
+#define SELF_ADDRESS_NUM    200     // 10.0.x.y, the set is grown several times
+
+static const char * PASSED[] = {
+    "M-SEARCH * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nMAN: \"ssdp:discover\"\r\nMX: 1\r\nST: ST_P2P\r\n\r\n",
+    "NOTIFY * HTTP/1.1\r\nHOST: 239.255.255.250:1900\r\nNT: ST_P2P\r\nNTS: ssdp:alive\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nST: ST_P2P\r\n\r\n",
+    "NOTIFY * HTTP/1.1\r\n"                 // header line only
+};
+
+static const char * DROPPED[] = {
+    "GET / HTTP/1.1\r\n\r\n",
+    "M-SEARCH * HTTP/1.0\r\n\r\n",
+    "m-search * HTTP/1.1\r\n\r\n",
+    "NOTIFY * HTTP/1.1\n\n",
+    "NOTIFY",                               // shorter than header line
+    "HTTP/1.1 404 Not Found\r\n\r\n",
+    "x"
+};
+
+static bool is_self_ipv4(lssdp_ctx * lssdp, const char * address) {
+    struct in_addr ipv4 = {inet_addr(address)};
+    return lssdp_is_self_address(lssdp, AF_INET, &ipv4);
+}
+
+static bool is_self_ipv6(lssdp_ctx * lssdp, const char * address) {
+    struct in6_addr ipv6;
+    inet_pton(AF_INET6, address, &ipv6);
+    return lssdp_is_self_address(lssdp, AF_INET6, &ipv6);
+}
+
+/* every address of lssdp_self_address_add is in the set */
+static bool is_self_user(lssdp_ctx * lssdp) {
+    size_t i;
+    for (i = 0; i < USER_ADDRESS_NUM; i++) {
+        struct in_addr ipv4 = {htonl(0xAC100000 | (i + 1))};
+        if (lssdp_is_self_address(lssdp, AF_INET, &ipv4) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_set(const char * name, lssdp_ctx * lssdp, size_t num, bool is_passed) {
+    // slot number is a power of 2 and the load is under 0.5
+    size_t slot_num = lssdp->self_address.slot_num;
+    is_passed &= lssdp->self_address.num == num && (slot_num & (slot_num - 1)) == 0 && num <= slot_num / 2;
+    printf("%s: %s (%zu addresses, %zu slots)\n", is_passed ? "PASS" : "FAIL", name, lssdp->self_address.num, slot_num);
+    return is_passed;
+}
+
+static bool self_address_set_test() {
+    loopback lb = {.interface_num = 2};
+    lssdp_ctx lssdp = {
+        .transport      = &loopback_transport,
+        .transport_data = &lb
+    };
+
+    // 1. interface addresses, then the set is grown past half full several times
+    lssdp_network_interface_update(&lssdp);
+    bool is_passed = check_set("interface addresses", &lssdp, 2,
+                               is_self_ipv4(&lssdp, "192.168.1.10") && is_self_ipv4(&lssdp, "10.0.0.10") && !is_self_ipv4(&lssdp, "192.168.1.100"));
+
+    size_t i;
+    for (i = 0; i < USER_ADDRESS_NUM; i++) {
+        struct in_addr ipv4 = {htonl(0xAC100000 | (i + 1))};
+        lssdp_self_address_add(&lssdp, AF_INET, &ipv4);
+    }
+    lssdp_self_address_add(&lssdp, AF_INET, &(struct in_addr) {inet_addr("172.16.0.1")});
+    is_passed &= check_set("growth of 1000 added addresses", &lssdp, USER_ADDRESS_NUM + 2,
+                           is_self_user(&lssdp) && is_self_ipv4(&lssdp, "10.0.0.10") && !is_self_ipv4(&lssdp, "172.16.3.233"));
+
+    // 2. IPv6 keys: IPv4 address is the same key as its IPv4-mapped IPv6 address, not as the other IPv6 address of the same low 4 bytes
+    struct in6_addr ipv6;
+    inet_pton(AF_INET6, "fe80::1", &ipv6);
+    lssdp_self_address_add(&lssdp, AF_INET6, &ipv6);
+    inet_pton(AF_INET6, "::", &ipv6);
+    lssdp_self_address_add(&lssdp, AF_INET6, &ipv6);
+    bool is_ipv6 = is_self_ipv6(&lssdp, "fe80::1") && !is_self_ipv6(&lssdp, "fe80::2")
+                && is_self_ipv6(&lssdp, "::ffff:192.168.1.10") && !is_self_ipv6(&lssdp, "::192.168.1.10")
+                && !is_self_ipv6(&lssdp, "::") && lssdp_self_address_add(&lssdp, AF_UNIX, &ipv6) < 0;
+    is_passed &= check_set("IPv6 and IPv4-mapped IPv6 keys", &lssdp, USER_ADDRESS_NUM + 3, is_ipv6);
+
+    // 3. rebuild: eth1 is removed, the added addresses are kept
+    lb.interface_num = 1;
+    lssdp_network_interface_update(&lssdp);
+    is_passed &= check_set("rebuild keeps added addresses", &lssdp, USER_ADDRESS_NUM + 2,
+                           is_self_user(&lssdp) && is_self_ipv6(&lssdp, "fe80::1") && is_self_ipv4(&lssdp, "192.168.1.10") && !is_self_ipv4(&lssdp, "10.0.0.10"));
+
+    // 4. clear
+    lssdp_self_address_clear(&lssdp);
+    is_passed &= check_set("clear", &lssdp, 0, !is_self_ipv4(&lssdp, "172.16.0.1") && !is_self_ipv4(&lssdp, "192.168.1.10"));
+    return is_passed;
+}
+
+/* expected program length, header line is compared by 4, 2 and 1 byte loads */
+static size_t filter_len(size_t ipv4_num) {
+    const char * header[] = {Global.HEADER_MSEARCH, Global.HEADER_NOTIFY, Global.HEADER_RESPONSE};
+    size_t len = 1 + 2 * ipv4_num + 1;
+    size_t i;
+    for (i = 0; i < 3; i++) {
+        size_t n = strlen(header[i]);
+        while (n > 0) {
+            size_t size = n >= 4 ? 4 : n >= 2 ? 2 : 1;
+            len += 2;
+            n -= size;
+        }
+        len++;
+    }
+    return len;
+}
+
+/* send every payload to port, return the number of datagrams read from sock */
+static size_t send_recv(int sock, unsigned short port, const char * payload[], size_t payload_num) {
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {
+        .sin_family      = AF_INET,
+        .sin_port        = port,
+        .sin_addr.s_addr = inet_addr("127.0.0.1")
+    };
+    size_t i;
+    for (i = 0; i < payload_num; i++) {
+        sendto(sender, payload[i], strlen(payload[i]), 0, (struct sockaddr *) &address, sizeof(address));
+    }
+    close(sender);
+    usleep(20000);
+
+    char buffer[LSSDP_BUFFER_LEN];
+    size_t num = 0;
+    while (recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) >= 0) {
+        num++;
+    }
+    return num;
+}
+
+static bool check_filter(const char * name, lssdp_ctx * lssdp, unsigned short port, size_t ipv4_num, size_t passed_num) {
+    // getsockopt SO_GET_FILTER with zero length returns the number of instructions
+    socklen_t len = 0;
+    getsockopt(lssdp->sock, SOL_SOCKET, SO_GET_FILTER, NULL, &len);
+
+    size_t passed  = send_recv(lssdp->sock, port, PASSED, sizeof(PASSED) / sizeof(PASSED[0]));
+    size_t dropped = send_recv(lssdp->sock, port, DROPPED, sizeof(DROPPED) / sizeof(DROPPED[0]));
+    bool is_passed = len == filter_len(ipv4_num) && passed == passed_num && dropped == 0;
+    printf("%s: %s (%u instructions, expected %zu, %zu of %zu passed, %zu of %zu not dropped)\n", is_passed ? "PASS" : "FAIL", name,
+           len, filter_len(ipv4_num), passed, sizeof(PASSED) / sizeof(PASSED[0]), dropped, sizeof(DROPPED) / sizeof(DROPPED[0]));
+    return is_passed;
+}
+
+static bool socket_filter_test() {
+    lssdp_ctx lssdp = {
+        .socket_filter = true
+    };
+
+    lssdp.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = inet_addr("127.0.0.1")
+    };
+    socklen_t address_len = sizeof(address);
+    if (lssdp.sock < 0
+    || bind(lssdp.sock, (struct sockaddr *) &address, sizeof(address)) != 0
+    || getsockname(lssdp.sock, (struct sockaddr *) &address, &address_len) != 0
+    || udp_socket_filter(&lssdp, lssdp.sock) != 0) {
+        printf("FAIL: socket filter is not attached, errno = %s (%d)\n", strerror(errno), errno);
+        return false;
+    }
+
+    // 1. empty set
+    bool is_passed = check_filter("socket filter of empty set", &lssdp, address.sin_port, 0, 4);
+
+    // 2. the program is regenerated by each new address, IPv6 address is not in the program
+    size_t i;
+    for (i = 0; i < SELF_ADDRESS_NUM; i++) {
+        struct in_addr ipv4 = {htonl(0x0A000000 | (i + 1))};
+        lssdp_self_address_add(&lssdp, AF_INET, &ipv4);
+    }
+    struct in6_addr ipv6;
+    inet_pton(AF_INET6, "fe80::1", &ipv6);
+    lssdp_self_address_add(&lssdp, AF_INET6, &ipv6);
+    is_passed &= check_filter("socket filter of 200 IPv4 and 1 IPv6 self addresses", &lssdp, address.sin_port, SELF_ADDRESS_NUM, 4);
+
+    // 3. sender is self address
+    struct in_addr loopback = {inet_addr("127.0.0.1")};
+    lssdp_self_address_add(&lssdp, AF_INET, &loopback);
+    is_passed &= check_filter("socket filter of self address 127.0.0.1", &lssdp, address.sin_port, SELF_ADDRESS_NUM + 1, 0);
+
+    close(lssdp.sock);
+    lssdp_self_address_clear(&lssdp);
+    return is_passed;
+}
+
+int main() {
+#ifndef __linux__
+    printf("socket filter is not supported on this platform\n");
+    return self_address_set_test() ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+    bool is_passed = self_address_set_test();
+    is_passed &= socket_filter_test();
+    return is_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+}
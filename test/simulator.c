@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // getopt
+#include <time.h>       // clock_gettime
+#include "lssdp.h"
+#include "fabric.h"
+
+/* simulator.c
+ *
+ * discovery convergence simulator on in-memory fabric
+ *
+ * 1. create N lssdp_ctx on the fabric, boot time of each node is random in [0, stagger]
+ * 2. run virtual time by step, every booted node does:
+ *    - read all arrived packets
+ *    - send M-SEARCH by scheduler
+ *    - per announce interval: send NOTIFY and check neighbor timeout
+ * 3. stop when every node sees every other node, or time limit is reached
+ * 4. report convergence time, packets and per-node CPU time
+ *
+ * usage: simulator.exe [-n nodes] [-s stagger] [-l loss] [-d latency] [-a announce] [-t limit] [-p step] [-r seed]
+ */
+
+#define SIM_NODE_MAX    10000
+
+typedef struct sim_node {
+    lssdp_ctx       lssdp;
+    long long       boot_time;
+    long long       last_announce;
+    bool            booted;
+    long long       cpu_ns;                 // CPU time spent in lssdp of this node
+} sim_node;
+
+static long long cpu_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int create_socket(lssdp_ctx * lssdp) {
+    return lssdp_socket_create(lssdp);
+}
+
+static void usage(const char * name) {
+    printf("usage: %s [options]\n", name);
+    puts("  -n nodes     number of nodes, 2 ~ 10000 (default 100)");
+    puts("  -s stagger   boot time spread in ms (default 1000)");
+    puts("  -l loss      packet loss rate 0.0 ~ 1.0 (default 0)");
+    puts("  -d latency   packet latency in ms (default 1)");
+    puts("  -a announce  NOTIFY interval in ms (default 5000)");
+    puts("  -t limit     virtual time limit in ms (default 120000)");
+    puts("  -p step      virtual time step in ms (default 10)");
+    puts("  -r seed      random seed (default 1)");
+}
+
+int main(int argc, char * argv[]) {
+    long   node_num = 100;
+    long   stagger  = 1000;
+    double loss     = 0;
+    long   latency  = 1;
+    long   announce = 5000;
+    long   limit    = 120000;
+    long   step     = 10;
+    unsigned int seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:l:d:a:t:p:r:h")) != -1) {
+        switch (opt) {
+            case 'n': node_num = atol(optarg);      break;
+            case 's': stagger  = atol(optarg);      break;
+            case 'l': loss     = atof(optarg);      break;
+            case 'd': latency  = atol(optarg);      break;
+            case 'a': announce = atol(optarg);      break;
+            case 't': limit    = atol(optarg);      break;
+            case 'p': step     = atol(optarg);      break;
+            case 'r': seed     = atol(optarg);      break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (node_num < 2 || node_num > SIM_NODE_MAX || stagger < 0 || loss < 0 || loss > 1
+     || latency < 0 || announce <= 0 || limit <= 0 || step <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    fabric * fab = fabric_create(node_num, latency, loss, seed);
+    sim_node * node = calloc(node_num, sizeof(sim_node));
+    if (fab == NULL || node == NULL) {
+        puts("out of memory");
+        return EXIT_FAILURE;
+    }
+
+    long i;
+    for (i = 0; i < node_num; i++) {
+        sim_node * n = &node[i];
+        n->lssdp = (lssdp_ctx) {
+            .port = 1900,
+            .neighbor_timeout = announce * 3,
+            .header = {
+                .search_target   = "ST_SIM",
+                .device_type     = "SIM",
+                .location.suffix = ":5678"
+            },
+            .network_interface_changed_callback = create_socket
+        };
+        snprintf(n->lssdp.header.unique_service_name, LSSDP_FIELD_LEN, "node-%ld", i + 1);
+        n->boot_time = stagger > 0 ? rand_r(&seed) % (stagger + 1) : 0;
+
+        if (fabric_node_add(fab, &n->lssdp) < 0) {
+            puts("fabric add node failed");
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("nodes = %ld, stagger = %ld ms, loss = %.3f, latency = %ld ms, announce = %ld ms, step = %ld ms\n",
+        node_num, stagger, loss, latency, announce, step);
+
+    long long converge_time = -1;
+    long converged = 0;
+    fabric_stats stats = {};
+    while (fabric_now(fab) <= limit) {
+        long long now = fabric_now(fab);
+        converged = 0;
+
+        for (i = 0; i < node_num; i++) {
+            sim_node * n = &node[i];
+            if (n->booted == false && now < n->boot_time) {
+                continue;
+            }
+
+            long long cpu_start = cpu_time_ns();
+            if (n->booted == false) {
+                // boot: socket is created in network_interface_changed_callback
+                lssdp_network_interface_update(&n->lssdp);
+                lssdp_send_notify(&n->lssdp);
+                n->last_announce = now;
+                n->booted = true;
+            }
+
+            while (fabric_node_readable(&n->lssdp)) {
+                lssdp_socket_read(&n->lssdp);
+            }
+
+            lssdp_msearch_schedule(&n->lssdp);
+
+            if (now - n->last_announce >= announce) {
+                lssdp_send_notify(&n->lssdp);
+                lssdp_neighbor_check_timeout(&n->lssdp);
+                n->last_announce = now;
+            }
+            n->cpu_ns += cpu_time_ns() - cpu_start;
+
+            if (n->lssdp.neighbor_num == (size_t) node_num - 1) {
+                converged++;
+            }
+        }
+
+        if (converged == node_num) {
+            converge_time = now;
+            stats = fabric_get_stats(fab);
+            break;
+        }
+
+        fabric_advance(fab, step);
+    }
+
+    if (converge_time < 0) {
+        stats = fabric_get_stats(fab);
+        printf("not converged in %ld ms, %ld / %ld nodes see all neighbors\n", limit, converged, node_num);
+    } else {
+        printf("converged at %lld ms\n", converge_time);
+    }
+
+    printf("packets: sent = %zu, delivered = %zu, dropped = %zu, bytes = %zu\n",
+        stats.sent, stats.delivered, stats.dropped, stats.bytes);
+
+    long long cpu_total = 0, cpu_max = 0;
+    for (i = 0; i < node_num; i++) {
+        cpu_total += node[i].cpu_ns;
+        if (node[i].cpu_ns > cpu_max) {
+            cpu_max = node[i].cpu_ns;
+        }
+    }
+    printf("cpu: total = %.3f ms, per node avg = %.3f ms, max = %.3f ms\n",
+        cpu_total / 1e6, cpu_total / 1e6 / node_num, cpu_max / 1e6);
+
+    for (i = 0; i < node_num; i++) {
+        lssdp_socket_close(&node[i].lssdp);
+        lssdp_self_address_clear(&node[i].lssdp);
+    }
+    free(node);
+    fabric_destroy(fab);
+    return converge_time < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>  // inet_addr
+#include <sys/uio.h>    // struct iovec
+#include "lssdp.h"
+#include "fabric.h"
+
+/* virtual_network.c
+ *
+ * 1. create in-memory fabric with 20 ms latency
+ * 2. attach 3 lssdp_ctx to the fabric, each one has its own virtual IP
+ * 3. run 30 seconds virtual time with 100 ms step
+ *    - read every readable node
+ *    - send M-SEARCH by scheduler
+ *    - per 5 seconds send NOTIFY and check neighbor timeout
+ * 4. show neighbor list of every node and fabric statistics
+ * 5. neighbor event cases, each one checks the sequence of neighbor events:
+ *    - multi-homed: neighbor_merge neighbor is received by two interfaces, then the address of one interface is changed
+ *    - extra header: SEARCHPORT.UPNP.ORG is in NOTIFY only, RESPONSE without it keeps the value
+ *    - boot id and config id: reboot, ssdp:update with NEXTBOOTID.UPNP.ORG, config change, id appears and disappears
+ *    - probe: neighbor without NOTIFY is kept by the RESPONSE of unicast M-SEARCH, in exact, prefix and monitor mode
+ * 6. search target cases: which M-SEARCH is answered with which ST, which NOTIFY is accepted by st_match mode
+ */
+
+#define NODE_NUM    3
+#define EVENT_MAX   16
+
+typedef struct event_log {
+    size_t      num;
+    int         event   [EVENT_MAX];
+    char        location[EVENT_MAX][LSSDP_LOCATION_LEN];
+} event_log;
+
+static const char * EVENT_NAME[] = {"ADDED", "UPDATED", "REMOVED", "REBOOTED", "CONFIG_CHANGED"};
+
+int create_socket(lssdp_ctx * lssdp) {
+    return lssdp_socket_create(lssdp);
+}
+
+static void record_event(lssdp_ctx * lssdp, int event, const lssdp_nbr * nbr, void * user_data) {
+    event_log * log = user_data;
+    if (log->num < EVENT_MAX) {
+        log->event[log->num] = event;
+        snprintf(log->location[log->num], LSSDP_LOCATION_LEN, "%s", nbr->location);
+    }
+    log->num++;
+}
+
+/* run virtual time with 10 ms step, every datagram in flight is read */
+static void run(fabric * fab, lssdp_ctx * node, size_t node_num, long ms) {
+    long long end_time = fabric_now(fab) + ms;
+    while (fabric_now(fab) < end_time) {
+        size_t i;
+        for (i = 0; i < node_num; i++) {
+            while (fabric_node_readable(&node[i])) {
+                lssdp_socket_read(&node[i]);
+            }
+        }
+        fabric_advance(fab, 10);
+    }
+}
+
+/* send a crafted multicast M-SEARCH of st */
+static void send_msearch(lssdp_ctx * sender, const char * st) {
+    char packet[512];
+    int len = snprintf(packet, sizeof(packet),
+        "M-SEARCH * HTTP/1.1\r\n"
+        "HOST:239.255.255.250:1900\r\n"
+        "MAN:\"ssdp:discover\"\r\n"
+        "MX:1\r\n"
+        "ST:%s\r\n"
+        "\r\n",
+        st);
+
+    struct iovec iov = {.iov_base = packet, .iov_len = len};
+    sender->transport->send_multicast(sender, &sender->interface[0], &iov, 1);
+}
+
+/* send a crafted NOTIFY (multicast) or RESPONSE (unicast to receiver) of sender through the fabric transport
+ *
+ * @param nts       NTS of NOTIFY (e.g. "ssdp:alive"), NULL is RESPONSE
+ * @param headers   additional header lines, each one ends with "\r\n"
+ */
+static void send_packet(lssdp_ctx * sender, const lssdp_ctx * receiver, const char * nts, const char * headers) {
+    char packet[1024];
+    int len = snprintf(packet, sizeof(packet),
+        "%s"
+        "HOST:239.255.255.250:1900\r\n"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "LOCATION:%s:5678\r\n"
+        "%s:%s\r\n"
+        "%s%s%s"
+        "USN:%s\r\n"
+        "%s"
+        "\r\n",
+        nts != NULL ? "NOTIFY * HTTP/1.1\r\n" : "HTTP/1.1 200 OK\r\n",
+        sender->interface[0].ip,
+        nts != NULL ? "NT" : "ST", sender->header.search_target,
+        nts != NULL ? "NTS:" : "", nts != NULL ? nts : "", nts != NULL ? "\r\n" : "",
+        sender->header.unique_service_name,
+        headers);
+
+    struct iovec iov = {.iov_base = packet, .iov_len = len};
+    if (nts != NULL) {
+        sender->transport->send_multicast(sender, &sender->interface[0], &iov, 1);
+    } else {
+        sender->transport->send(sender, &iov, 1, receiver->interface[0].addr, receiver->port);
+    }
+}
+
+/* ST of the received RESPONSE, packet_received_callback_data */
+static int record_response(lssdp_ctx * lssdp, const char * packet, size_t packet_len, uint32_t address,
+                           const struct lssdp_interface * interface, void * user_data) {
+    char * st = user_data;
+    const char * line = strstr(packet, "\r\nST:");
+    if (strncmp(packet, "HTTP/1.1 200 OK\r\n", 17) == 0 && line != NULL) {
+        line += 5;
+        snprintf(st, LSSDP_FIELD_LEN, "%.*s", (int) strcspn(line, "\r\n"), line);
+    }
+    return 0;
+}
+
+/* compare event log with the expected events, then clear the log */
+static bool check_events(const char * name, event_log * log, const int * expected, size_t expected_num) {
+    bool is_passed = log->num == expected_num;
+    size_t i;
+    for (i = 0; i < expected_num && is_passed; i++) {
+        is_passed = log->event[i] == expected[i];
+    }
+
+    printf("%s: %s (", is_passed ? "PASS" : "FAIL", name);
+    for (i = 0; i < log->num && i < EVENT_MAX; i++) {
+        printf("%s%s %s", i > 0 ? ", " : "", EVENT_NAME[log->event[i]], log->location[i]);
+    }
+    printf(")\n");
+
+    memset(log, 0, sizeof(event_log));
+    return is_passed;
+}
+
+/* compare the paths and location of neighbor */
+static bool check_neighbor(const char * name, const lssdp_nbr * nbr, size_t path_num, const char * location) {
+    bool is_passed = nbr != NULL && nbr->path_num == path_num && strcmp(nbr->location, location) == 0;
+    printf("%s: %s (%zu paths, location %s)\n", is_passed ? "PASS" : "FAIL", name, nbr != NULL ? nbr->path_num : 0, nbr != NULL ? nbr->location : "");
+    return is_passed;
+}
+
+/* two nodes on a fabric of 20 ms latency, node[0] is the sender, neighbor events of node[1] are recorded to log
+ *
+ * @param usn_prefix    unique_service_name of node is "<usn_prefix>-1" and "<usn_prefix>-2"
+ * @return              fabric, NULL if failed
+ */
+static fabric * pair_create(lssdp_ctx * node, const char * usn_prefix, event_log * log) {
+    fabric * fab = fabric_create(2, 20, 0.0, 1);
+    if (fab == NULL) {
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        node[i] = (lssdp_ctx) {
+            .port = 1900,
+            .neighbor_timeout = 15000,
+            .header = {
+                .search_target   = "ST_P2P",
+                .device_type     = "DEV_TYPE",
+                .location.suffix = ":5678"
+            },
+            .network_interface_changed_callback = create_socket
+        };
+        snprintf(node[i].header.unique_service_name, LSSDP_FIELD_LEN, "%s-%d", usn_prefix, i + 1);
+        fabric_node_add(fab, &node[i]);
+        lssdp_network_interface_update(&node[i]);
+    }
+    node[1].neighbor_event_callback = record_event;
+    node[1].user_data               = log;
+    return fab;
+}
+
+static void pair_destroy(fabric * fab, lssdp_ctx * node) {
+    int i;
+    for (i = 0; i < 2; i++) {
+        node[i].neighbor_event_callback = NULL;
+        lssdp_socket_close(&node[i]);
+        lssdp_self_address_clear(&node[i]);
+    }
+    fabric_destroy(fab);
+}
+
+/* 1. sender is multi-homed (vnet0 and vnet1), receiver keys neighbor by USN (neighbor_merge)
+ * 2. NOTIFY of both interfaces: ADDED by the first path, UPDATED by the second path
+ * 3. DHCP changes vnet0 address of sender: the vnet0 path is replaced in place, location follows immediately
+ */
+static bool multi_homed_test() {
+    event_log log = {};
+    lssdp_ctx node[2];
+    fabric * fab = pair_create(node, "multi", &log);
+    if (fab == NULL) {
+        return false;
+    }
+
+    // the second interface vnet1 of both nodes
+    int i;
+    for (i = 0; i < 2; i++) {
+        fabric_node_interface_add(&node[i]);
+        lssdp_network_interface_update(&node[i]);
+    }
+    node[1].neighbor_merge = true;
+
+    bool is_passed = true;
+    lssdp_send_notify(&node[0]);
+    run(fab, node, 2, 100);
+    is_passed &= check_events("multi-homed neighbor", &log, (int []) {LSSDP_NEIGHBOR_ADDED, LSSDP_NEIGHBOR_UPDATED}, 2);
+    is_passed &= check_neighbor("multi-homed paths", node[1].neighbor_list, 2, "10.0.0.1:5678");
+
+    fabric_advance(fab, 1000);
+    fabric_node_address_set(&node[0], 0, inet_addr("10.0.0.100"));
+    lssdp_network_interface_update(&node[0]);
+    lssdp_send_notify(&node[0]);
+    run(fab, node, 2, 100);
+    is_passed &= check_events("multi-homed address change", &log, (int []) {LSSDP_NEIGHBOR_UPDATED}, 1);
+    is_passed &= check_neighbor("multi-homed location", node[1].neighbor_list, 2, "10.0.0.100:5678");
+
+    pair_destroy(fab, node);
+    return is_passed;
+}
+
+/* 1. NOTIFY carries SEARCHPORT.UPNP.ORG, RESPONSE does not: the value is kept, no UPDATED by alternation
+ * 2. NOTIFY without SEARCHPORT.UPNP.ORG: the header is removed, UPDATED
+ */
+static bool extra_header_test() {
+    event_log log = {};
+    lssdp_ctx node[2];
+    fabric * fab = pair_create(node, "extra", &log);
+    if (fab == NULL) {
+        return false;
+    }
+    int index = lssdp_header_interest_add(&node[1], "SEARCHPORT.UPNP.ORG");
+
+    bool is_passed = true;
+    send_packet(&node[0], &node[1], "ssdp:alive", "SEARCHPORT.UPNP.ORG:1901\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("extra header added", &log, (int []) {LSSDP_NEIGHBOR_ADDED}, 1);
+
+    int i;
+    for (i = 0; i < 3; i++) {
+        send_packet(&node[0], &node[1], NULL, "");
+        run(fab, node, 2, 100);
+        send_packet(&node[0], &node[1], "ssdp:alive", "SEARCHPORT.UPNP.ORG:1901\r\n");
+        run(fab, node, 2, 100);
+    }
+    is_passed &= check_events("extra header of NOTIFY only", &log, NULL, 0);
+
+    const char * value = node[1].neighbor_list != NULL ? lssdp_neighbor_header(node[1].neighbor_list, index) : NULL;
+    bool is_kept = value != NULL && strcmp(value, "1901") == 0;
+    printf("%s: extra header value (%s)\n", is_kept ? "PASS" : "FAIL", value != NULL ? value : "absent");
+    is_passed &= is_kept;
+
+    send_packet(&node[0], &node[1], "ssdp:alive", "");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("extra header removed", &log, (int []) {LSSDP_NEIGHBOR_UPDATED}, 1);
+
+    pair_destroy(fab, node);
+    return is_passed;
+}
+
+/* 1. BOOTID.UPNP.ORG is changed: REBOOTED
+ * 2. ssdp:update announces NEXTBOOTID.UPNP.ORG, then NOTIFY of the next BOOTID: no REBOOTED
+ * 3. CONFIGID.UPNP.ORG is changed: CONFIG_CHANGED
+ * 4. CONFIGID disappears and appears, BOOTID disappears: UPDATED
+ */
+static bool boot_id_test() {
+    event_log log = {};
+    lssdp_ctx node[2];
+    fabric * fab = pair_create(node, "boot", &log);
+    if (fab == NULL) {
+        return false;
+    }
+
+    bool is_passed = true;
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:1\r\nCONFIGID.UPNP.ORG:1\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("boot id added", &log, (int []) {LSSDP_NEIGHBOR_ADDED}, 1);
+
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:2\r\nCONFIGID.UPNP.ORG:1\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("boot id changed", &log, (int []) {LSSDP_NEIGHBOR_REBOOTED}, 1);
+
+    send_packet(&node[0], &node[1], "ssdp:update", "BOOTID.UPNP.ORG:2\r\nNEXTBOOTID.UPNP.ORG:3\r\nCONFIGID.UPNP.ORG:1\r\n");
+    run(fab, node, 2, 100);
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:3\r\nCONFIGID.UPNP.ORG:1\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("ssdp:update next boot id", &log, NULL, 0);
+
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:3\r\nCONFIGID.UPNP.ORG:2\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("config id changed", &log, (int []) {LSSDP_NEIGHBOR_CONFIG_CHANGED}, 1);
+
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:3\r\n");
+    run(fab, node, 2, 100);
+    send_packet(&node[0], &node[1], "ssdp:alive", "BOOTID.UPNP.ORG:3\r\nCONFIGID.UPNP.ORG:2\r\n");
+    run(fab, node, 2, 100);
+    send_packet(&node[0], &node[1], "ssdp:alive", "CONFIGID.UPNP.ORG:2\r\n");
+    run(fab, node, 2, 100);
+    is_passed &= check_events("id disappears and appears", &log,
+        (int []) {LSSDP_NEIGHBOR_UPDATED, LSSDP_NEIGHBOR_UPDATED, LSSDP_NEIGHBOR_UPDATED}, 3);
+
+    pair_destroy(fab, node);
+    return is_passed;
+}
+
+/* 1. receiver probes neighbor before neighbor_timeout, the sender sends no NOTIFY after the first one
+ * 2. the probe searches ST of the neighbor, so the RESPONSE keeps it alive although search_target is a prefix (st_match)
+ *    or is not the ST of the neighbor (monitor)
+ */
+static bool probe_test(const char * name, int st_match, bool monitor) {
+    event_log log = {};
+    lssdp_ctx node[2];
+    fabric * fab = pair_create(node, "probe", &log);
+    if (fab == NULL) {
+        return false;
+    }
+    if (st_match == LSSDP_ST_MATCH_PREFIX || monitor) {
+        snprintf(node[0].header.search_target, LSSDP_FIELD_LEN, "urn:acme:service:P2P:1");
+    }
+    if (st_match == LSSDP_ST_MATCH_PREFIX) {
+        snprintf(node[1].header.search_target, LSSDP_FIELD_LEN, "urn:acme:");
+    }
+    node[1].st_match         = st_match;
+    node[1].monitor          = monitor;
+    node[1].neighbor_probe   = true;
+    node[1].neighbor_timeout = 3000;
+
+    bool is_passed = true;
+    char title[64];
+    lssdp_send_notify(&node[0]);
+    run(fab, node, 2, 100);
+    snprintf(title, sizeof(title), "probe %s added", name);
+    is_passed &= check_events(title, &log, (int []) {LSSDP_NEIGHBOR_ADDED}, 1);
+
+    // 3 times of neighbor_timeout without NOTIFY
+    int i;
+    for (i = 0; i < 90; i++) {
+        lssdp_neighbor_check_timeout(&node[1]);
+        run(fab, node, 2, 100);
+    }
+    snprintf(title, sizeof(title), "probe %s kept", name);
+    is_passed &= check_events(title, &log, NULL, 0);
+    is_passed &= check_neighbor(title, node[1].neighbor_list, 0, "10.0.0.1:5678");
+
+    pair_destroy(fab, node);
+    return is_passed;
+}
+
+/* M-SEARCH of st is sent to the device node[0], the RESPONSE should be of response_st (NULL is not answered) */
+static bool check_msearch(fabric * fab, lssdp_ctx * node, const char * st, const char * response_st) {
+    char received[LSSDP_FIELD_LEN] = {};
+    node[1].user_data = received;
+    send_msearch(&node[1], st);
+    run(fab, node, 2, 100);
+
+    bool is_passed = response_st != NULL ? strcmp(received, response_st) == 0 : received[0] == '\0';
+    printf("%s: M-SEARCH %s of %s (%s)\n", is_passed ? "PASS" : "FAIL", st, node[0].header.search_target,
+        received[0] != '\0' ? received : "not answered");
+    return is_passed;
+}
+
+/* NOTIFY of nt is sent to node[1], the neighbor should be added or updated if is_accepted */
+static bool check_notify(fabric * fab, lssdp_ctx * node, event_log * log, const char * nt, bool is_accepted) {
+    snprintf(node[0].header.search_target, LSSDP_FIELD_LEN, "%s", nt);
+    send_packet(&node[0], &node[1], "ssdp:alive", "");
+    run(fab, node, 2, 100);
+
+    bool is_passed = (log->num > 0) == is_accepted;
+    printf("%s: NOTIFY %s to %s (%s)\n", is_passed ? "PASS" : "FAIL", nt, node[1].header.search_target,
+        log->num > 0 ? "accepted" : "rejected");
+    memset(log, 0, sizeof(event_log));
+    return is_passed;
+}
+
+/* 1. device answers ssdp:all with its own ST, the exact ST and a lower version of its type with the requested ST,
+ *    a higher version or another type is not answered
+ * 2. receiver accepts NOTIFY by st_match: exact, prefix ("urn:acme:" is not a prefix of "urn:acmex:"), version (higher or equal)
+ */
+static bool st_match_test() {
+    event_log log = {};
+    lssdp_ctx node[2];
+    fabric * fab = pair_create(node, "st", &log);
+    if (fab == NULL) {
+        return false;
+    }
+
+    bool is_passed = true;
+    snprintf(node[0].header.search_target, LSSDP_FIELD_LEN, "urn:acme:service:P2P:3");
+    node[1].neighbor_event_callback       = NULL;
+    node[1].packet_received_callback_data = record_response;
+    is_passed &= check_msearch(fab, node, "ssdp:all",                "urn:acme:service:P2P:3");
+    is_passed &= check_msearch(fab, node, "urn:acme:service:P2P:3",  "urn:acme:service:P2P:3");
+    is_passed &= check_msearch(fab, node, "urn:acme:service:P2P:2",  "urn:acme:service:P2P:2");
+    is_passed &= check_msearch(fab, node, "urn:acme:service:P2P:4",  NULL);
+    is_passed &= check_msearch(fab, node, "urn:acme:service:P2PX:2", NULL);
+    is_passed &= check_msearch(fab, node, "urn:acme:service:P2P",    NULL);
+    node[1].packet_received_callback_data = NULL;
+    node[1].neighbor_event_callback       = record_event;
+    node[1].user_data                     = &log;
+
+    // exact
+    is_passed &= check_notify(fab, node, &log, "ST_P2P",  true);
+    is_passed &= check_notify(fab, node, &log, "ST_P2PX", false);
+
+    // prefix
+    node[1].st_match = LSSDP_ST_MATCH_PREFIX;
+    snprintf(node[1].header.search_target, LSSDP_FIELD_LEN, "urn:acme:");
+    is_passed &= check_notify(fab, node, &log, "urn:acme:service:P2P:1",  true);
+    is_passed &= check_notify(fab, node, &log, "urn:acmex:service:P2P:1", false);
+
+    // version
+    node[1].st_match = LSSDP_ST_MATCH_VERSION;
+    snprintf(node[1].header.search_target, LSSDP_FIELD_LEN, "urn:acme:service:P2P:2");
+    is_passed &= check_notify(fab, node, &log, "urn:acme:service:P2P:3",  true);
+    is_passed &= check_notify(fab, node, &log, "urn:acme:service:P2P:2",  true);
+    is_passed &= check_notify(fab, node, &log, "urn:acme:service:P2P:1",  false);
+    is_passed &= check_notify(fab, node, &log, "urn:acme:service:P2PX:3", false);
+
+    pair_destroy(fab, node);
+    return is_passed;
+}
+
+int main() {
+    fabric * fab = fabric_create(NODE_NUM, 20, 0.0, 1);
+    if (fab == NULL) {
+        puts("fabric create failed");
+        return EXIT_FAILURE;
+    }
+
+    lssdp_ctx node[NODE_NUM] = {};
+    char usn[NODE_NUM][LSSDP_FIELD_LEN];
+    int i;
+    for (i = 0; i < NODE_NUM; i++) {
+        snprintf(usn[i], sizeof(usn[i]), "node-%d", i + 1);
+
+        node[i] = (lssdp_ctx) {
+            .port = 1900,
+            .neighbor_timeout = 15000,
+            .header = {
+                .search_target   = "ST_P2P",
+                .device_type     = "DEV_TYPE",
+                .location.suffix = ":5678"
+            },
+            .network_interface_changed_callback = create_socket
+        };
+        snprintf(node[i].header.unique_service_name, LSSDP_FIELD_LEN, "%s", usn[i]);
+
+        if (fabric_node_add(fab, &node[i]) < 0) {
+            puts("fabric add node failed");
+            return EXIT_FAILURE;
+        }
+        lssdp_network_interface_update(&node[i]);
+    }
+
+    long long last_time = fabric_now(fab);
+    while (fabric_now(fab) < 30000) {
+        for (i = 0; i < NODE_NUM; i++) {
+            while (fabric_node_readable(&node[i])) {
+                lssdp_socket_read(&node[i]);
+            }
+            lssdp_msearch_schedule(&node[i]);
+        }
+
+        if (fabric_now(fab) - last_time >= 5000) {
+            for (i = 0; i < NODE_NUM; i++) {
+                lssdp_send_notify(&node[i]);
+                lssdp_neighbor_check_timeout(&node[i]);
+            }
+            last_time = fabric_now(fab);
+        }
+
+        fabric_advance(fab, 100);
+    }
+
+    for (i = 0; i < NODE_NUM; i++) {
+        printf("\n%s (%s) neighbors:\n", node[i].header.unique_service_name, node[i].interface[0].ip);
+        lssdp_nbr * nbr;
+        for (nbr = node[i].neighbor_list; nbr != NULL; nbr = nbr->next) {
+            printf("  usn = %-8s, location = %s\n", nbr->usn, nbr->location);
+        }
+    }
+
+    fabric_stats stats = fabric_get_stats(fab);
+    printf("\nsent = %zu, delivered = %zu, dropped = %zu, bytes = %zu\n",
+        stats.sent, stats.delivered, stats.dropped, stats.bytes);
+
+    for (i = 0; i < NODE_NUM; i++) {
+        lssdp_socket_close(&node[i]);   // neighbor list is cleaned up too
+        lssdp_self_address_clear(&node[i]);
+    }
+    fabric_destroy(fab);
+
+    puts("");
+    bool is_passed = true;
+    is_passed &= multi_homed_test();
+    is_passed &= extra_header_test();
+    is_passed &= boot_id_test();
+    is_passed &= probe_test("exact",   LSSDP_ST_MATCH_EXACT,  false);
+    is_passed &= probe_test("prefix",  LSSDP_ST_MATCH_PREFIX, false);
+    is_passed &= probe_test("monitor", LSSDP_ST_MATCH_EXACT,  true);
+    is_passed &= st_match_test();
+    return is_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}